@@ -9,7 +9,7 @@ mkdir -p bin
 g++ -std=c++17 -pthread -o bin/chess_server \
     server/main.cpp \
     -I. \
-    -lm
+    -lm -lz
 
 echo "Build completed successfully!"
 echo "To run: ./bin/chess_server"
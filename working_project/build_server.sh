@@ -12,7 +12,7 @@ mkdir -p server/bin
 g++ -std=c++17 -pthread -o bin/chess_server \
     server/main.cpp \
     -I. \
-    -lm
+    -lm -lz
 
 cp bin/chess_server server/bin/chess_server
 
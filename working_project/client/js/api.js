@@ -74,6 +74,11 @@ class api_client {
         return this.request('POST', '/match/find');
     }
     
+    // Held open by the server until an opponent is found or it times out.
+    static async wait_for_match() {
+        return this.request('POST', '/match/wait');
+    }
+    
     static async get_match_history() {
         return this.request('GET', '/match/history');
     }
@@ -105,4 +110,67 @@ class api_client {
     static async reject_friend_request(friend_id) {
         return this.request('POST', '/friends/reject', { friend_id });
     }
+    
+    // Fetches several session views in one round trip. Resolves to an object
+    // keyed by path; on failure every path maps to the error.
+    static async batch(paths) {
+        const result = await this.request('POST', '/batch', { requests: paths });
+        const responses = {};
+        paths.forEach((path, i) => {
+            responses[path] = (result.responses && result.responses[i]) || { error: result.error || 'Batch failed' };
+        });
+        return responses;
+    }
+    
+    static async get_dashboard() {
+        return this.batch(['/user/me', '/friends/list', '/friends/pending', '/friends/recommendations', '/match/history']);
+    }
+}
+
+// Push channel for match, friend, presence and live game events. Reconnects
+// with a growing delay for as long as the user stays logged in.
+class live_socket {
+    static connect(on_event) {
+        this.on_event = on_event;
+        this.wanted = true;
+        if (this.socket || !auth.get_token()) {
+            return;
+        }
+        const url = API_BASE.replace(/^http/, 'ws') + '/ws?token=' + encodeURIComponent(auth.get_token());
+        const socket = new WebSocket(url);
+        this.socket = socket;
+        socket.onopen = () => {
+            this.retry_ms = 1000;
+        };
+        socket.onmessage = (message) => {
+            try {
+                this.on_event(JSON.parse(message.data));
+            } catch (error) {
+                console.error('Bad live event:', error);
+            }
+        };
+        socket.onclose = () => {
+            this.socket = null;
+            if (this.wanted) {
+                this.retry_ms = Math.min((this.retry_ms || 1000) * 2, 30000);
+                setTimeout(() => this.connect(this.on_event), this.retry_ms);
+            }
+        };
+    }
+    
+    static send(message) {
+        if (!this.socket || this.socket.readyState !== WebSocket.OPEN) {
+            return false;
+        }
+        this.socket.send(JSON.stringify(message));
+        return true;
+    }
+    
+    static disconnect() {
+        this.wanted = false;
+        if (this.socket) {
+            this.socket.close();
+            this.socket = null;
+        }
+    }
 }
@@ -89,11 +89,11 @@ class ui {
                     </div>
                     <div class="action-card" onclick="ui.view_friends()">
                         <h3>👥 Friends</h3>
-                        <p>Manage your friends</p>
+                        <p id="friends-summary">Manage your friends</p>
                     </div>
                     <div class="action-card" onclick="ui.view_match_history()">
                         <h3>📊 History</h3>
-                        <p>View your matches</p>
+                        <p id="history-summary">View your matches</p>
                     </div>
                 </div>
             </div>
@@ -140,38 +140,133 @@ class ui {
 
     static show_dashboard() {
         document.getElementById('app').innerHTML = this.render_dashboard();
-        this.load_user_stats();
+        this.load_dashboard();
+        live_socket.connect(event => this.handle_live_event(event));
     }
 
-    static async load_user_stats() {
-        try {
-            const user = await api_client.get_user();
-            console.log('User data received:', user);
-            if (user && !user.error && user.user_id) {
-                if (document.getElementById('user-elo')) {
-                    document.getElementById('user-elo').textContent = user.elo || user.elo_rating || '1600';
+    static handle_live_event(event) {
+        switch (event.type) {
+            case 'match_found':
+                if (this.waiting_for_match) {
+                    this.waiting_for_match = false;
+                    this.start_game(event.opponent_id, event.opponent_username || 'Opponent');
                 }
-                if (document.getElementById('user-matches')) {
-                    document.getElementById('user-matches').textContent = user.matches || user.total_matches || '0';
-                }
-                if (document.getElementById('user-wins')) {
-                    document.getElementById('user-wins').textContent = user.wins || '0';
-                }
-                
-                const totalMatches = user.matches || user.total_matches || 0;
-                const wins = user.wins || 0;
-                const winrate = totalMatches > 0 ? Math.round((wins / totalMatches) * 100) : 0;
-                if (document.getElementById('user-winrate')) {
-                    document.getElementById('user-winrate').textContent = winrate + '%';
+                break;
+            case 'friend_request':
+                this.show_notification(`${event.username} sent you a friend request`, 'success');
+                break;
+            case 'friend_accepted':
+                this.show_notification(`${event.username} accepted your friend request`, 'success');
+                break;
+            case 'presence': {
+                const status = document.getElementById(`presence-${event.user_id}`);
+                if (status) {
+                    status.textContent = event.online ? 'Online' : 'Offline';
                 }
-            } else if (user && user.error) {
-                console.error('Error loading user stats:', user.error);
+                break;
+            }
+            case 'move':
+                this.log_game_event(`Opponent played ${event.move}`);
+                break;
+            case 'resign':
+                this.log_game_event('Opponent resigned');
+                break;
+            case 'draw_offer':
+                this.log_game_event('Opponent offers a draw');
+                break;
+            case 'draw_accept':
+                this.log_game_event('Opponent accepted the draw');
+                break;
+            case 'error':
+                this.show_notification(event.error, 'error');
+                break;
+        }
+    }
+
+    static log_game_event(text) {
+        const log = document.getElementById('move-log');
+        if (log) {
+            const line = document.createElement('div');
+            line.textContent = text;
+            log.appendChild(line);
+        } else {
+            this.show_notification(text, 'warning');
+        }
+    }
+
+    static send_move(opponent_id) {
+        const input = document.getElementById('move-input');
+        const move = input.value.trim();
+        if (!move) {
+            return;
+        }
+        if (live_socket.send({ type: 'move', to: opponent_id, move })) {
+            this.log_game_event(`You played ${move}`);
+            input.value = '';
+        } else {
+            this.show_notification('Not connected', 'error');
+        }
+    }
+
+    // Everything the dashboard shows comes from a single /batch request.
+    static async load_dashboard() {
+        try {
+            const dashboard = await api_client.get_dashboard();
+            this.render_user_stats(dashboard['/user/me']);
+            
+            const friends = dashboard['/friends/list'].friends || [];
+            const pending = dashboard['/friends/pending'].requests || [];
+            const suggested = dashboard['/friends/recommendations'].recommendations || [];
+            const summary = document.getElementById('friends-summary');
+            if (summary && !dashboard['/friends/list'].error) {
+                const online = friends.filter(friend => friend.online).length;
+                summary.textContent = `${friends.length} friends, ${online} online` +
+                    (pending.length > 0 ? ` • ${pending.length} pending` : '') +
+                    (suggested.length > 0 ? ` • ${suggested.length} suggested` : '');
+            }
+            
+            const history = document.getElementById('history-summary');
+            const matches = dashboard['/match/history'].matches;
+            if (history && matches) {
+                history.textContent = matches.length > 0 ? `${matches.length} recent matches` : 'No matches yet';
             }
+        } catch (error) {
+            console.error('Failed to load dashboard:', error);
+        }
+    }
+
+    static async load_user_stats() {
+        try {
+            this.render_user_stats(await api_client.get_user());
         } catch (error) {
             console.error('Failed to load user stats:', error);
         }
     }
 
+    static render_user_stats(user) {
+        console.log('User data received:', user);
+        if (user && !user.error && user.user_id) {
+            if (document.getElementById('user-elo')) {
+                document.getElementById('user-elo').textContent = user.elo || user.elo_rating || '1600';
+            }
+            if (document.getElementById('user-matches')) {
+                document.getElementById('user-matches').textContent = user.matches || user.total_matches || '0';
+            }
+            if (document.getElementById('user-wins')) {
+                document.getElementById('user-wins').textContent = user.wins || '0';
+            }
+            
+            const totalMatches = user.matches || user.total_matches || 0;
+            const wins = user.wins || 0;
+            const winrate = totalMatches > 0 ? Math.round((wins / totalMatches) * 100) : 0;
+            if (document.getElementById('user-winrate')) {
+                document.getElementById('user-winrate').textContent = winrate + '%';
+            }
+        } else if (user && user.error) {
+            console.error('Error loading user stats:', user.error);
+        }
+    }
+
     static show_profile() {
         this.load_user_stats();
         this.show_notification('Profile updated', 'success');
@@ -186,15 +281,19 @@ class ui {
             if (result.status === 'ok' || result.message) {
                 this.show_notification('Queued for matchmaking...', 'success');
                 
-                for (let i = 0; i < 5; i++) {
-                    await new Promise(r => setTimeout(r, 1000));
-                    const match = await api_client.find_match();
-                    console.log('Find match result:', match);
-                    
-                    if (match.status === 'ok' && match.opponent_id) {
-                        this.start_game(match.opponent_id, match.opponent_username || 'Opponent');
-                        return;
-                    }
+                // The live socket may deliver the match first; whichever
+                // arrives second is ignored.
+                this.waiting_for_match = true;
+                const match = await api_client.wait_for_match();
+                console.log('Wait for match result:', match);
+                if (!this.waiting_for_match) {
+                    return;
+                }
+                this.waiting_for_match = false;
+                
+                if (match.status === 'ok' && match.opponent_id) {
+                    this.start_game(match.opponent_id, match.opponent_username || 'Opponent');
+                    return;
                 }
                 
                 this.show_notification('No opponent found. Try again later.', 'warning');
@@ -242,6 +341,12 @@ class ui {
                         ).join('')}
                     </div>
 
+                    <div style="text-align: center; margin-top: 1rem;">
+                        <input type="text" id="move-input" placeholder="Your move, e.g. e2e4" style="max-width: 200px;">
+                        <button onclick="ui.send_move(${opponent_id})" class="btn-primary">Send Move</button>
+                        <div id="move-log" style="margin-top: 0.5rem; color: var(--text-muted);"></div>
+                    </div>
+
                     <div style="text-align: center; margin-top: 2rem;">
                         <p style="margin-bottom: 1rem; color: var(--text-muted);">Record the match result:</p>
                         <button onclick="ui.record_win(${opponent_id})" class="btn-success" style="margin: 0 0.5rem;">Win</button>
@@ -338,10 +443,9 @@ class ui {
 
     static async view_friends() {
         try {
-            const [pendingRequests, friendsList] = await Promise.all([
-                api_client.get_pending_friend_requests(),
-                api_client.get_friends()
-            ]);
+            const views = await api_client.batch(['/friends/pending', '/friends/list']);
+            const pendingRequests = views['/friends/pending'];
+            const friendsList = views['/friends/list'];
             
             let html = `
                 <div class="navbar">
@@ -390,7 +494,7 @@ class ui {
                         <div class="user-item" style="display: flex; justify-content: space-between; align-items: center; padding: 1rem; border-bottom: 1px solid var(--border);">
                             <div>
                                 <strong>${friend.username}</strong><br>
-                                <small style="color: var(--text-muted);">Elo: ${friend.elo}</small>
+                                <small style="color: var(--text-muted);">Elo: ${friend.elo} • <span id="presence-${friend.user_id}">${friend.online ? 'Online' : 'Offline'}</span></small>
                             </div>
                         </div>
                     `;
@@ -528,6 +632,7 @@ class ui {
     }
 
     static async logout() {
+        live_socket.disconnect();
         await auth.logout();
         this.show_notification('Logged out successfully', 'success');
         this.show_login_page();
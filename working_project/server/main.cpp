@@ -2,7 +2,9 @@
 #include <thread>
 #include <memory>
 #include <csignal>
+#include <cstdlib>
 #include <sstream>
+#include <cctype>
 #include <unistd.h>
 #include <limits.h>
 #include <algorithm>
@@ -11,17 +13,28 @@
 
 #include "src/network/http_server.hpp"
 #include "src/api/game_state.hpp"
+#include "src/api/match_waitlist.hpp"
+#include "src/api/response_cache.hpp"
 #include "src/utils/json_parser.hpp"
 
 std::unique_ptr<game_state> game;
+std::unique_ptr<response_cache> public_responses;
+// Part of every API ETag: versions restart with the process, so a tag from a
+// previous run must not match.
+std::string etag_epoch;
 std::unique_ptr<http_server> server;
+// Declared after server so it is destroyed first: its destructor answers the
+// requests still parked on it.
+std::unique_ptr<match_waitlist> waitlist;
+// Slow handlers run on these instead of the server's request workers, so a
+// burst of logins cannot starve cheap requests. Also destroyed before the
+// server their tasks answer through.
+std::unique_ptr<worker_pool> auth_pool;
+std::unique_ptr<worker_pool> recommendation_pool;
 
-std::string extract_token(const http_request& req);
-std::string handle_get_pending_friend_requests(const http_request& req);
-std::string handle_get_friends(const http_request& req);
-std::string handle_reject_friend_request(const http_request& req);
+std::string_view extract_token(const http_request_view& req);
 
-std::string handle_register(const http_request& req) {
+std::string handle_register(const http_request_view& req) {
     json_value body = json_parser::parse(req.body);
     
     if (body.value_type != json_value::object_type ||
@@ -44,7 +57,7 @@ std::string handle_register(const http_request& req) {
     return "{\"error\":\"Registration failed\"}";
 }
 
-std::string handle_login(const http_request& req) {
+std::string handle_login(const http_request_view& req) {
     json_value body = json_parser::parse(req.body);
     
     if (body.value_type != json_value::object_type ||
@@ -64,20 +77,17 @@ std::string handle_login(const http_request& req) {
     return "{\"error\":\"Login failed\"}";
 }
 
-std::string extract_token(const http_request& req) {
-    auto it = req.headers.find("Authorization");
-    if (it == req.headers.end()) {
-        return "";
-    }
-    std::string auth_header = it->second;
-    if (auth_header.find("Bearer ") == 0) {
-        return auth_header.substr(7);
+// Points into the request buffer, so use it before the handler returns.
+std::string_view extract_token(const http_request_view& req) {
+    std::string_view auth_header = req.header("Authorization");
+    if (auth_header.compare(0, 7, "Bearer ") == 0) {
+        auth_header.remove_prefix(7);
     }
     return auth_header;
 }
 
-std::string handle_logout(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_logout(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -89,33 +99,220 @@ std::string handle_logout(const http_request& req) {
     return "{\"error\":\"Logout failed\"}";
 }
 
-std::string handle_get_user(const http_request& req) {
-    std::string token = extract_token(req);
+std::string user_json(const user_data& user) {
+    return "{\"user_id\":" + std::to_string(user.user_id) +
+           ",\"username\":\"" + user.username +
+           "\",\"elo\":" + std::to_string(user.elo_rating) +
+           ",\"matches\":" + std::to_string(user.total_matches) +
+           ",\"wins\":" + std::to_string(user.wins) +
+           ",\"losses\":" + std::to_string(user.losses) +
+           ",\"draws\":" + std::to_string(user.draws) + "}";
+}
+
+std::string user_summary_json(const user_data& user) {
+    return "{\"user_id\":" + std::to_string(user.user_id) +
+           ",\"username\":\"" + user.username +
+           "\",\"elo\":" + std::to_string(user.elo_rating) + "}";
+}
+
+std::string user_list_json(const char* key, const std::vector<user_data>& users) {
+    std::string result = "{\"" + std::string(key) + "\":[";
+    bool first = true;
+    for (const user_data& user : users) {
+        if (!first) result += ",";
+        result += user_summary_json(user);
+        first = false;
+    }
+    result += "]}";
+    return result;
+}
+
+// API ETags are weak: the gzip and identity encodings share one.
+std::string version_etag(uint64_t version) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%llx", static_cast<unsigned long long>(version));
+    return "\"" + etag_epoch + "-" + hex + "\"";
+}
+
+bool client_has_version(const http_request_view& req, const std::string& etag) {
+    return static_cache::etag_matches(req.header("If-None-Match"), etag);
+}
+
+http_response with_etag(http_response response, const std::string& etag, const char* cache_control) {
+    return std::move(response).add_header("ETag", "W/" + etag).add_header("Cache-Control", cache_control);
+}
+
+// The session views below render a dashboard_snapshot, so each can be
+// served on its own or as one part of a /batch request.
+std::string render_current_user(const dashboard_snapshot& snapshot) {
+    if (!snapshot.has_user) {
+        return "{\"error\":\"User not found\"}";
+    }
+    return user_json(snapshot.user);
+}
+
+std::string render_friends(const dashboard_snapshot& snapshot) {
+    std::string result = "{\"friends\":[";
+    bool first = true;
+    for (const user_data& friend_user : snapshot.friends) {
+        if (!first) result += ",";
+        result += "{\"user_id\":" + std::to_string(friend_user.user_id) +
+                  ",\"username\":\"" + friend_user.username +
+                  "\",\"elo\":" + std::to_string(friend_user.elo_rating) +
+                  ",\"online\":" + (server->is_online(friend_user.user_id) ? "true" : "false") + "}";
+        first = false;
+    }
+    result += "]}";
+    return result;
+}
+
+std::string render_pending_requests(const dashboard_snapshot& snapshot) {
+    return user_list_json("requests", snapshot.pending);
+}
+
+std::string render_recommendations(const dashboard_snapshot& snapshot) {
+    return user_list_json("recommendations", snapshot.recommendations);
+}
+
+std::string render_match_history(const dashboard_snapshot& snapshot) {
+    uint64_t user_id = snapshot.user_id;
+    std::string result = "{\"matches\":[";
+    bool first = true;
+    for (size_t i = 0; i < snapshot.matches.size(); i++) {
+        const match_data& match = snapshot.matches[i];
+        if (!first) result += ",";
+        int change = (match.player1_id == user_id) ? match.elo_change_p1 : match.elo_change_p2;
+        uint64_t opponent_id = (match.player1_id == user_id) ? match.player2_id : match.player1_id;
+        
+        result += "{\"match_id\":" + std::to_string(match.match_id) +
+                  ",\"player1_id\":" + std::to_string(match.player1_id) +
+                  ",\"player2_id\":" + std::to_string(match.player2_id) +
+                  ",\"opponent_id\":" + std::to_string(opponent_id) +
+                  ",\"opponent_username\":\"" + snapshot.opponent_names[i] + "\"" +
+                  ",\"winner_id\":" + std::to_string(match.winner_id) +
+                  ",\"elo_change\":" + std::to_string(change) + "}";
+        first = false;
+    }
+    result += "]}";
+    return result;
+}
+
+typedef std::string (*snapshot_renderer)(const dashboard_snapshot&);
+
+struct session_view {
+    const char* path;
+    int section;
+    snapshot_renderer render;
+};
+
+const session_view session_views[] = {
+    {"/user/me", dashboard_snapshot::user_section, render_current_user},
+    {"/friends/list", dashboard_snapshot::friends_section, render_friends},
+    {"/friends/pending", dashboard_snapshot::pending_section, render_pending_requests},
+    {"/friends/recommendations", dashboard_snapshot::recommendations_section, render_recommendations},
+    {"/match/history", dashboard_snapshot::history_section, render_match_history}
+};
+
+const session_view* find_session_view(const std::string& path) {
+    for (const session_view& view : session_views) {
+        if (path == view.path) {
+            return &view;
+        }
+    }
+    return nullptr;
+}
+
+// The version is checked first: a client that already has it gets a 304
+// without the snapshot being taken or anything rendered.
+http_response handle_session_view(const http_request_view& req, const session_view& view) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
     
-    uint64_t user_id = 0;
-    if (!game->verify_session(token, user_id)) {
+    uint64_t version = 0;
+    if (!game->get_dashboard_version(token, view.section, version)) {
         return "{\"error\":\"Invalid session\"}";
     }
+    std::string etag = version_etag(version);
+    if (client_has_version(req, etag)) {
+        return with_etag(http_response(304, std::string()), etag, "private, no-cache");
+    }
     
-    user_data user;
-    if (game->get_user(user_id, user)) {
-        std::string json = "{\"user_id\":" + std::to_string(user.user_id) + 
-               ",\"username\":\"" + user.username + 
-               "\",\"elo\":" + std::to_string(user.elo_rating) + 
-               ",\"matches\":" + std::to_string(user.total_matches) +
-               ",\"wins\":" + std::to_string(user.wins) +
-               ",\"losses\":" + std::to_string(user.losses) +
-               ",\"draws\":" + std::to_string(user.draws) + "}";
-        return json;
+    dashboard_snapshot snapshot;
+    if (!game->get_dashboard_snapshot(token, view.section, snapshot)) {
+        return "{\"error\":\"Invalid session\"}";
+    }
+    return with_etag(http_response(200, view.render(snapshot)), etag, "private, no-cache");
+}
+
+http_response handle_get_user(const http_request_view& req) {
+    return handle_session_view(req, *find_session_view("/user/me"));
+}
+
+http_response handle_get_friends(const http_request_view& req) {
+    return handle_session_view(req, *find_session_view("/friends/list"));
+}
+
+http_response handle_get_pending_friend_requests(const http_request_view& req) {
+    return handle_session_view(req, *find_session_view("/friends/pending"));
+}
+
+http_response handle_friend_recommendations(const http_request_view& req) {
+    return handle_session_view(req, *find_session_view("/friends/recommendations"));
+}
+
+http_response handle_get_match_history(const http_request_view& req) {
+    return handle_session_view(req, *find_session_view("/match/history"));
+}
+
+// {"requests":["/user/me","/friends/list",...]} answers every listed session
+// view from one snapshot: the token is checked once and all parts come from
+// the same moment. Responses are returned in request order.
+std::string handle_batch(const http_request_view& req) {
+    std::string_view token = extract_token(req);
+    if (token.empty()) {
+        return "{\"error\":\"Missing token\"}";
+    }
+    
+    json_value body = json_parser::parse(req.body);
+    if (body.value_type != json_value::object_type ||
+        body.object_val["requests"].value_type != json_value::array_type) {
+        return "{\"error\":\"Invalid request\"}";
+    }
+    const std::vector<json_value>& requests = body.object_val["requests"].array_val;
+    if (requests.empty() || requests.size() > 16) {
+        return "{\"error\":\"Invalid request\"}";
+    }
+    
+    std::vector<const session_view*> views;
+    int sections = 0;
+    for (const json_value& request : requests) {
+        const session_view* view = nullptr;
+        if (request.value_type == json_value::string_type) {
+            view = find_session_view(request.string_val);
+        }
+        if (view) {
+            sections |= view->section;
+        }
+        views.push_back(view);
+    }
+    
+    dashboard_snapshot snapshot;
+    if (!game->get_dashboard_snapshot(token, sections, snapshot)) {
+        return "{\"error\":\"Invalid session\"}";
     }
     
-    return "{\"error\":\"User not found\"}";
+    std::string result = "{\"status\":\"ok\",\"responses\":[";
+    for (size_t i = 0; i < views.size(); i++) {
+        if (i > 0) result += ",";
+        result += views[i] ? views[i]->render(snapshot) : "{\"error\":\"Unsupported batch request\"}";
+    }
+    result += "]}";
+    return result;
 }
 
-std::string handle_leaderboard(const http_request& req) {
+std::string handle_leaderboard(const http_request_view&) {
     // Get all users and sort by Elo rating (using max heap approach)
     std::vector<std::pair<int, user_data>> all_users;
     
@@ -125,8 +322,9 @@ std::string handle_leaderboard(const http_request& req) {
     std::vector<user_data> users_list;
     game->get_all_users(users_list);
     
-    // Sort by Elo rating (descending)
-    std::sort(users_list.begin(), users_list.end(), 
+    // Sort by Elo rating (descending); only the top 50 are shown
+    size_t shown = std::min<size_t>(users_list.size(), 50);
+    std::partial_sort(users_list.begin(), users_list.begin() + shown, users_list.end(),
         [](const user_data& a, const user_data& b) {
             return a.elo_rating > b.elo_rating;
         });
@@ -154,14 +352,12 @@ std::string handle_leaderboard(const http_request& req) {
     return result;
 }
 
-std::string handle_search_users(const http_request& req) {
-    std::string query_str = req.path;
-    size_t q_pos = query_str.find("q=");
-    if (q_pos == std::string::npos) {
+std::string handle_search_users(const http_request_view& req) {
+    std::string query;
+    if (!req.query_param("q", query) || query.empty()) {
         return "{\"users\":[]}";
     }
     
-    std::string query = query_str.substr(q_pos + 2);
     if (query.length() > 50) query = query.substr(0, 50);
     
     std::string result = "{\"users\":[";
@@ -184,8 +380,26 @@ std::string handle_search_users(const http_request& req) {
     return result;
 }
 
-std::string handle_queue_for_match(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_get_user_profile(const http_request_view& req) {
+    std::string_view id_param = req.param("id");
+    uint64_t user_id = 0;
+    for (char c : id_param) {
+        if (c < '0' || c > '9') {
+            return "{\"error\":\"Invalid user id\"}";
+        }
+        user_id = user_id * 10 + (c - '0');
+    }
+    
+    user_data user;
+    if (user_id == 0 || !game->get_user(user_id, user)) {
+        return "{\"error\":\"User not found\"}";
+    }
+    
+    return user_json(user);
+}
+
+std::string handle_queue_for_match(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -200,35 +414,75 @@ std::string handle_queue_for_match(const http_request& req) {
         return "{\"error\":\"User not found\"}";
     }
     
+    waitlist->forget_result(user_id);
     game->queue_for_matchmaking(user_id, user.elo_rating);
     return "{\"status\":\"ok\",\"message\":\"Queued for matchmaking\"}";
 }
 
-std::string handle_find_match(const http_request& req) {
-    std::string token = extract_token(req);
+std::string match_found_json(uint64_t opponent_id) {
+    user_data opponent;
+    if (game->get_user(opponent_id, opponent)) {
+        return "{\"status\":\"ok\",\"opponent_id\":" + std::to_string(opponent_id) +
+               ",\"opponent_username\":\"" + opponent.username + "\"}";
+    }
+    return "{\"status\":\"waiting\"}";
+}
+
+// Hands the pairing to the opponent's pending or next /match/wait and pushes
+// it to any socket they have open.
+void announce_match(uint64_t user_id, uint64_t opponent_id) {
+    waitlist->deliver(user_id, opponent_id);
+    user_data opponent;
+    if (game->get_user(opponent_id, opponent)) {
+        server->publish(user_id, "{\"type\":\"match_found\",\"opponent_id\":" + std::to_string(opponent_id) +
+                                 ",\"opponent_username\":\"" + opponent.username + "\"}");
+    }
+}
+
+// find_match only pairs a player with someone ranked below them, so a new
+// arrival near the bottom of the queue is matched from the side of a player
+// who is already waiting.
+void pair_parked_players() {
+    for (uint64_t user_id : waitlist->parked_users()) {
+        uint64_t opponent_id = 0;
+        if (game->find_match(user_id, opponent_id)) {
+            announce_match(opponent_id, user_id);
+            announce_match(user_id, opponent_id);
+        }
+    }
+}
+
+// Long-poll replacement for polling /match/find: the request is parked on
+// the waitlist, holding no worker thread, until this player is paired or the
+// wait times out with {"status":"waiting"}.
+void handle_wait_for_match(const http_request_view& req, response_sink respond) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
-        return "{\"error\":\"Missing token\"}";
+        respond("{\"error\":\"Missing token\"}");
+        return;
     }
     
     uint64_t user_id = 0;
     if (!game->verify_session(token, user_id)) {
-        return "{\"error\":\"Invalid session\"}";
+        respond("{\"error\":\"Invalid session\"}");
+        return;
     }
     
     uint64_t opponent_id = 0;
     if (game->find_match(user_id, opponent_id)) {
-        user_data opponent;
-        if (game->get_user(opponent_id, opponent)) {
-            return "{\"status\":\"ok\",\"opponent_id\":" + std::to_string(opponent_id) +
-                   ",\"opponent_username\":\"" + opponent.username + "\"}";
-        }
+        announce_match(opponent_id, user_id);
+        respond(match_found_json(opponent_id));
+        return;
     }
     
-    return "{\"status\":\"waiting\"}";
+    waitlist->park(user_id, [respond](bool matched, uint64_t opponent_id) {
+        respond(matched ? match_found_json(opponent_id) : std::string("{\"status\":\"waiting\"}"));
+    });
+    pair_parked_players();
 }
 
-std::string handle_get_match_history(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_find_match(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -238,37 +492,20 @@ std::string handle_get_match_history(const http_request& req) {
         return "{\"error\":\"Invalid session\"}";
     }
     
-    std::vector<match_data> history;
-    game->get_match_history(user_id, history);
-    
-    std::string result = "{\"matches\":[";
-    bool first = true;
-    for (const auto& match : history) {
-        if (!first) result += ",";
-        int change = (match.player1_id == user_id) ? match.elo_change_p1 : match.elo_change_p2;
-        uint64_t opponent_id = (match.player1_id == user_id) ? match.player2_id : match.player1_id;
-        
-        user_data opponent;
-        std::string opponent_name = "Unknown";
-        if (game->get_user(opponent_id, opponent)) {
-            opponent_name = opponent.username;
-        }
-        
-        result += "{\"match_id\":" + std::to_string(match.match_id) +
-                  ",\"player1_id\":" + std::to_string(match.player1_id) +
-                  ",\"player2_id\":" + std::to_string(match.player2_id) +
-                  ",\"opponent_id\":" + std::to_string(opponent_id) +
-                  ",\"opponent_username\":\"" + opponent_name + "\"" +
-                  ",\"winner_id\":" + std::to_string(match.winner_id) +
-                  ",\"elo_change\":" + std::to_string(change) + "}";
-        first = false;
+    uint64_t opponent_id = 0;
+    if (waitlist->take_result(user_id, opponent_id)) {
+        return match_found_json(opponent_id);
     }
-    result += "]}";
-    return result;
+    if (game->find_match(user_id, opponent_id)) {
+        announce_match(opponent_id, user_id);
+        return match_found_json(opponent_id);
+    }
+    
+    return "{\"status\":\"waiting\"}";
 }
 
-std::string handle_record_match(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_record_match(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -306,8 +543,8 @@ std::string handle_record_match(const http_request& req) {
     return "{\"error\":\"Failed to record match\"}";
 }
 
-std::string handle_send_friend_request(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_send_friend_request(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -326,14 +563,19 @@ std::string handle_send_friend_request(const http_request& req) {
     uint64_t friend_id = (uint64_t)body.object_val["friend_id"].number_val;
     
     if (game->send_friend_request(user_id, friend_id)) {
+        user_data sender;
+        if (game->get_user(user_id, sender)) {
+            server->publish(friend_id, "{\"type\":\"friend_request\",\"user_id\":" + std::to_string(user_id) +
+                                       ",\"username\":\"" + sender.username + "\"}");
+        }
         return "{\"status\":\"ok\",\"message\":\"Friend request sent\"}";
     }
     
     return "{\"error\":\"Failed to send friend request\"}";
 }
 
-std::string handle_accept_friend_request(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_accept_friend_request(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -352,74 +594,20 @@ std::string handle_accept_friend_request(const http_request& req) {
     uint64_t friend_id = (uint64_t)body.object_val["friend_id"].number_val;
     
     if (game->accept_friend_request(user_id, friend_id)) {
+        user_data accepter;
+        if (game->get_user(user_id, accepter)) {
+            server->publish(friend_id, "{\"type\":\"friend_accepted\",\"user_id\":" + std::to_string(user_id) +
+                                       ",\"username\":\"" + accepter.username +
+                                       "\",\"online\":" + (server->is_online(user_id) ? "true" : "false") + "}");
+        }
         return "{\"status\":\"ok\",\"message\":\"Friend request accepted\"}";
     }
     
     return "{\"error\":\"Failed to accept friend request\"}";
 }
 
-std::string handle_get_pending_friend_requests(const http_request& req) {
-    std::string token = extract_token(req);
-    if (token.empty()) {
-        return "{\"error\":\"Missing token\"}";
-    }
-    
-    uint64_t user_id = 0;
-    if (!game->verify_session(token, user_id)) {
-        return "{\"error\":\"Invalid session\"}";
-    }
-    
-    std::vector<uint64_t> pending;
-    game->get_pending_friend_requests(user_id, pending);
-    
-    std::string result = "{\"requests\":[";
-    bool first = true;
-    for (uint64_t sender_id : pending) {
-        user_data sender;
-        if (game->get_user(sender_id, sender)) {
-            if (!first) result += ",";
-            result += "{\"user_id\":" + std::to_string(sender_id) +
-                      ",\"username\":\"" + sender.username +
-                      "\",\"elo\":" + std::to_string(sender.elo_rating) + "}";
-            first = false;
-        }
-    }
-    result += "]}";
-    return result;
-}
-
-std::string handle_get_friends(const http_request& req) {
-    std::string token = extract_token(req);
-    if (token.empty()) {
-        return "{\"error\":\"Missing token\"}";
-    }
-    
-    uint64_t user_id = 0;
-    if (!game->verify_session(token, user_id)) {
-        return "{\"error\":\"Invalid session\"}";
-    }
-    
-    std::vector<uint64_t> friends;
-    game->get_friends(user_id, friends);
-    
-    std::string result = "{\"friends\":[";
-    bool first = true;
-    for (uint64_t friend_id : friends) {
-        user_data friend_user;
-        if (game->get_user(friend_id, friend_user)) {
-            if (!first) result += ",";
-            result += "{\"user_id\":" + std::to_string(friend_id) +
-                      ",\"username\":\"" + friend_user.username +
-                      "\",\"elo\":" + std::to_string(friend_user.elo_rating) + "}";
-            first = false;
-        }
-    }
-    result += "]}";
-    return result;
-}
-
-std::string handle_reject_friend_request(const http_request& req) {
-    std::string token = extract_token(req);
+std::string handle_reject_friend_request(const http_request_view& req) {
+    std::string_view token = extract_token(req);
     if (token.empty()) {
         return "{\"error\":\"Missing token\"}";
     }
@@ -444,41 +632,136 @@ std::string handle_reject_friend_request(const http_request& req) {
     return "{\"error\":\"Failed to reject friend request\"}";
 }
 
-std::string handle_friend_recommendations(const http_request& req) {
-    std::string token = extract_token(req);
-    if (token.empty()) {
-        return "{\"error\":\"Missing token\"}";
+// Browsers cannot set headers on a WebSocket, so the token may also come as
+// /ws?token=...; the socket joins the channel named by the user id.
+uint64_t authenticate_socket(const http_request_view& req) {
+    std::string token;
+    if (!req.query_param("token", token) || token.empty()) {
+        token = extract_token(req);
     }
-    
     uint64_t user_id = 0;
-    if (!game->verify_session(token, user_id)) {
-        return "{\"error\":\"Invalid session\"}";
+    if (token.empty() || !game->verify_session(token, user_id)) {
+        return 0;
     }
+    return user_id;
+}
+
+// Moves are opaque to the server (it keeps no board), so only short
+// notation-like strings are relayed.
+bool is_move_notation(const std::string& move) {
+    if (move.empty() || move.size() > 10) {
+        return false;
+    }
+    for (char c : move) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '=' && c != '+' && c != '#') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Live game traffic between two players: {"type":"move","to":id,"move":"e2e4"},
+// or resign / draw_offer / draw_accept. The recipient gets the same message
+// with "from" in place of "to".
+void handle_socket_message(uint64_t user_id, std::string message) {
+    json_value body = json_parser::parse(message);
+    if (body.value_type != json_value::object_type ||
+        body.object_val["type"].value_type != json_value::string_type ||
+        body.object_val["to"].value_type != json_value::number_type) {
+        server->publish(user_id, "{\"type\":\"error\",\"error\":\"Invalid message\"}");
+        return;
+    }
+    
+    const std::string& type = body.object_val["type"].string_val;
+    uint64_t to = (uint64_t)body.object_val["to"].number_val;
+    std::string relayed = "{\"type\":\"" + type + "\",\"from\":" + std::to_string(user_id);
+    if (type == "move") {
+        const json_value& move = body.object_val["move"];
+        if (move.value_type != json_value::string_type || !is_move_notation(move.string_val)) {
+            server->publish(user_id, "{\"type\":\"error\",\"error\":\"Invalid move\"}");
+            return;
+        }
+        relayed += ",\"move\":\"" + move.string_val + "\"";
+    } else if (type != "resign" && type != "draw_offer" && type != "draw_accept") {
+        server->publish(user_id, "{\"type\":\"error\",\"error\":\"Unknown message type\"}");
+        return;
+    }
+    relayed += "}";
     
-    std::vector<uint64_t> recommendations;
-    game->get_friend_recommendations(user_id, recommendations);
-    
-    std::string result = "{\"recommendations\":[";
-    bool first = true;
-    for (uint64_t rec_id : recommendations) {
-        user_data rec_user;
-        if (game->get_user(rec_id, rec_user)) {
-            if (!first) result += ",";
-            result += "{\"user_id\":" + std::to_string(rec_id) +
-                      ",\"username\":\"" + rec_user.username +
-                      "\",\"elo\":" + std::to_string(rec_user.elo_rating) + "}";
-            first = false;
+    if (to == user_id || server->publish(to, relayed) == 0) {
+        server->publish(user_id, "{\"type\":\"error\",\"error\":\"Opponent offline\"}");
+    }
+}
+
+// Tells a user's friends when their first socket opens or last one closes.
+void handle_presence(uint64_t user_id, bool online) {
+    game->note_presence_change(user_id);
+    std::vector<uint64_t> friends;
+    game->get_friends(user_id, friends);
+    std::string event = "{\"type\":\"presence\",\"user_id\":" + std::to_string(user_id) +
+                        ",\"online\":" + (online ? "true" : "false") + "}";
+    for (uint64_t friend_id : friends) {
+        server->publish(friend_id, event);
+    }
+}
+
+uint64_t users_version(const http_request_view&) {
+    return game->get_users_version();
+}
+
+uint64_t profile_version(const http_request_view& req) {
+    uint64_t user_id = 0;
+    for (char c : req.param("id")) {
+        if (c < '0' || c > '9') {
+            return 0;
         }
+        user_id = user_id * 10 + (c - '0');
     }
-    result += "]}";
-    return result;
+    return game->get_profile_version(user_id);
 }
 
-std::string handle_health(const http_request& req) {
+// Public views depend only on users' public fields, so a rendered body stays
+// good until its version moves: a matching If-None-Match gets a 304 and a
+// cache hit skips the handler entirely. Hits share the cached buffer, plain
+// or gzipped, rather than copying it.
+route_handler cached_view(std::string (*render)(const http_request_view&),
+                          uint64_t (*version_of)(const http_request_view&)) {
+    return [render, version_of](const http_request_view& req) {
+        uint64_t version = version_of(req);
+        std::string etag = version_etag(version);
+        if (client_has_version(req, etag)) {
+            return with_etag(http_response(304, std::string()), etag, "no-cache");
+        }
+        response_cache::body_ptr gzip_body;
+        response_cache::body_ptr body = public_responses->get(
+            response_cache::make_key(req.path, req.query), version,
+            [render, &req]() { return render(req); }, gzip_body);
+        if (gzip_body && gzip_utils::accepts_gzip(req.header("Accept-Encoding"))) {
+            size_t length = gzip_body->size();
+            return with_etag(http_response::shared(200, std::move(gzip_body), 0, length, "application/json")
+                                 .add_header("Content-Encoding", "gzip"), etag, "no-cache");
+        }
+        size_t length = body->size();
+        return with_etag(http_response::shared(200, std::move(body), 0, length, "application/json"), etag, "no-cache");
+    };
+}
+
+std::string handle_health(const http_request_view&) {
     return "{\"status\":\"ok\",\"message\":\"Chess Platform Server Running\"}";
 }
 
+std::string handle_metrics(const http_request_view&) {
+    return server->metrics_json();
+}
+
 int main() {
+    // Blocked before any thread starts so every thread inherits the mask and
+    // Ctrl+C is only ever taken by the sigwait() below.
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+    
     char exe_path[1024];
     ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
     if (len != -1) {
@@ -509,17 +792,39 @@ int main() {
     }
     
     game = std::make_unique<game_state>();
-    server = std::make_unique<http_server>(8080, client_path);
+    etag_epoch = std::to_string(time_utils::get_current_timestamp_ms());
+    waitlist = std::make_unique<match_waitlist>(25000);
+    http_server_config config;
+    public_responses = std::make_unique<response_cache>(512, config.gzip_level, config.gzip_min_bytes);
+    // Re-read client/ when files change; handy while editing the frontend.
+    config.watch_static_files = getenv("CHESS_WATCH_STATIC") != nullptr;
+    config.use_io_uring = getenv("CHESS_IO_URING") != nullptr;
+    server = std::make_unique<http_server>(8080, client_path, config);
+    server->add_metrics_source("response_cache", []() { return public_responses->stats_json(); });
+    
+    // Password hashing is CPU-bound, so the auth pool is kept small and its
+    // queue short: a flood gets 503s rather than minutes of backlog.
+    auth_pool = std::make_unique<worker_pool>(2, 64, 2000);
+    recommendation_pool = std::make_unique<worker_pool>(2, 256, 1000);
+    server->add_metrics_source("offload_pools", []() {
+        return "{\"auth\":{\"threads\":" + std::to_string(auth_pool->thread_count()) +
+               ",\"queue_depth\":" + std::to_string(auth_pool->queue_depth()) +
+               "},\"recommendations\":{\"threads\":" + std::to_string(recommendation_pool->thread_count()) +
+               ",\"queue_depth\":" + std::to_string(recommendation_pool->queue_depth()) + "}}";
+    });
     
     server->register_route("GET", "/health", handle_health);
-    server->register_route("POST", "/auth/register", handle_register);
-    server->register_route("POST", "/auth/login", handle_login);
+    server->register_route("GET", "/metrics", handle_metrics);
+    server->register_async_route("POST", "/auth/register", offload_to(*auth_pool, handle_register));
+    server->register_async_route("POST", "/auth/login", offload_to(*auth_pool, handle_login));
     server->register_route("POST", "/auth/logout", handle_logout);
     server->register_route("GET", "/user/me", handle_get_user);
-    server->register_route("GET", "/leaderboard", handle_leaderboard);
-    server->register_route("GET", "/users/search", handle_search_users);
+    server->register_route("GET", "/leaderboard", cached_view(handle_leaderboard, users_version));
+    server->register_route("GET", "/users/search", cached_view(handle_search_users, users_version));
+    server->register_route("GET", "/users/:id", cached_view(handle_get_user_profile, profile_version));
     server->register_route("POST", "/match/queue", handle_queue_for_match);
     server->register_route("POST", "/match/find", handle_find_match);
+    server->register_async_route("POST", "/match/wait", handle_wait_for_match);
     server->register_route("GET", "/match/history", handle_get_match_history);
     server->register_route("POST", "/match/record", handle_record_match);
     server->register_route("POST", "/friends/request", handle_send_friend_request);
@@ -527,20 +832,63 @@ int main() {
     server->register_route("POST", "/friends/reject", handle_reject_friend_request);
     server->register_route("GET", "/friends/pending", handle_get_pending_friend_requests);
     server->register_route("GET", "/friends/list", handle_get_friends);
-    server->register_route("GET", "/friends/recommendations", handle_friend_recommendations);
+    server->register_async_route("GET", "/friends/recommendations",
+                                 offload_to(*recommendation_pool, handle_friend_recommendations));
+    server->register_route("POST", "/batch", handle_batch);
+    
+    websocket_endpoint live;
+    live.authenticate = authenticate_socket;
+    live.on_message = handle_socket_message;
+    live.on_presence = handle_presence;
+    server->register_websocket("/ws", live);
+    
+    // Password hashing is deliberately slow, so the auth routes are held to
+    // a few attempts per client address; session routes are bounded per
+    // token and the public ones per address.
+    route_limits auth_limits;
+    auth_limits.per_address = rate_limit(2, 20);
+    server->set_rate_limit("POST", "/auth/login", auth_limits);
+    server->set_rate_limit("POST", "/auth/register", auth_limits);
+    
+    route_limits public_limits;
+    public_limits.per_address = rate_limit(50, 100);
+    server->set_rate_limit("GET", "/leaderboard", public_limits);
+    server->set_rate_limit("GET", "/users/search", public_limits);
+    server->set_rate_limit("GET", "/users/:id", public_limits);
+    
+    route_limits session_limits;
+    session_limits.per_address = rate_limit(50, 100);
+    session_limits.per_token = rate_limit(20, 40);
+    const char* session_routes[][2] = {
+        {"POST", "/auth/logout"}, {"GET", "/user/me"}, {"POST", "/match/queue"}, {"POST", "/match/find"},
+        {"POST", "/match/wait"}, {"GET", "/match/history"}, {"POST", "/match/record"},
+        {"POST", "/friends/request"}, {"POST", "/friends/accept"}, {"POST", "/friends/reject"},
+        {"GET", "/friends/pending"}, {"GET", "/friends/list"}, {"GET", "/friends/recommendations"}, {"POST", "/batch"},
+        {"GET", "/ws"}
+    };
+    for (const auto& route : session_routes) {
+        server->set_rate_limit(route[0], route[1], session_limits);
+    }
     
     std::cout << "Chess Platform Server starting on port 8080..." << std::endl;
     
+    // start() also returns without a stop() when it cannot bind; it then
+    // raises SIGINT itself so the wait below does not outlive it.
     std::thread server_thread([&]() {
         server->start();
+        kill(getpid(), SIGINT);
     });
     
     std::cout << "Server running. Press Ctrl+C to stop." << std::endl;
-    std::signal(SIGINT, [](int sig) {
+    // Ctrl+C only asks the server to stop. start() finishes its own teardown
+    // and main returns normally, so the globals above are destroyed in their
+    // declared order rather than under a still-running server.
+    int signal_number = 0;
+    sigwait(&shutdown_signals, &signal_number);
+    if (server->is_running()) {
         std::cout << "\nShutting down..." << std::endl;
-        exit(0);
-    });
-    
+    }
+    server->stop();
     server_thread.join();
     
     return 0;
@@ -14,6 +14,10 @@
 #include "../utils/file_utils.hpp"
 #include "../utils/json_parser.hpp"
 #include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <atomic>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
@@ -39,6 +43,42 @@ struct matchmaking_entry {
     }
 };
 
+// Everything a dashboard load reads, gathered under one set of locks so the
+// parts agree with each other. Only the requested sections are filled in.
+struct dashboard_snapshot {
+    enum section {
+        user_section = 1,
+        friends_section = 2,
+        pending_section = 4,
+        recommendations_section = 8,
+        history_section = 16
+    };
+    
+    uint64_t user_id;
+    bool has_user;
+    user_data user;
+    std::vector<user_data> friends;
+    std::vector<user_data> pending;
+    std::vector<user_data> recommendations;
+    std::vector<match_data> matches;
+    // Parallel to matches; "Unknown" for deleted opponents.
+    std::vector<std::string> opponent_names;
+    
+    dashboard_snapshot() : user_id(0), has_user(false) {}
+};
+
+// Per-user version stamps for conditional GETs. Every bump draws a fresh
+// value from one clock, so a stamp never repeats even for a new user.
+struct resource_stamps {
+    uint64_t profile;
+    uint64_t friends;
+    uint64_t pending;
+    uint64_t history;
+    uint64_t presence;
+    
+    resource_stamps() : profile(0), friends(0), pending(0), history(0), presence(0) {}
+};
+
 class game_state {
 private:
     hash_table<std::string, user_data> users;
@@ -50,12 +90,44 @@ private:
     lru_cache<uint64_t, user_data> session_cache;
     hash_table<uint64_t, std::vector<uint64_t>> pending_friend_requests;
     
-    uint64_t next_match_id;
-    uint64_t next_user_id;
-    
-    std::mutex state_mutex;
+    // Atomic because they are read without their domain's lock: save_users
+    // writes out next_match_id, save_friend_graph walks up to next_user_id.
+    std::atomic<uint64_t> next_match_id;
+    std::atomic<uint64_t> next_user_id;
+    
+    // Each domain has its own lock so readers of one never wait on writers
+    // of another; the containers lock themselves per call, these make the
+    // multi-step updates and file saves atomic. Operations that need more
+    // than one take them in this order and never the other way round:
+    //
+    //   users -> sessions -> friends -> pending -> matches -> queue -> stamps
+    //
+    // users guards users, user_id_to_username, session_cache, next_user_id.
+    // record_match holds users then matches so a match and the ratings it
+    // changed are seen together; register_user holds users then friends.
+    std::shared_mutex users_mutex;
+    std::shared_mutex sessions_mutex;
+    std::shared_mutex friends_mutex;
+    std::shared_mutex pending_mutex;
+    std::shared_mutex matches_mutex;
+    std::mutex queue_mutex;
+    std::mutex stamps_mutex;
+    // Bumped after any change to a user's public fields (name, rating,
+    // record), so cached leaderboards and profiles know they are stale.
+    std::atomic<uint64_t> users_version;
+    std::atomic<uint64_t> friendships_version;
+    // Guarded by stamps_mutex, always the innermost lock.
+    std::unordered_map<uint64_t, resource_stamps> stamps;
+    uint64_t stamp_clock;
     
     std::string get_username_by_id(uint64_t user_id);
+    bool find_session(std::string_view token, uint64_t& user_id);
+    bool take_pending_request(uint64_t user_id, uint64_t friend_id);
+    bool find_user(uint64_t user_id, user_data& user);
+    void find_users(const std::vector<uint64_t>& user_ids, std::vector<user_data>& found);
+    void collect_match_history(uint64_t user_id, std::vector<match_data>& history);
+    void bump(uint64_t user_id, uint64_t resource_stamps::*resource);
+    uint64_t stamp(uint64_t user_id, uint64_t resource_stamps::*resource) const;
     void save_users();
     void load_users();
     void save_friend_requests();
@@ -70,8 +142,8 @@ public:
     
     bool register_user(const std::string& username, const std::string& password);
     bool login_user(const std::string& username, const std::string& password, std::string& token);
-    bool logout_user(const std::string& token);
-    bool verify_session(const std::string& token, uint64_t& user_id);
+    bool logout_user(std::string_view token);
+    bool verify_session(std::string_view token, uint64_t& user_id);
     
     uint64_t get_user_id_by_username(const std::string& username);
     
@@ -91,9 +163,22 @@ public:
     
     bool record_match(uint64_t player1_id, uint64_t player2_id, uint64_t winner_id, int elo_change);
     void get_match_history(uint64_t user_id, std::vector<match_data>& history);
+    
+    uint64_t get_users_version() const { return users_version.load(); }
+    uint64_t get_profile_version(uint64_t user_id);
+    // Folds the stamps behind the requested dashboard sections into one
+    // value without copying or rendering anything; it changes whenever
+    // what get_dashboard_snapshot would return for them does.
+    bool get_dashboard_version(std::string_view token, int sections, uint64_t& version);
+    // Presence is tracked by the server, but friends lists show it.
+    void note_presence_change(uint64_t user_id);
+    
+    // Verifies the token and reads the requested sections (a mask of
+    // dashboard_snapshot::section) in one critical section.
+    bool get_dashboard_snapshot(std::string_view token, int sections, dashboard_snapshot& snapshot);
 };
 
-inline game_state::game_state() : users(2048), user_id_to_username(2048), sessions(1024), match_history(5), friend_graph(), session_cache(512), pending_friend_requests(1024) {
+inline game_state::game_state() : users(2048), user_id_to_username(2048), sessions(1024), match_history(5), friend_graph(), session_cache(512), pending_friend_requests(1024), users_version(1), friendships_version(0), stamp_clock(0) {
     next_match_id = 1;
     next_user_id = 1;
     try {
@@ -115,16 +200,17 @@ inline std::string game_state::get_username_by_id(uint64_t user_id) {
     return "";
 }
 
+// The hash runs before any lock is taken; a name claimed meanwhile by
+// another registration is caught by the second lookup.
 inline bool game_state::register_user(const std::string& username, const std::string& password) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
-    user_data existing;
-    if (users.find(username, existing)) {
-        return false;
+    {
+        std::shared_lock<std::shared_mutex> users_lock(users_mutex);
+        if (users.contains(username)) {
+            return false;
+        }
     }
     
     user_data new_user;
-    new_user.user_id = next_user_id++;
     new_user.username = username;
     new_user.salt = password_hash::generate_salt();
     new_user.password_hash = password_hash::hash_password(password, new_user.salt);
@@ -137,89 +223,127 @@ inline bool game_state::register_user(const std::string& username, const std::st
     new_user.last_login_timestamp = 0;
     new_user.is_online = false;
     
+    std::unique_lock<std::shared_mutex> users_lock(users_mutex);
+    if (users.contains(username)) {
+        return false;
+    }
+    new_user.user_id = next_user_id++;
+    
     users.insert(username, new_user);
     user_id_to_username.insert(new_user.user_id, username);
-    friend_graph.add_vertex(new_user.user_id, username);
+    {
+        std::unique_lock<std::shared_mutex> friends_lock(friends_mutex);
+        friend_graph.add_vertex(new_user.user_id, username);
+    }
+    users_version++;
+    bump(new_user.user_id, &resource_stamps::profile);
     save_users();
     
     return true;
 }
 
 inline bool game_state::login_user(const std::string& username, const std::string& password, std::string& token) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
-    user_data user;
-    if (!users.find(username, user)) {
-        return false;
+    uint64_t user_id = 0;
+    std::string salt;
+    std::string stored_hash;
+    {
+        std::shared_lock<std::shared_mutex> users_lock(users_mutex);
+        bool found = users.with_value(username, [&](const user_data& user) {
+            user_id = user.user_id;
+            salt = user.salt;
+            stored_hash = user.password_hash;
+        });
+        if (!found) {
+            return false;
+        }
     }
     
-    if (!password_hash::verify_password(password, user.salt, user.password_hash)) {
+    if (!password_hash::verify_password(password, salt, stored_hash)) {
         return false;
     }
     
-    user.is_online = true;
-    user.last_login_timestamp = time_utils::get_current_timestamp();
-    users.update(username, user);
-    friend_graph.set_online(user.user_id, true);
-    save_users();
+    {
+        std::unique_lock<std::shared_mutex> users_lock(users_mutex);
+        // Edit in place rather than write back the copy read above: a match
+        // may have been recorded while the hash ran. session_cache takes its
+        // own lock inside the table's, never the other way round.
+        bool found = users.modify(username, [&](user_data& user) {
+            user.is_online = true;
+            user.last_login_timestamp = time_utils::get_current_timestamp();
+            session_cache.put(user.user_id, user);
+        });
+        if (!found) {
+            return false;
+        }
+        {
+            std::unique_lock<std::shared_mutex> friends_lock(friends_mutex);
+            friend_graph.set_online(user_id, true);
+        }
+        save_users();
+    }
     
     session_data session;
-    session.token = std::to_string(user.user_id) + "_" + std::to_string(time_utils::get_current_timestamp_ms());
-    session.user_id = user.user_id;
+    session.token = std::to_string(user_id) + "_" + std::to_string(time_utils::get_current_timestamp_ms());
+    session.user_id = user_id;
     session.created_at = time_utils::get_current_timestamp();
     session.expires_at = session.created_at + 86400;
     session.is_valid = true;
     
-    sessions.insert(session.token, session);
-    session_cache.put(user.user_id, user);
+    {
+        std::unique_lock<std::shared_mutex> sessions_lock(sessions_mutex);
+        sessions.insert(session.token, session);
+    }
     token = session.token;
     
     return true;
 }
 
-inline bool game_state::logout_user(const std::string& token) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
-    session_data session;
-    if (!sessions.find(token, session)) {
-        return false;
+inline bool game_state::logout_user(std::string_view token) {
+    uint64_t user_id = 0;
+    {
+        std::unique_lock<std::shared_mutex> sessions_lock(sessions_mutex);
+        if (!sessions.with_value(token, [&user_id](const session_data& session) { user_id = session.user_id; })) {
+            return false;
+        }
+        sessions.remove(token);
     }
     
-    sessions.remove(token);
-    
-    std::string username = get_username_by_id(session.user_id);
+    std::unique_lock<std::shared_mutex> users_lock(users_mutex);
+    std::string username = get_username_by_id(user_id);
     if (!username.empty()) {
-        user_data user;
-        if (users.find(username, user)) {
-            user.is_online = false;
-            users.update(username, user);
-        }
+        users.modify(username, [](user_data& user) { user.is_online = false; });
     }
     
-    friend_graph.set_online(session.user_id, false);
+    std::unique_lock<std::shared_mutex> friends_lock(friends_mutex);
+    friend_graph.set_online(user_id, false);
     
     return true;
 }
 
-inline bool game_state::verify_session(const std::string& token, uint64_t& user_id) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
-    session_data session;
-    if (!sessions.find(token, session)) {
-        return false;
-    }
-    
-    if (!session.is_valid || session.expires_at < time_utils::get_current_timestamp()) {
-        return false;
-    }
-    
-    user_id = session.user_id;
-    return true;
+inline bool game_state::verify_session(std::string_view token, uint64_t& user_id) {
+    std::shared_lock<std::shared_mutex> sessions_lock(sessions_mutex);
+    return find_session(token, user_id);
+}
+
+inline bool game_state::find_session(std::string_view token, uint64_t& user_id) {
+    bool valid = false;
+    sessions.with_value(token, [&](const session_data& session) {
+        if (session.is_valid && session.expires_at >= time_utils::get_current_timestamp()) {
+            user_id = session.user_id;
+            valid = true;
+        }
+    });
+    return valid;
 }
 
 inline bool game_state::get_user(uint64_t user_id, user_data& user) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
+    std::shared_lock<std::shared_mutex> users_lock(users_mutex);
+    return find_user(user_id, user);
+}
+
+// Shared users lock is enough: session_cache locks itself, and writers that
+// change a user refresh its cached copy under the exclusive lock.
+inline bool game_state::find_user(uint64_t user_id, user_data& user) {
     if (session_cache.get(user_id, user)) {
         return true;
     }
@@ -233,37 +357,49 @@ inline bool game_state::get_user(uint64_t user_id, user_data& user) {
     return false;
 }
 
+inline void game_state::find_users(const std::vector<uint64_t>& user_ids, std::vector<user_data>& found) {
+    found.clear();
+    found.reserve(user_ids.size());
+    for (uint64_t user_id : user_ids) {
+        user_data user;
+        if (find_user(user_id, user)) {
+            found.push_back(user);
+        }
+    }
+}
+
 inline void game_state::get_all_users(std::vector<user_data>& users_list) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::shared_lock<std::shared_mutex> users_lock(users_mutex);
     users_list.clear();
-    users.iterate([&](const std::string& username, const user_data& user) {
+    users.iterate([&](const std::string&, const user_data& user) {
         users_list.push_back(user);
     });
 }
 
 inline bool game_state::update_user_elo(uint64_t user_id, int elo_change) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::unique_lock<std::shared_mutex> users_lock(users_mutex);
     
     std::string username = get_username_by_id(user_id);
     if (username.empty()) {
         return false;
     }
     
-    user_data user;
-    if (!users.find(username, user)) {
+    bool found = users.modify(username, [&](user_data& user) {
+        user.elo_rating += elo_change;
+        session_cache.put(user_id, user);
+    });
+    if (!found) {
         return false;
     }
-    
-    user.elo_rating += elo_change;
-    users.update(username, user);
-    session_cache.put(user_id, user);
+    users_version++;
+    bump(user_id, &resource_stamps::profile);
     save_users();
     
     return true;
 }
 
 inline void game_state::queue_for_matchmaking(uint64_t user_id, int elo_rating) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::lock_guard<std::mutex> queue_lock(queue_mutex);
     
     matchmaking_entry entry;
     entry.user_id = user_id;
@@ -274,7 +410,7 @@ inline void game_state::queue_for_matchmaking(uint64_t user_id, int elo_rating)
 }
 
 inline bool game_state::find_match(uint64_t user_id, uint64_t& opponent_id) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::lock_guard<std::mutex> queue_lock(queue_mutex);
     
     if (matchmaking_queue.empty() || matchmaking_queue.size() < 2) {
         return false;
@@ -324,12 +460,12 @@ inline bool game_state::find_match(uint64_t user_id, uint64_t& opponent_id) {
 }
 
 inline bool game_state::send_friend_request(uint64_t sender_id, uint64_t receiver_id) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
     if (sender_id == receiver_id) {
         return false;
     }
     
+    std::shared_lock<std::shared_mutex> friends_lock(friends_mutex);
+    
     if (!friend_graph.contains_vertex(sender_id) || !friend_graph.contains_vertex(receiver_id)) {
         return false;
     }
@@ -340,95 +476,103 @@ inline bool game_state::send_friend_request(uint64_t sender_id, uint64_t receive
         return false;
     }
     
-    std::vector<uint64_t> pending;
-    if (!pending_friend_requests.find(receiver_id, pending)) {
-        pending = std::vector<uint64_t>();
-    }
+    std::unique_lock<std::shared_mutex> pending_lock(pending_mutex);
     
-    if (std::find(pending.begin(), pending.end(), sender_id) != pending.end()) {
+    bool already_sent = false;
+    bool has_pending = pending_friend_requests.modify(receiver_id, [&](std::vector<uint64_t>& pending) {
+        if (std::find(pending.begin(), pending.end(), sender_id) != pending.end()) {
+            already_sent = true;
+        } else {
+            pending.push_back(sender_id);
+        }
+    });
+    if (already_sent) {
         return false;
     }
-    
-    pending.push_back(sender_id);
-    pending_friend_requests.insert(receiver_id, pending);
+    if (!has_pending) {
+        pending_friend_requests.insert(receiver_id, std::vector<uint64_t>{sender_id});
+    }
+    bump(receiver_id, &resource_stamps::pending);
     save_friend_requests();
     
     return true;
 }
 
 inline bool game_state::accept_friend_request(uint64_t user_id, uint64_t friend_id) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::unique_lock<std::shared_mutex> friends_lock(friends_mutex);
     
     if (!friend_graph.contains_vertex(user_id) || !friend_graph.contains_vertex(friend_id)) {
         return false;
     }
     
-    std::vector<uint64_t> pending;
-    if (!pending_friend_requests.find(user_id, pending)) {
-        return false;
-    }
+    std::unique_lock<std::shared_mutex> pending_lock(pending_mutex);
     
-    auto it = std::find(pending.begin(), pending.end(), friend_id);
-    if (it == pending.end()) {
+    if (!take_pending_request(user_id, friend_id)) {
         return false;
     }
     
-    pending.erase(it);
-    if (pending.empty()) {
-        pending_friend_requests.remove(user_id);
-    } else {
-        pending_friend_requests.insert(user_id, pending);
-    }
-    
     friend_graph.add_edge(user_id, friend_id);
+    bump(user_id, &resource_stamps::pending);
+    bump(user_id, &resource_stamps::friends);
+    bump(friend_id, &resource_stamps::friends);
+    friendships_version++;
     save_friend_requests();
     save_friend_graph();
     
     return true;
 }
 
-inline bool game_state::reject_friend_request(uint64_t user_id, uint64_t friend_id) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
-    std::vector<uint64_t> pending;
-    if (!pending_friend_requests.find(user_id, pending)) {
-        return false;
+// Caller holds pending_mutex exclusively.
+inline bool game_state::take_pending_request(uint64_t user_id, uint64_t friend_id) {
+    bool taken = false;
+    bool now_empty = false;
+    pending_friend_requests.modify(user_id, [&](std::vector<uint64_t>& pending) {
+        auto it = std::find(pending.begin(), pending.end(), friend_id);
+        if (it != pending.end()) {
+            pending.erase(it);
+            taken = true;
+            now_empty = pending.empty();
+        }
+    });
+    if (now_empty) {
+        pending_friend_requests.remove(user_id);
     }
+    return taken;
+}
+
+inline bool game_state::reject_friend_request(uint64_t user_id, uint64_t friend_id) {
+    std::unique_lock<std::shared_mutex> pending_lock(pending_mutex);
     
-    auto it = std::find(pending.begin(), pending.end(), friend_id);
-    if (it == pending.end()) {
+    if (!take_pending_request(user_id, friend_id)) {
         return false;
     }
     
-    pending.erase(it);
-    if (pending.empty()) {
-        pending_friend_requests.remove(user_id);
-    } else {
-        pending_friend_requests.insert(user_id, pending);
-    }
-    
+    bump(user_id, &resource_stamps::pending);
     save_friend_requests();
     return true;
 }
 
 inline void game_state::get_pending_friend_requests(uint64_t user_id, std::vector<uint64_t>& requests) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::shared_lock<std::shared_mutex> pending_lock(pending_mutex);
     requests.clear();
     pending_friend_requests.find(user_id, requests);
 }
 
 inline void game_state::get_friends(uint64_t user_id, std::vector<uint64_t>& friends) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::shared_lock<std::shared_mutex> friends_lock(friends_mutex);
     friend_graph.get_friends(user_id, friends);
 }
 
 inline void game_state::get_friend_recommendations(uint64_t user_id, std::vector<uint64_t>& recommendations) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::shared_lock<std::shared_mutex> friends_lock(friends_mutex);
     friend_graph.get_friend_recommendations(user_id, 10, recommendations);
 }
 
+// Holds users then matches, so nobody sees the match without the rating
+// change it caused or the other way round.
 inline bool game_state::record_match(uint64_t player1_id, uint64_t player2_id, uint64_t winner_id, int elo_change) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+    std::unique_lock<std::shared_mutex> users_lock(users_mutex);
+    std::unique_lock<std::shared_mutex> matches_lock(matches_mutex);
     
     match_data match;
     match.match_id = next_match_id++;
@@ -442,42 +586,46 @@ inline bool game_state::record_match(uint64_t player1_id, uint64_t player2_id, u
     match.result = (winner_id == player1_id ? 1 : 2);
     
     match_history.insert(match.timestamp, match);
-    save_users();
     save_match_history();
     
     std::string username1 = get_username_by_id(player1_id);
     std::string username2 = get_username_by_id(player2_id);
     
     if (!username1.empty()) {
-        user_data user;
-        if (users.find(username1, user)) {
+        users.modify(username1, [&](user_data& user) {
             user.elo_rating += elo_change;
             user.total_matches += 1;
             if (winner_id == player1_id) user.wins += 1;
             else user.losses += 1;
-            users.update(username1, user);
             session_cache.put(player1_id, user);
-        }
+        });
     }
     
     if (!username2.empty()) {
-        user_data user;
-        if (users.find(username2, user)) {
+        users.modify(username2, [&](user_data& user) {
             user.elo_rating -= elo_change;
             user.total_matches += 1;
             if (winner_id == player2_id) user.wins += 1;
             else user.losses += 1;
-            users.update(username2, user);
             session_cache.put(player2_id, user);
-        }
+        });
     }
+    save_users();
+    users_version++;
+    bump(player1_id, &resource_stamps::profile);
+    bump(player2_id, &resource_stamps::profile);
+    bump(player1_id, &resource_stamps::history);
+    bump(player2_id, &resource_stamps::history);
     
     return true;
 }
 
 inline void game_state::get_match_history(uint64_t user_id, std::vector<match_data>& history) {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    
+    std::shared_lock<std::shared_mutex> matches_lock(matches_mutex);
+    collect_match_history(user_id, history);
+}
+
+inline void game_state::collect_match_history(uint64_t user_id, std::vector<match_data>& history) {
     uint64_t start_time = time_utils::get_current_timestamp() - (30 * 24 * 3600);
     uint64_t end_time = time_utils::get_current_timestamp();
     
@@ -491,14 +639,146 @@ inline void game_state::get_match_history(uint64_t user_id, std::vector<match_da
     }
 }
 
-inline uint64_t game_state::get_user_id_by_username(const std::string& username) {
-    std::lock_guard<std::mutex> lock(state_mutex);
+// Takes, in the documented order, a shared lock on each domain the
+// requested sections read, so the sections agree with each other while
+// writers to unrelated domains carry on.
+inline bool game_state::get_dashboard_snapshot(std::string_view token, int sections, dashboard_snapshot& snapshot) {
+    const int friend_sections = dashboard_snapshot::friends_section | dashboard_snapshot::recommendations_section;
+    std::shared_lock<std::shared_mutex> users_lock(users_mutex);
+    std::shared_lock<std::shared_mutex> sessions_lock(sessions_mutex);
+    std::shared_lock<std::shared_mutex> friends_lock(friends_mutex, std::defer_lock);
+    std::shared_lock<std::shared_mutex> pending_lock(pending_mutex, std::defer_lock);
+    std::shared_lock<std::shared_mutex> matches_lock(matches_mutex, std::defer_lock);
+    if (sections & friend_sections) {
+        friends_lock.lock();
+    }
+    if (sections & dashboard_snapshot::pending_section) {
+        pending_lock.lock();
+    }
+    if (sections & dashboard_snapshot::history_section) {
+        matches_lock.lock();
+    }
     
-    user_data user;
-    if (users.find(username, user)) {
-        return user.user_id;
+    if (!find_session(token, snapshot.user_id)) {
+        return false;
+    }
+    uint64_t user_id = snapshot.user_id;
+    
+    if (sections & dashboard_snapshot::user_section) {
+        snapshot.has_user = find_user(user_id, snapshot.user);
     }
-    return 0;
+    if (sections & dashboard_snapshot::friends_section) {
+        std::vector<uint64_t> friend_ids;
+        friend_graph.get_friends(user_id, friend_ids);
+        find_users(friend_ids, snapshot.friends);
+    }
+    if (sections & dashboard_snapshot::pending_section) {
+        std::vector<uint64_t> sender_ids;
+        pending_friend_requests.find(user_id, sender_ids);
+        find_users(sender_ids, snapshot.pending);
+    }
+    if (sections & dashboard_snapshot::recommendations_section) {
+        std::vector<uint64_t> recommended_ids;
+        friend_graph.get_friend_recommendations(user_id, 10, recommended_ids);
+        find_users(recommended_ids, snapshot.recommendations);
+    }
+    if (sections & dashboard_snapshot::history_section) {
+        snapshot.matches.clear();
+        collect_match_history(user_id, snapshot.matches);
+        snapshot.opponent_names.clear();
+        for (const match_data& match : snapshot.matches) {
+            uint64_t opponent_id = (match.player1_id == user_id) ? match.player2_id : match.player1_id;
+            user_data opponent;
+            snapshot.opponent_names.push_back(find_user(opponent_id, opponent) ? opponent.username : "Unknown");
+        }
+    }
+    return true;
+}
+
+inline void game_state::bump(uint64_t user_id, uint64_t resource_stamps::*resource) {
+    std::lock_guard<std::mutex> stamps_lock(stamps_mutex);
+    stamps[user_id].*resource = ++stamp_clock;
+}
+
+// Caller holds stamps_mutex.
+inline uint64_t game_state::stamp(uint64_t user_id, uint64_t resource_stamps::*resource) const {
+    auto it = stamps.find(user_id);
+    return it == stamps.end() ? 0 : it->second.*resource;
+}
+
+inline uint64_t game_state::get_profile_version(uint64_t user_id) {
+    std::lock_guard<std::mutex> stamps_lock(stamps_mutex);
+    return stamp(user_id, &resource_stamps::profile);
+}
+
+inline void game_state::note_presence_change(uint64_t user_id) {
+    bump(user_id, &resource_stamps::presence);
+}
+
+// Lists that show other users' ratings fold in those users' profile stamps
+// too, so a friend's match changes the friends list's version.
+inline bool game_state::get_dashboard_version(std::string_view token, int sections, uint64_t& version) {
+    uint64_t user_id = 0;
+    std::shared_lock<std::shared_mutex> sessions_lock(sessions_mutex);
+    if (!find_session(token, user_id)) {
+        return false;
+    }
+    sessions_lock.unlock();
+    
+    std::vector<uint64_t> friend_ids;
+    std::vector<uint64_t> sender_ids;
+    if (sections & dashboard_snapshot::friends_section) {
+        std::shared_lock<std::shared_mutex> friends_lock(friends_mutex);
+        friend_graph.get_friends(user_id, friend_ids);
+    }
+    if (sections & dashboard_snapshot::pending_section) {
+        std::shared_lock<std::shared_mutex> pending_lock(pending_mutex);
+        pending_friend_requests.find(user_id, sender_ids);
+    }
+    std::lock_guard<std::mutex> stamps_lock(stamps_mutex);
+    
+    auto fold = [&version](uint64_t value) {
+        version ^= value + 0x9E3779B97F4A7C15ull + (version << 6) + (version >> 2);
+    };
+    version = user_id;
+    fold(static_cast<uint64_t>(sections));
+    
+    if (sections & dashboard_snapshot::user_section) {
+        fold(stamp(user_id, &resource_stamps::profile));
+    }
+    if (sections & dashboard_snapshot::friends_section) {
+        fold(stamp(user_id, &resource_stamps::friends));
+        for (uint64_t friend_id : friend_ids) {
+            fold(stamp(friend_id, &resource_stamps::profile));
+            fold(stamp(friend_id, &resource_stamps::presence));
+        }
+    }
+    if (sections & dashboard_snapshot::pending_section) {
+        fold(stamp(user_id, &resource_stamps::pending));
+        for (uint64_t sender_id : sender_ids) {
+            fold(stamp(sender_id, &resource_stamps::profile));
+        }
+    }
+    if (sections & dashboard_snapshot::recommendations_section) {
+        // Two hops out, so any friendship or rating anywhere may matter.
+        fold(friendships_version.load());
+        fold(users_version.load());
+    }
+    if (sections & dashboard_snapshot::history_section) {
+        // The 30-day window slides too; folding in the day lets old matches
+        // drop out of a revalidated copy within a day.
+        fold(stamp(user_id, &resource_stamps::history));
+        fold(time_utils::get_current_timestamp() / 86400);
+    }
+    return true;
+}
+
+inline uint64_t game_state::get_user_id_by_username(const std::string& username) {
+    std::shared_lock<std::shared_mutex> users_lock(users_mutex);
+    
+    uint64_t user_id = 0;
+    users.with_value(username, [&user_id](const user_data& user) { user_id = user.user_id; });
+    return user_id;
 }
 
 inline void game_state::save_users() {
@@ -563,7 +843,7 @@ inline void game_state::save_users() {
         file << "\"is_online\":" << (user.is_online ? "true" : "false");
         file << "}";
     });
-    file << "],\"next_user_id\":" << next_user_id << ",\"next_match_id\":" << next_match_id << "}";
+    file << "],\"next_user_id\":" << next_user_id.load() << ",\"next_match_id\":" << next_match_id.load() << "}";
     file.close();
 }
 
@@ -0,0 +1,190 @@
+#ifndef MATCH_WAITLIST_HPP
+#define MATCH_WAITLIST_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+#include "../core/timer_wheel.hpp"
+
+// Players parked on /match/wait, keyed by user id. A parked player is woken
+// exactly once: by deliver() when the matchmaker pairs them, or with
+// matched=false when the wait times out. Callbacks run outside the lock, on
+// whichever thread delivered the result or on the expiry thread, which only
+// wakes for the timer wheel's ticks while someone is parked.
+//
+// A result for a player who is not parked (paired while between waits) is
+// kept and answers their next park() at once, so neither side of a pairing
+// is lost.
+class match_waitlist {
+public:
+    typedef std::function<void(bool matched, uint64_t opponent_id)> waiter;
+
+private:
+    typedef std::chrono::steady_clock clock;
+    static const uint64_t tick_ms = 10;
+
+    struct parked_entry {
+        waiter callback;
+        timer_wheel<uint64_t>::timer_id timer;
+    };
+
+    std::unordered_map<uint64_t, parked_entry> parked;
+    std::unordered_map<uint64_t, uint64_t> results;
+    timer_wheel<uint64_t> deadlines;
+    std::mutex mutex_lock;
+    std::condition_variable changed;
+    uint64_t timeout;
+    bool stopping;
+    std::thread expiry_thread;
+
+    void expire_loop();
+    static uint64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now().time_since_epoch()).count();
+    }
+
+public:
+    explicit match_waitlist(uint64_t timeout_ms);
+    ~match_waitlist();
+
+    // Parks the player unless a result is already waiting for them; a
+    // still-parked earlier wait is answered as timed out.
+    void park(uint64_t user_id, waiter callback);
+    void deliver(uint64_t user_id, uint64_t opponent_id);
+    bool take_result(uint64_t user_id, uint64_t& opponent_id);
+    void forget_result(uint64_t user_id);
+    std::vector<uint64_t> parked_users();
+    size_t parked_count();
+};
+
+inline match_waitlist::match_waitlist(uint64_t timeout_ms)
+    : deadlines(tick_ms, now_ms()), timeout(timeout_ms), stopping(false) {
+    expiry_thread = std::thread(&match_waitlist::expire_loop, this);
+}
+
+// Remaining waiters are answered as timed out so no request stays parked.
+inline match_waitlist::~match_waitlist() {
+    std::unordered_map<uint64_t, parked_entry> remaining;
+    {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        stopping = true;
+        remaining.swap(parked);
+    }
+    changed.notify_all();
+    expiry_thread.join();
+    for (auto& entry : remaining) {
+        entry.second.callback(false, 0);
+    }
+}
+
+inline void match_waitlist::park(uint64_t user_id, waiter callback) {
+    waiter replaced;
+    uint64_t opponent_id = 0;
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        auto result = results.find(user_id);
+        if (result != results.end()) {
+            opponent_id = result->second;
+            results.erase(result);
+            ready = true;
+        } else {
+            parked_entry& entry = parked[user_id];
+            replaced = std::move(entry.callback);
+            deadlines.cancel(entry.timer);
+            entry.callback = std::move(callback);
+            entry.timer = deadlines.schedule(now_ms() + timeout, user_id);
+        }
+    }
+    if (ready) {
+        callback(true, opponent_id);
+        return;
+    }
+    changed.notify_one();
+    if (replaced) {
+        replaced(false, 0);
+    }
+}
+
+inline void match_waitlist::deliver(uint64_t user_id, uint64_t opponent_id) {
+    waiter callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        auto it = parked.find(user_id);
+        if (it == parked.end()) {
+            results[user_id] = opponent_id;
+            return;
+        }
+        callback = std::move(it->second.callback);
+        deadlines.cancel(it->second.timer);
+        parked.erase(it);
+    }
+    callback(true, opponent_id);
+}
+
+inline bool match_waitlist::take_result(uint64_t user_id, uint64_t& opponent_id) {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    auto it = results.find(user_id);
+    if (it == results.end()) {
+        return false;
+    }
+    opponent_id = it->second;
+    results.erase(it);
+    return true;
+}
+
+// Called when the player queues again, so a stale pairing isn't replayed.
+inline void match_waitlist::forget_result(uint64_t user_id) {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    results.erase(user_id);
+}
+
+inline std::vector<uint64_t> match_waitlist::parked_users() {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    std::vector<uint64_t> users;
+    users.reserve(parked.size());
+    for (const auto& entry : parked) {
+        users.push_back(entry.first);
+    }
+    return users;
+}
+
+inline size_t match_waitlist::parked_count() {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    return parked.size();
+}
+
+inline void match_waitlist::expire_loop() {
+    std::unique_lock<std::mutex> lock(mutex_lock);
+    while (!stopping) {
+        std::vector<waiter> expired;
+        deadlines.advance(now_ms(), [this, &expired](uint64_t user_id) {
+            auto it = parked.find(user_id);
+            if (it != parked.end()) {
+                expired.push_back(std::move(it->second.callback));
+                parked.erase(it);
+            }
+        });
+        if (!expired.empty()) {
+            lock.unlock();
+            for (auto& callback : expired) {
+                callback(false, 0);
+            }
+            lock.lock();
+            continue;
+        }
+        if (deadlines.empty()) {
+            changed.wait(lock);
+        } else {
+            changed.wait_for(lock, std::chrono::milliseconds(tick_ms - now_ms() % tick_ms));
+        }
+    }
+}
+
+#endif
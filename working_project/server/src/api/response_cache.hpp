@@ -0,0 +1,236 @@
+#ifndef RESPONSE_CACHE_HPP
+#define RESPONSE_CACHE_HPP
+
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cstdint>
+
+#include "../utils/gzip_utils.hpp"
+
+// Rendered response bodies keyed by route and normalized query, each tagged
+// with the version of the data it was built from. The caller passes the
+// current version with every lookup, so invalidation is just a counter bump
+// on the writer's side; a stale entry is rebuilt on its next use.
+//
+// Callers that find the same entry stale at once are coalesced: one builds
+// while the rest wait for its result. Least recently used entries are
+// dropped past the capacity.
+//
+// With a gzip level set, a body big enough to be worth it is compressed
+// once when it is built and kept beside the plain one, so hits can be sent
+// either way as shared buffers without copying.
+class response_cache {
+public:
+    typedef std::shared_ptr<const std::string> body_ptr;
+
+private:
+    struct entry {
+        uint64_t version;
+        body_ptr body;
+        body_ptr gzip_body;
+        bool building;
+        std::list<std::string>::iterator position;
+    };
+
+    std::unordered_map<std::string, entry> entries;
+    // Most recently used first.
+    std::list<std::string> order;
+    size_t capacity;
+    int gzip_level;
+    size_t gzip_min_bytes;
+    std::mutex mutex_lock;
+    std::condition_variable built;
+
+    std::atomic<uint64_t> hit_count;
+    std::atomic<uint64_t> miss_count;
+    std::atomic<uint64_t> coalesced_count;
+
+    void touch(entry& cached);
+    void evict_over_capacity();
+    body_ptr compress(const std::string& body) const;
+
+public:
+    explicit response_cache(size_t max_entries = 256, int gzip_level = 0, size_t gzip_min_bytes = 0);
+
+    // Returns the body cached under key if it was built at version or later,
+    // otherwise the result of build(). The version must be read before the
+    // data build() looks at, so a body is never older than its tag.
+    template<typename Builder>
+    body_ptr get(const std::string& key, uint64_t version, Builder build);
+    // Same, also handing back the gzip encoding kept with the body, or null
+    // when there is none.
+    template<typename Builder>
+    body_ptr get(const std::string& key, uint64_t version, Builder build, body_ptr& gzip_body);
+
+    size_t size();
+    void clear();
+    uint64_t hits() const { return hit_count.load(); }
+    uint64_t misses() const { return miss_count.load(); }
+    uint64_t coalesced() const { return coalesced_count.load(); }
+    std::string stats_json();
+
+    // "path?b=2&a=1" and "path?a=1&b=2" name the same response.
+    static std::string make_key(std::string_view path, std::string_view query);
+};
+
+inline response_cache::response_cache(size_t max_entries, int level, size_t min_bytes)
+    : capacity(max_entries ? max_entries : 1), gzip_level(level), gzip_min_bytes(min_bytes),
+      hit_count(0), miss_count(0), coalesced_count(0) {}
+
+inline void response_cache::touch(entry& cached) {
+    order.splice(order.begin(), order, cached.position);
+}
+
+// An entry being built is skipped, since its builder and waiters still refer
+// to it, and so is the most recent one, which the caller may be holding.
+inline void response_cache::evict_over_capacity() {
+    auto it = order.end();
+    while (entries.size() > capacity && it != std::next(order.begin())) {
+        --it;
+        auto found = entries.find(*it);
+        if (found->second.building) {
+            continue;
+        }
+        entries.erase(found);
+        it = order.erase(it);
+    }
+}
+
+// Null unless compression is on, the body is big enough and gzip shrinks it.
+inline response_cache::body_ptr response_cache::compress(const std::string& body) const {
+    std::string compressed;
+    if (body.size() < gzip_min_bytes || !gzip_utils::compress(body, gzip_level, compressed) ||
+        compressed.size() >= body.size()) {
+        return nullptr;
+    }
+    return std::make_shared<const std::string>(std::move(compressed));
+}
+
+template<typename Builder>
+response_cache::body_ptr response_cache::get(const std::string& key, uint64_t version, Builder build) {
+    body_ptr gzip_body;
+    return get(key, version, build, gzip_body);
+}
+
+template<typename Builder>
+response_cache::body_ptr response_cache::get(const std::string& key, uint64_t version, Builder build,
+                                             body_ptr& gzip_body) {
+    std::unique_lock<std::mutex> lock(mutex_lock);
+    bool waited = false;
+    for (;;) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            order.push_front(key);
+            it = entries.emplace(key, entry{0, nullptr, nullptr, false, order.begin()}).first;
+            evict_over_capacity();
+        }
+        entry& cached = it->second;
+        touch(cached);
+        if (cached.body && cached.version >= version) {
+            (waited ? coalesced_count : hit_count)++;
+            gzip_body = cached.gzip_body;
+            return cached.body;
+        }
+        if (!cached.building) {
+            cached.building = true;
+            break;
+        }
+        waited = true;
+        built.wait(lock);
+    }
+    miss_count++;
+
+    lock.unlock();
+    body_ptr body;
+    body_ptr compressed;
+    try {
+        body = std::make_shared<const std::string>(build());
+        compressed = compress(*body);
+    } catch (...) {
+        lock.lock();
+        entries.find(key)->second.building = false;
+        built.notify_all();
+        throw;
+    }
+    lock.lock();
+
+    entry& cached = entries.find(key)->second;
+    if (!cached.body || version >= cached.version) {
+        cached.body = body;
+        cached.gzip_body = compressed;
+        cached.version = version;
+    }
+    cached.building = false;
+    evict_over_capacity();
+    built.notify_all();
+    gzip_body = compressed;
+    return body;
+}
+
+inline size_t response_cache::size() {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    return entries.size();
+}
+
+inline void response_cache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    for (auto it = order.begin(); it != order.end();) {
+        auto found = entries.find(*it);
+        if (found->second.building) {
+            ++it;
+            continue;
+        }
+        entries.erase(found);
+        it = order.erase(it);
+    }
+}
+
+inline std::string response_cache::stats_json() {
+    uint64_t hit = hits();
+    uint64_t miss = misses();
+    uint64_t joined = coalesced();
+    uint64_t total = hit + miss + joined;
+    char rate[32];
+    snprintf(rate, sizeof(rate), "%.4f", total ? static_cast<double>(hit + joined) / total : 0.0);
+    return "{\"hits\":" + std::to_string(hit) +
+           ",\"misses\":" + std::to_string(miss) +
+           ",\"coalesced\":" + std::to_string(joined) +
+           ",\"hit_rate\":" + rate +
+           ",\"entries\":" + std::to_string(size()) + "}";
+}
+
+inline std::string response_cache::make_key(std::string_view path, std::string_view query) {
+    std::string key(path);
+    std::vector<std::string_view> pairs;
+    while (!query.empty()) {
+        size_t end = query.find('&');
+        std::string_view pair = query.substr(0, end);
+        if (!pair.empty()) {
+            pairs.push_back(pair);
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        query.remove_prefix(end + 1);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    char separator = '?';
+    for (std::string_view pair : pairs) {
+        key += separator;
+        key.append(pair.data(), pair.size());
+        separator = '&';
+    }
+    return key;
+}
+
+#endif
@@ -2,41 +2,123 @@
 #define HASH_TABLE_HPP
 
 #include <string>
+#include <string_view>
 #include <mutex>
+#include <shared_mutex>
 #include <functional>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
 #include <vector>
 #include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Lookups take this type, which for std::string keys is std::string_view:
+// callers holding a view or a literal need not build a string to search.
+// It hashes and compares the same as the key it stands for.
+template<typename K>
+struct hash_table_lookup {
+    typedef K type;
+};
 
+template<>
+struct hash_table_lookup<std::string> {
+    typedef std::string_view type;
+};
+
+// Open addressing in the style of Swiss tables. Keys and values sit in one
+// flat slot array, grouped 16 to a group; a parallel control byte per slot
+// says whether it is empty, deleted, or full, and for a full slot holds 7
+// bits of its key's hash. A probe compares a whole group of control bytes
+// at once and only touches the keys whose bytes matched, so most misses
+// never read a key. Groups are probed triangularly over a power-of-two
+// group count, which reaches every group.
+//
+// Growing does not rehash in one go: the old arrays are kept and drained a
+// few groups per write, so no single insert pays for the whole table.
 template<typename K, typename V>
 class hash_table {
+public:
+    typedef typename hash_table_lookup<K>::type lookup_type;
+    
 private:
-    struct node {
+    struct slot {
         K key;
         V value;
-        node* next;
-        node(const K& k, const V& v) : key(k), value(v), next(nullptr) {}
+        slot(const K& k, const V& v) : key(k), value(v) {}
     };
     
-    node** buckets;
-    size_t capacity;
+    // One generation of control bytes and the slots they describe.
+    struct slot_array {
+        int8_t* ctrl;
+        slot* slots;
+        size_t capacity;
+    };
+    
+    // Bit i set when slot i of the group matched.
+    typedef uint32_t group_mask;
+    
+    static constexpr size_t group_width = 16;
+    static constexpr int8_t empty_ctrl = -128;
+    static constexpr int8_t deleted_ctrl = -2;
+    // Slots of the previous generation moved by each write during a resize.
+    static constexpr size_t migrate_step = 32;
+    
+    slot_array table;
+    // The previous generation while a resize moves it into table, a step
+    // per write; empty otherwise. Lookups check both, inserts go to table.
+    slot_array draining;
+    size_t drain_position;
     size_t count;
-    mutable std::mutex mutex_lock;
+    // Empty slots of table that may still be filled before the 7/8 load
+    // limit, less tombstones and less room held for entries still draining.
+    size_t growth_left;
+    // Readers share it; insert, remove, update, modify and clear are
+    // exclusive.
+    mutable std::shared_mutex mutex_lock;
+    
+    static size_t hash_function(const lookup_type& key);
+    static int8_t hash_tag(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+    static size_t max_load(size_t slot_count) { return slot_count - slot_count / 8; }
+    static group_mask match_byte(const int8_t* group, int8_t value);
+    static group_mask match_empty_or_deleted(const int8_t* group);
     
-    size_t hash_function(const K& key) const;
-    void resize();
+    static slot_array allocate(size_t slot_count);
+    static void release(slot_array& arrays);
+    static void deallocate(slot_array& arrays);
+    static size_t find_index(const slot_array& arrays, const lookup_type& key, size_t hash);
+    static size_t find_insert_index(const slot_array& arrays, size_t hash);
+    slot* find_slot(const lookup_type& key, size_t hash) const;
+    void start_resize(size_t new_capacity, slot_array& retired);
+    void migrate(size_t slot_budget, slot_array& retired);
+    void erase_at(size_t index);
+    void erase_draining_at(size_t index);
     
 public:
     hash_table(size_t initial_capacity = 1024);
     ~hash_table();
     
     bool insert(const K& key, const V& value);
-    bool find(const K& key, V& value) const;
-    bool remove(const K& key);
-    bool update(const K& key, const V& value);
+    bool find(const lookup_type& key, V& value) const;
+    bool remove(const lookup_type& key);
+    bool update(const lookup_type& key, const V& value);
     size_t size() const;
     bool empty() const;
-    bool contains(const K& key) const;
+    bool contains(const lookup_type& key) const;
+    
+    // Call fn(const V&) on the stored value under the shared lock, or
+    // fn(V&) under the exclusive one, instead of copying it out and back.
+    // Return false without calling fn if the key is absent. fn must not
+    // use this table.
+    template<typename Func>
+    bool with_value(const lookup_type& key, Func fn) const;
+    template<typename Func>
+    bool modify(const lookup_type& key, Func fn);
     
     void clear();
     
@@ -47,215 +129,379 @@ public:
     void iterate(Func callback) const;
 };
 
+// std::hash of an integer is the integer itself; mixing spreads it over the
+// bits that pick the group and the tag.
+template<typename K, typename V>
+size_t hash_table<K, V>::hash_function(const lookup_type& key) {
+    uint64_t hash = std::hash<lookup_type>()(key);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return static_cast<size_t>(hash);
+}
+
+#ifdef __SSE2__
+template<typename K, typename V>
+typename hash_table<K, V>::group_mask hash_table<K, V>::match_byte(const int8_t* group, int8_t value) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<group_mask>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+}
+
+// Empty and deleted are the only control bytes with the sign bit set.
+template<typename K, typename V>
+typename hash_table<K, V>::group_mask hash_table<K, V>::match_empty_or_deleted(const int8_t* group) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<group_mask>(_mm_movemask_epi8(bytes));
+}
+#else
+template<typename K, typename V>
+typename hash_table<K, V>::group_mask hash_table<K, V>::match_byte(const int8_t* group, int8_t value) {
+    group_mask mask = 0;
+    for (size_t i = 0; i < group_width; i++) {
+        if (group[i] == value) {
+            mask |= group_mask(1) << i;
+        }
+    }
+    return mask;
+}
+
 template<typename K, typename V>
-size_t hash_table<K, V>::hash_function(const K& key) const {
-    return std::hash<K>()(key) % capacity;
+typename hash_table<K, V>::group_mask hash_table<K, V>::match_empty_or_deleted(const int8_t* group) {
+    group_mask mask = 0;
+    for (size_t i = 0; i < group_width; i++) {
+        if (group[i] < 0) {
+            mask |= group_mask(1) << i;
+        }
+    }
+    return mask;
 }
+#endif
 
 template<typename K, typename V>
-hash_table<K, V>::hash_table(size_t initial_capacity) 
-    : capacity(initial_capacity), count(0) {
-    buckets = new node*[capacity];
-    for (size_t i = 0; i < capacity; i++) {
-        buckets[i] = nullptr;
+hash_table<K, V>::hash_table(size_t initial_capacity) : draining{nullptr, nullptr, 0}, drain_position(0), count(0) {
+    size_t slot_count = group_width;
+    while (slot_count < initial_capacity) {
+        slot_count *= 2;
     }
+    table = allocate(slot_count);
+    growth_left = max_load(slot_count);
 }
 
 template<typename K, typename V>
 hash_table<K, V>::~hash_table() {
-    std::lock_guard<std::mutex> lock(mutex_lock);
-    for (size_t i = 0; i < capacity; i++) {
-        node* current = buckets[i];
-        while (current) {
-            node* temp = current;
-            current = current->next;
-            delete temp;
+    std::unique_lock<std::shared_mutex> lock(mutex_lock);
+    release(draining);
+    release(table);
+}
+
+template<typename K, typename V>
+typename hash_table<K, V>::slot_array hash_table<K, V>::allocate(size_t slot_count) {
+    slot_array arrays;
+    arrays.ctrl = new int8_t[slot_count];
+    std::memset(arrays.ctrl, empty_ctrl, slot_count);
+    arrays.slots = std::allocator<slot>().allocate(slot_count);
+    arrays.capacity = slot_count;
+    return arrays;
+}
+
+template<typename K, typename V>
+void hash_table<K, V>::release(slot_array& arrays) {
+    if (arrays.capacity == 0) {
+        return;
+    }
+    for (size_t i = 0; i < arrays.capacity; i++) {
+        if (arrays.ctrl[i] >= 0) {
+            arrays.slots[i].~slot();
         }
     }
-    delete[] buckets;
+    deallocate(arrays);
 }
 
+// For arrays whose slots have all been moved out or destroyed already.
 template<typename K, typename V>
-void hash_table<K, V>::resize() {
-    size_t old_capacity = capacity;
-    node** old_buckets = buckets;
-    
-    capacity *= 2;
-    buckets = new node*[capacity];
-    for (size_t i = 0; i < capacity; i++) {
-        buckets[i] = nullptr;
+void hash_table<K, V>::deallocate(slot_array& arrays) {
+    if (arrays.capacity == 0) {
+        return;
     }
-    
-    size_t old_count = count;
-    count = 0;
-    for (size_t i = 0; i < old_capacity; i++) {
-        node* current = old_buckets[i];
-        while (current) {
-            size_t new_index = std::hash<K>()(current->key) % capacity;
-            node* next_node = current->next;
-            current->next = buckets[new_index];
-            buckets[new_index] = current;
-            count++;
-            current = next_node;
+    std::allocator<slot>().deallocate(arrays.slots, arrays.capacity);
+    delete[] arrays.ctrl;
+    arrays = slot_array{nullptr, nullptr, 0};
+}
+
+// Returns arrays.capacity when the key is absent. Stops at the first group
+// with an empty slot: an insert would have used it rather than probe on.
+template<typename K, typename V>
+size_t hash_table<K, V>::find_index(const slot_array& arrays, const lookup_type& key, size_t hash) {
+    if (arrays.capacity == 0) {
+        return 0;
+    }
+    size_t group_mask_bits = arrays.capacity / group_width - 1;
+    size_t group = (hash >> 7) & group_mask_bits;
+    int8_t tag = hash_tag(hash);
+    for (size_t step = 1;; step++) {
+        const int8_t* group_ctrl = arrays.ctrl + group * group_width;
+        for (group_mask mask = match_byte(group_ctrl, tag); mask; mask &= mask - 1) {
+            size_t index = group * group_width + __builtin_ctz(mask);
+            if (arrays.slots[index].key == key) {
+                return index;
+            }
         }
+        if (match_byte(group_ctrl, empty_ctrl)) {
+            return arrays.capacity;
+        }
+        group = (group + step) & group_mask_bits;
+    }
+}
+
+template<typename K, typename V>
+size_t hash_table<K, V>::find_insert_index(const slot_array& arrays, size_t hash) {
+    size_t group_mask_bits = arrays.capacity / group_width - 1;
+    size_t group = (hash >> 7) & group_mask_bits;
+    for (size_t step = 1;; step++) {
+        group_mask mask = match_empty_or_deleted(arrays.ctrl + group * group_width);
+        if (mask) {
+            return group * group_width + __builtin_ctz(mask);
+        }
+        group = (group + step) & group_mask_bits;
+    }
+}
+
+template<typename K, typename V>
+typename hash_table<K, V>::slot* hash_table<K, V>::find_slot(const lookup_type& key, size_t hash) const {
+    size_t index = find_index(table, key, hash);
+    if (index != table.capacity) {
+        return table.slots + index;
+    }
+    index = find_index(draining, key, hash);
+    if (index != draining.capacity) {
+        return draining.slots + index;
+    }
+    return nullptr;
+}
+
+// Swaps in fresh arrays and leaves the entries where they are; migrate()
+// moves them over. Room for all of them is held back from growth_left up
+// front, so the new table cannot fill up before they arrive.
+template<typename K, typename V>
+void hash_table<K, V>::start_resize(size_t new_capacity, slot_array& retired) {
+    migrate(draining.capacity, retired);
+    draining = table;
+    drain_position = 0;
+    table = allocate(new_capacity);
+    growth_left = max_load(new_capacity) - count;
+}
+
+// Moved slots are marked deleted rather than empty, so probes for entries
+// further along in the draining arrays still reach them. Emptied arrays are
+// handed back in retired for the caller to free once it has unlocked:
+// returning a large block to the system takes milliseconds.
+template<typename K, typename V>
+void hash_table<K, V>::migrate(size_t slot_budget, slot_array& retired) {
+    if (draining.capacity == 0) {
+        return;
+    }
+    size_t end = std::min(draining.capacity, drain_position + slot_budget);
+    for (; drain_position < end; drain_position++) {
+        if (draining.ctrl[drain_position] < 0) {
+            continue;
+        }
+        slot& moving = draining.slots[drain_position];
+        size_t hash = hash_function(moving.key);
+        size_t index = find_insert_index(table, hash);
+        new (table.slots + index) slot(std::move(moving));
+        if (table.ctrl[index] == deleted_ctrl) {
+            growth_left++;
+        }
+        table.ctrl[index] = hash_tag(hash);
+        moving.~slot();
+        draining.ctrl[drain_position] = deleted_ctrl;
+    }
+    if (drain_position == draining.capacity) {
+        // An insert can finish two small drains in one call.
+        deallocate(retired);
+        retired = draining;
+        draining = slot_array{nullptr, nullptr, 0};
     }
-    
-    delete[] old_buckets;
+}
+
+// A group that still has an empty slot has never been full since the last
+// resize, so no probe has passed through it and the slot can go back to
+// empty; otherwise it must stay a tombstone to keep later probes going.
+template<typename K, typename V>
+void hash_table<K, V>::erase_at(size_t index) {
+    table.slots[index].~slot();
+    if (match_byte(table.ctrl + (index & ~(group_width - 1)), empty_ctrl)) {
+        table.ctrl[index] = empty_ctrl;
+        growth_left++;
+    } else {
+        table.ctrl[index] = deleted_ctrl;
+    }
+    count--;
+}
+
+// The room held for this entry in table is no longer needed.
+template<typename K, typename V>
+void hash_table<K, V>::erase_draining_at(size_t index) {
+    draining.slots[index].~slot();
+    draining.ctrl[index] = deleted_ctrl;
+    growth_left++;
+    count--;
 }
 
 template<typename K, typename V>
 bool hash_table<K, V>::insert(const K& key, const V& value) {
-    std::lock_guard<std::mutex> lock(mutex_lock);
+    std::unique_lock<std::shared_mutex> lock(mutex_lock);
     
-    if (static_cast<double>(count) / capacity > 0.75) {
-        resize();
+    size_t hash = hash_function(key);
+    if (find_slot(key, hash)) {
+        return false;
     }
     
-    size_t index = hash_function(key);
-    node* current = buckets[index];
-    
-    while (current) {
-        if (current->key == key) {
-            return false;
-        }
-        current = current->next;
+    slot_array retired{nullptr, nullptr, 0};
+    size_t index = find_insert_index(table, hash);
+    if (growth_left == 0 && table.ctrl[index] == empty_ctrl) {
+        // Mostly tombstones: clearing them at the same size is enough.
+        start_resize(count * 2 < max_load(table.capacity) ? table.capacity : table.capacity * 2, retired);
+        index = find_insert_index(table, hash);
     }
     
-    node* new_node = new node(key, value);
-    new_node->next = buckets[index];
-    buckets[index] = new_node;
+    new (table.slots + index) slot(key, value);
+    if (table.ctrl[index] == empty_ctrl) {
+        growth_left--;
+    }
+    table.ctrl[index] = hash_tag(hash);
     count++;
+    migrate(migrate_step, retired);
     
+    lock.unlock();
+    deallocate(retired);
     return true;
 }
 
 template<typename K, typename V>
-bool hash_table<K, V>::find(const K& key, V& value) const {
-    std::lock_guard<std::mutex> lock(mutex_lock);
+bool hash_table<K, V>::find(const lookup_type& key, V& value) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
     
-    size_t index = hash_function(key);
-    node* current = buckets[index];
-    
-    while (current) {
-        if (current->key == key) {
-            value = current->value;
-            return true;
-        }
-        current = current->next;
+    slot* found = find_slot(key, hash_function(key));
+    if (!found) {
+        return false;
     }
-    
-    return false;
+    value = found->value;
+    return true;
 }
 
 template<typename K, typename V>
-bool hash_table<K, V>::contains(const K& key) const {
-    std::lock_guard<std::mutex> lock(mutex_lock);
-    
-    size_t index = hash_function(key);
-    node* current = buckets[index];
+bool hash_table<K, V>::contains(const lookup_type& key) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
+    return find_slot(key, hash_function(key)) != nullptr;
+}
+
+template<typename K, typename V>
+bool hash_table<K, V>::remove(const lookup_type& key) {
+    std::unique_lock<std::shared_mutex> lock(mutex_lock);
     
-    while (current) {
-        if (current->key == key) {
-            return true;
+    size_t hash = hash_function(key);
+    size_t index = find_index(table, key, hash);
+    if (index != table.capacity) {
+        erase_at(index);
+    } else {
+        index = find_index(draining, key, hash);
+        if (index == draining.capacity) {
+            return false;
         }
-        current = current->next;
+        erase_draining_at(index);
     }
     
-    return false;
+    slot_array retired{nullptr, nullptr, 0};
+    migrate(migrate_step, retired);
+    lock.unlock();
+    deallocate(retired);
+    return true;
 }
 
 template<typename K, typename V>
-bool hash_table<K, V>::remove(const K& key) {
-    std::lock_guard<std::mutex> lock(mutex_lock);
-    
-    size_t index = hash_function(key);
-    node* current = buckets[index];
-    node* prev = nullptr;
+bool hash_table<K, V>::update(const lookup_type& key, const V& value) {
+    return modify(key, [&value](V& stored) { stored = value; });
+}
+
+template<typename K, typename V>
+template<typename Func>
+bool hash_table<K, V>::with_value(const lookup_type& key, Func fn) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
     
-    while (current) {
-        if (current->key == key) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                buckets[index] = current->next;
-            }
-            delete current;
-            count--;
-            return true;
-        }
-        prev = current;
-        current = current->next;
+    slot* found = find_slot(key, hash_function(key));
+    if (!found) {
+        return false;
     }
-    
-    return false;
+    fn(static_cast<const V&>(found->value));
+    return true;
 }
 
 template<typename K, typename V>
-bool hash_table<K, V>::update(const K& key, const V& value) {
-    std::lock_guard<std::mutex> lock(mutex_lock);
-    
-    size_t index = hash_function(key);
-    node* current = buckets[index];
+template<typename Func>
+bool hash_table<K, V>::modify(const lookup_type& key, Func fn) {
+    std::unique_lock<std::shared_mutex> lock(mutex_lock);
     
-    while (current) {
-        if (current->key == key) {
-            current->value = value;
-            return true;
-        }
-        current = current->next;
+    slot* found = find_slot(key, hash_function(key));
+    if (!found) {
+        return false;
     }
+    fn(found->value);
     
-    return false;
+    slot_array retired{nullptr, nullptr, 0};
+    migrate(migrate_step, retired);
+    lock.unlock();
+    deallocate(retired);
+    return true;
 }
 
 template<typename K, typename V>
 size_t hash_table<K, V>::size() const {
-    std::lock_guard<std::mutex> lock(mutex_lock);
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
     return count;
 }
 
 template<typename K, typename V>
 bool hash_table<K, V>::empty() const {
-    std::lock_guard<std::mutex> lock(mutex_lock);
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
     return count == 0;
 }
 
 template<typename K, typename V>
 void hash_table<K, V>::clear() {
-    std::lock_guard<std::mutex> lock(mutex_lock);
-    for (size_t i = 0; i < capacity; i++) {
-        node* current = buckets[i];
-        while (current) {
-            node* temp = current;
-            current = current->next;
-            delete temp;
+    std::unique_lock<std::shared_mutex> lock(mutex_lock);
+    release(draining);
+    for (size_t i = 0; i < table.capacity; i++) {
+        if (table.ctrl[i] >= 0) {
+            table.slots[i].~slot();
         }
-        buckets[i] = nullptr;
     }
+    std::memset(table.ctrl, empty_ctrl, table.capacity);
+    growth_left = max_load(table.capacity);
     count = 0;
 }
 
 template<typename K, typename V>
 template<typename Func>
 void hash_table<K, V>::iterate(Func callback) const {
-    std::lock_guard<std::mutex> lock(mutex_lock);
-    for (size_t i = 0; i < capacity; i++) {
-        node* current = buckets[i];
-        while (current) {
-            callback(current->key, current->value);
-            current = current->next;
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
+    for (const slot_array* arrays : {&table, &draining}) {
+        for (size_t i = 0; i < arrays->capacity; i++) {
+            if (arrays->ctrl[i] >= 0) {
+                callback(arrays->slots[i].key, arrays->slots[i].value);
+            }
         }
     }
 }
 
 template<typename K, typename V>
 void hash_table<K, V>::serialize(const std::string& filename) const {
-    std::lock_guard<std::mutex> lock(mutex_lock);
+    std::shared_lock<std::shared_mutex> lock(mutex_lock);
 }
 
 template<typename K, typename V>
 void hash_table<K, V>::deserialize(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(mutex_lock);
+    std::unique_lock<std::shared_mutex> lock(mutex_lock);
 }
 
 #endif
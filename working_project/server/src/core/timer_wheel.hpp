@@ -0,0 +1,232 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Hierarchical timing wheel: four levels of 64 slots, each level's slot
+// spanning a whole lap of the level below. A timer sits in the coarsest
+// slot that still separates it from the current tick and moves down a level
+// when that slot comes round, so schedule and cancel are O(1) and advance
+// touches only the slots the clock passes. Timers never fire early; they
+// fire at most one tick late.
+//
+// Not thread safe: each owner (e.g. a reactor) keeps its own wheel.
+template<typename T>
+class timer_wheel {
+public:
+    // Zero is never a valid id, so it can mean "no timer".
+    typedef uint64_t timer_id;
+
+private:
+    static const int slot_bits = 6;
+    static const uint64_t slots_per_level = 1ull << slot_bits;
+    static const uint64_t slot_mask = slots_per_level - 1;
+    static const int level_count = 4;
+    static const uint64_t max_ticks = 1ull << (slot_bits * level_count);
+    static const uint32_t nil = UINT32_MAX;
+    // The extra list past the wheel holds timers that are being fired, so a
+    // callback can still cancel one of its not-yet-fired neighbours.
+    static const uint32_t firing_list = level_count * slots_per_level;
+
+    struct node {
+        T value;
+        uint64_t expiry_tick;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t list;
+        uint32_t generation;
+        bool active;
+    };
+
+    uint64_t tick_ms;
+    uint64_t current_tick;
+    size_t active_count;
+    std::vector<node> nodes;
+    std::vector<uint32_t> free_nodes;
+    uint32_t heads[firing_list + 1];
+
+    void link(uint32_t index, uint32_t list);
+    void unlink(uint32_t index);
+    void place(uint32_t index);
+    void release(uint32_t index);
+    void cascade(int level);
+
+public:
+    timer_wheel(uint64_t tick_length_ms, uint64_t now_ms);
+
+    timer_id schedule(uint64_t deadline_ms, const T& value);
+    bool cancel(timer_id id);
+    // Fires, in deadline order by tick, every timer due at or before now_ms.
+    // expire(value) may schedule or cancel timers.
+    template<typename Callback>
+    size_t advance(uint64_t now_ms, Callback expire);
+
+    size_t size() const { return active_count; }
+    bool empty() const { return active_count == 0; }
+    uint64_t resolution_ms() const { return tick_ms; }
+};
+
+template<typename T>
+timer_wheel<T>::timer_wheel(uint64_t tick_length_ms, uint64_t now_ms)
+    : tick_ms(tick_length_ms ? tick_length_ms : 1), current_tick(now_ms / tick_ms), active_count(0) {
+    for (uint32_t& head : heads) {
+        head = nil;
+    }
+}
+
+template<typename T>
+void timer_wheel<T>::link(uint32_t index, uint32_t list) {
+    node& entry = nodes[index];
+    entry.list = list;
+    entry.prev = nil;
+    entry.next = heads[list];
+    if (entry.next != nil) {
+        nodes[entry.next].prev = index;
+    }
+    heads[list] = index;
+}
+
+template<typename T>
+void timer_wheel<T>::unlink(uint32_t index) {
+    node& entry = nodes[index];
+    if (entry.prev != nil) {
+        nodes[entry.prev].next = entry.next;
+    } else {
+        heads[entry.list] = entry.next;
+    }
+    if (entry.next != nil) {
+        nodes[entry.next].prev = entry.prev;
+    }
+}
+
+// Picks the level by how far away the expiry is; anything already due goes
+// in the slot for the tick about to be processed.
+template<typename T>
+void timer_wheel<T>::place(uint32_t index) {
+    uint64_t expiry = nodes[index].expiry_tick;
+    if (expiry < current_tick) {
+        expiry = current_tick;
+    }
+    uint64_t delta = expiry - current_tick;
+    if (delta >= max_ticks) {
+        // Parked in the top level; it is placed again each time that slot
+        // cascades until it comes within range.
+        expiry = current_tick + max_ticks - 1;
+        delta = max_ticks - 1;
+    }
+    int level = 0;
+    while (delta >= (1ull << (slot_bits * (level + 1)))) {
+        level++;
+    }
+    uint64_t slot = (expiry >> (slot_bits * level)) & slot_mask;
+    link(index, static_cast<uint32_t>(level * slots_per_level + slot));
+}
+
+template<typename T>
+void timer_wheel<T>::release(uint32_t index) {
+    node& entry = nodes[index];
+    entry.active = false;
+    entry.generation++;
+    entry.value = T();
+    free_nodes.push_back(index);
+    active_count--;
+}
+
+template<typename T>
+void timer_wheel<T>::cascade(int level) {
+    uint32_t list = static_cast<uint32_t>(level * slots_per_level +
+                                          ((current_tick >> (slot_bits * level)) & slot_mask));
+    uint32_t index = heads[list];
+    heads[list] = nil;
+    while (index != nil) {
+        uint32_t next = nodes[index].next;
+        place(index);
+        index = next;
+    }
+}
+
+template<typename T>
+typename timer_wheel<T>::timer_id timer_wheel<T>::schedule(uint64_t deadline_ms, const T& value) {
+    uint32_t index;
+    if (!free_nodes.empty()) {
+        index = free_nodes.back();
+        free_nodes.pop_back();
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(node{T(), 0, nil, nil, nil, 0, false});
+    }
+    node& entry = nodes[index];
+    entry.value = value;
+    // Rounded up so the timer cannot fire before its deadline.
+    entry.expiry_tick = (deadline_ms + tick_ms - 1) / tick_ms;
+    entry.active = true;
+    active_count++;
+    place(index);
+    return (static_cast<uint64_t>(entry.generation) << 32) | (static_cast<uint64_t>(index) + 1);
+}
+
+template<typename T>
+bool timer_wheel<T>::cancel(timer_id id) {
+    if (id == 0) {
+        return false;
+    }
+    uint64_t index = (id & 0xffffffffull) - 1;
+    if (index >= nodes.size()) {
+        return false;
+    }
+    node& entry = nodes[index];
+    if (!entry.active || entry.generation != static_cast<uint32_t>(id >> 32)) {
+        return false;
+    }
+    unlink(static_cast<uint32_t>(index));
+    release(static_cast<uint32_t>(index));
+    return true;
+}
+
+template<typename T>
+template<typename Callback>
+size_t timer_wheel<T>::advance(uint64_t now_ms, Callback expire) {
+    uint64_t target_tick = now_ms / tick_ms;
+    size_t fired = 0;
+    while (current_tick <= target_tick) {
+        if (active_count == 0) {
+            current_tick = target_tick + 1;
+            break;
+        }
+        // Entering a new lap of a level pulls the next slot of the level
+        // above down before this tick's slot is read.
+        for (int level = 1; level < level_count; level++) {
+            if ((current_tick & ((1ull << (slot_bits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        // Move the due slot onto the firing list first: a timer the callback
+        // schedules for a lap from now lands in this same slot and must not
+        // fire with it.
+        uint32_t list = static_cast<uint32_t>(current_tick & slot_mask);
+        uint32_t index = heads[list];
+        heads[list] = nil;
+        while (index != nil) {
+            uint32_t next = nodes[index].next;
+            link(index, firing_list);
+            index = next;
+        }
+        current_tick++;
+
+        while (heads[firing_list] != nil) {
+            uint32_t due = heads[firing_list];
+            unlink(due);
+            T value = nodes[due].value;
+            release(due);
+            fired++;
+            expire(value);
+        }
+    }
+    return fired;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CHANNEL_REGISTRY_HPP
+#define CHANNEL_REGISTRY_HPP
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+// One open WebSocket, addressed the same way a worker addresses a response:
+// the reactor that owns it, its descriptor (or fixed-file slot) and the
+// connection id that guards against descriptor reuse.
+struct channel_subscriber {
+    size_t reactor_index;
+    int fd;
+    uint64_t connection_id;
+
+    bool operator==(const channel_subscriber& other) const {
+        return reactor_index == other.reactor_index && fd == other.fd && connection_id == other.connection_id;
+    }
+};
+
+// Per-user channels for WebSocket fan-out: channel id -> sockets subscribed
+// to it (one per open tab or device). Sharded by channel so publishers on
+// different workers rarely share a lock; each shard lock is held only to
+// copy or edit one short vector.
+class channel_registry {
+private:
+    static const size_t shard_count = 16;
+
+    struct shard {
+        std::mutex lock;
+        std::unordered_map<uint64_t, std::vector<channel_subscriber>> channels;
+    };
+
+    shard shards[shard_count];
+
+    shard& shard_for(uint64_t channel) { return shards[channel % shard_count]; }
+
+public:
+    // Returns true when this is the channel's first subscriber.
+    bool subscribe(uint64_t channel, const channel_subscriber& subscriber);
+    // Returns true when the channel lost its last subscriber.
+    bool unsubscribe(uint64_t channel, const channel_subscriber& subscriber);
+    // Replaces out with the channel's subscribers and returns how many.
+    size_t subscribers(uint64_t channel, std::vector<channel_subscriber>& out);
+    bool is_subscribed(uint64_t channel);
+    size_t channel_count();
+};
+
+inline bool channel_registry::subscribe(uint64_t channel, const channel_subscriber& subscriber) {
+    shard& target = shard_for(channel);
+    std::lock_guard<std::mutex> lock(target.lock);
+    std::vector<channel_subscriber>& list = target.channels[channel];
+    list.push_back(subscriber);
+    return list.size() == 1;
+}
+
+inline bool channel_registry::unsubscribe(uint64_t channel, const channel_subscriber& subscriber) {
+    shard& target = shard_for(channel);
+    std::lock_guard<std::mutex> lock(target.lock);
+    auto it = target.channels.find(channel);
+    if (it == target.channels.end()) {
+        return false;
+    }
+    std::vector<channel_subscriber>& list = it->second;
+    auto found = std::find(list.begin(), list.end(), subscriber);
+    if (found == list.end()) {
+        return false;
+    }
+    *found = list.back();
+    list.pop_back();
+    if (!list.empty()) {
+        return false;
+    }
+    target.channels.erase(it);
+    return true;
+}
+
+inline size_t channel_registry::subscribers(uint64_t channel, std::vector<channel_subscriber>& out) {
+    shard& target = shard_for(channel);
+    std::lock_guard<std::mutex> lock(target.lock);
+    auto it = target.channels.find(channel);
+    if (it == target.channels.end()) {
+        out.clear();
+        return 0;
+    }
+    out = it->second;
+    return out.size();
+}
+
+inline bool channel_registry::is_subscribed(uint64_t channel) {
+    shard& target = shard_for(channel);
+    std::lock_guard<std::mutex> lock(target.lock);
+    return target.channels.count(channel) > 0;
+}
+
+inline size_t channel_registry::channel_count() {
+    size_t total = 0;
+    for (shard& each : shards) {
+        std::lock_guard<std::mutex> lock(each.lock);
+        total += each.channels.size();
+    }
+    return total;
+}
+
+#endif
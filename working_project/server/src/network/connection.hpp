@@ -0,0 +1,127 @@
+#ifndef CONNECTION_HPP
+#define CONNECTION_HPP
+
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <deque>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "request_parser.hpp"
+#include "http_response.hpp"
+#include "websocket.hpp"
+
+struct http_connection {
+    // What the connection's single timer is guarding; see http_server's
+    // set_deadline().
+    enum deadline_kind : uint8_t {
+        no_deadline, header_deadline, body_deadline, idle_deadline, write_deadline, ping_deadline
+    };
+
+    // Queued WebSocket frames leave in one sendmsg, up to this many at a time.
+    static const int max_frame_batch = 8;
+    static_assert(max_frame_batch >= http_response::max_parts, "send_parts also carries HTTP responses");
+
+    int fd;
+    uint64_t id;
+    // IPv4 address of the client, network byte order.
+    uint32_t peer_address;
+    std::string in_buffer;
+    size_t in_start;
+    request_parser parser;
+    http_response out_response;
+    uint64_t out_sent;
+    uint64_t out_total;
+    bool close_after_write;
+    bool in_flight;
+    bool read_pending;
+    bool abandoned;
+    bool peer_closed;
+    // The current request already passed the rate limits at headers_complete.
+    bool limits_checked;
+    uint32_t requests_served;
+    uint64_t last_activity_ms;
+    uint64_t timer;
+    deadline_kind deadline;
+
+    // io_uring backend only. Operations still in the kernel reference this
+    // object, so it outlives close until ops_pending drops to zero. A file
+    // body is staged a chunk at a time through a registered buffer.
+    int ops_pending;
+    bool recv_armed;
+    bool closing;
+    int file_buffer;
+    uint32_t file_chunk;
+    uint32_t file_chunk_sent;
+    std::string deferred_input;
+    struct msghdr send_message;
+    struct iovec send_parts[max_frame_batch];
+
+    // WebSocket only, set once the upgrade completes. Outgoing frames are
+    // shared with every other socket they were fanned out to; frame_sent is
+    // how much of the front one has been written.
+    const websocket_endpoint* endpoint;
+    uint64_t channel;
+    std::deque<std::shared_ptr<const std::string>> frames_out;
+    size_t frames_out_bytes;
+    size_t frame_sent;
+    bool frames_sending;
+    std::string message;
+    uint8_t message_opcode;
+    uint64_t ping_sent_ms;
+    bool close_sent;
+
+    http_connection(int socket_fd, uint64_t connection_id, uint64_t now_ms,
+                    size_t max_header_bytes, size_t max_body_bytes)
+        : fd(socket_fd), id(connection_id), peer_address(0), in_start(0), parser(max_header_bytes, max_body_bytes, true), out_sent(0), out_total(0),
+          close_after_write(false), in_flight(false),
+          read_pending(false), abandoned(false), peer_closed(false), limits_checked(false), requests_served(0), last_activity_ms(now_ms),
+          timer(0), deadline(no_deadline),
+          ops_pending(0), recv_armed(false), closing(false), file_buffer(-1), file_chunk(0), file_chunk_sent(0),
+          endpoint(nullptr), channel(0), frames_out_bytes(0), frame_sent(0), frames_sending(false), message_opcode(0),
+          ping_sent_ms(0), close_sent(false) {}
+
+    bool has_pending_output() const { return out_sent < out_total; }
+    void begin_response(http_response response, bool keep_alive) {
+        out_response = std::move(response);
+        out_response.prepare(keep_alive);
+        out_sent = 0;
+        out_total = out_response.total_size();
+    }
+    void clear_output() {
+        out_response = http_response();
+        out_sent = out_total = 0;
+    }
+    size_t buffered_input() const { return in_buffer.size() - in_start; }
+    bool is_websocket() const { return endpoint != nullptr; }
+
+    // Points up to max_frame_batch iovecs at the unsent queued frames.
+    int gather_frames(struct iovec* parts) const {
+        int count = 0;
+        size_t offset = frame_sent;
+        for (auto it = frames_out.begin(); it != frames_out.end() && count < max_frame_batch; ++it) {
+            const std::string& frame = **it;
+            parts[count].iov_base = const_cast<char*>(frame.data() + offset);
+            parts[count].iov_len = frame.size() - offset;
+            count++;
+            offset = 0;
+        }
+        return count;
+    }
+    void frames_written(size_t bytes) {
+        while (bytes > 0 && !frames_out.empty()) {
+            size_t rest = frames_out.front()->size() - frame_sent;
+            if (bytes < rest) {
+                frame_sent += bytes;
+                return;
+            }
+            bytes -= rest;
+            frames_out_bytes -= frames_out.front()->size();
+            frames_out.pop_front();
+            frame_sent = 0;
+        }
+    }
+};
+
+#endif
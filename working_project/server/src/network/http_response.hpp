@@ -0,0 +1,280 @@
+#ifndef HTTP_RESPONSE_HPP
+#define HTTP_RESPONSE_HPP
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <array>
+#include <cstdio>
+#include <cstdint>
+#include <sys/uio.h>
+
+#include "response_builder.hpp"
+#include "static_cache.hpp"
+
+// A response as the pieces that go on the wire, in writev order:
+//   head   - status line, Content-Type and the CORS lines; pre-rendered once
+//            per status/content-type pair and shared by every response
+//   extra  - per-response headers (ETag, Content-Encoding, ...), usually empty
+//   tail   - Content-Length, Connection and the blank line, rendered in place
+//   body   - owned string, a slice of a shared cached string, or a file range
+//            sent with sendfile after the in-memory parts
+// Handlers may return a plain std::string, which becomes a 200 JSON body.
+class http_response {
+public:
+    static const int max_parts = 4;
+
+    http_response();
+    http_response(std::string body);
+    http_response(const char* body);
+    http_response(int status_code, std::string body, std::string_view content_type = "application/json");
+
+    static http_response shared(int status_code, std::shared_ptr<const std::string> body,
+                                size_t offset, size_t length, std::string_view content_type);
+    static http_response file(int status_code, std::shared_ptr<const static_file> body,
+                              uint64_t offset, uint64_t length, std::string_view content_type);
+
+    http_response& add_header(std::string_view name, std::string_view value) &;
+    http_response& add_header_lines(std::string_view lines) &;
+    // Chaining on a temporary keeps it an rvalue, so it moves rather than copies.
+    http_response&& add_header(std::string_view name, std::string_view value) && {
+        return std::move(add_header(name, value));
+    }
+    http_response&& add_header_lines(std::string_view lines) && { return std::move(add_header_lines(lines)); }
+
+    int status() const { return status_code; }
+    std::string_view content_type() const;
+    std::string_view body() const;
+    bool owns_body() const { return !shared_body && !file_body; }
+    void set_body(std::string body);
+    uint64_t content_length() const;
+
+    // Renders the tail; must be called before the sizes and gather() are used.
+    void prepare(bool keep_alive);
+    uint64_t total_size() const { return memory_size() + (file_body ? body_length : 0); }
+    uint64_t memory_size() const;
+    int gather(struct iovec* parts, uint64_t offset) const;
+    const static_file* file_source() const { return file_body.get(); }
+    uint64_t file_start() const { return body_offset; }
+
+    std::string to_string() const;
+
+private:
+    struct known_content_types {
+        static const size_t count = 10;
+        std::array<std::string_view, count> names;
+    };
+
+    struct head_table {
+        std::array<int16_t, 600> status_row;
+        std::vector<std::string> heads;
+    };
+
+    int status_code;
+    int content_type_index;
+    std::string custom_content_type;
+    std::string custom_head;
+    std::string extra_headers;
+    std::string owned_body;
+    std::shared_ptr<const std::string> shared_body;
+    std::shared_ptr<const static_file> file_body;
+    uint64_t body_offset;
+    uint64_t body_length;
+    char tail[80];
+    size_t tail_size;
+
+    static const known_content_types& content_types();
+    static const head_table& heads();
+    static std::string render_head(int status_code, std::string_view content_type);
+    void set_content_type(std::string_view content_type);
+    std::string_view head() const;
+};
+
+inline const http_response::known_content_types& http_response::content_types() {
+    static const known_content_types types = {{
+        "application/json", "text/plain", "text/html", "text/css", "application/javascript",
+        "image/png", "image/jpeg", "image/gif", "image/svg+xml", "image/x-icon"
+    }};
+    return types;
+}
+
+inline std::string http_response::render_head(int status_code, std::string_view content_type) {
+    std::string head = "HTTP/1.1 " + std::to_string(status_code) + " " +
+                       response_builder::get_status_message(status_code) + "\r\n";
+    head += "Content-Type: ";
+    head += content_type;
+    head += "\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n"
+            "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";
+    return head;
+}
+
+// Built on first use (thread-safe static init) and read-only afterwards, so
+// workers share it without locking.
+inline const http_response::head_table& http_response::heads() {
+    static const head_table table = []() {
+        static const int statuses[] = {200, 201, 206, 304, 400, 401, 403, 404, 408, 413, 416, 429, 431, 500, 503};
+        head_table built;
+        built.status_row.fill(-1);
+        const known_content_types& types = content_types();
+        int16_t row = 0;
+        for (int status : statuses) {
+            built.status_row[status] = row++;
+            for (std::string_view type : types.names) {
+                built.heads.push_back(render_head(status, type));
+            }
+        }
+        return built;
+    }();
+    return table;
+}
+
+inline http_response::http_response() : http_response(200, std::string()) {}
+
+inline http_response::http_response(std::string body) : http_response(200, std::move(body)) {}
+
+inline http_response::http_response(const char* body) : http_response(200, std::string(body)) {}
+
+inline http_response::http_response(int status, std::string body, std::string_view content_type)
+    : status_code(status), content_type_index(-1), owned_body(std::move(body)),
+      body_offset(0), body_length(0), tail_size(0) {
+    set_content_type(content_type);
+}
+
+inline http_response http_response::shared(int status, std::shared_ptr<const std::string> body,
+                                           size_t offset, size_t length, std::string_view content_type) {
+    http_response response(status, std::string(), content_type);
+    response.shared_body = std::move(body);
+    response.body_offset = offset;
+    response.body_length = length;
+    return response;
+}
+
+inline http_response http_response::file(int status, std::shared_ptr<const static_file> body,
+                                         uint64_t offset, uint64_t length, std::string_view content_type) {
+    http_response response(status, std::string(), content_type);
+    response.file_body = std::move(body);
+    response.body_offset = offset;
+    response.body_length = length;
+    return response;
+}
+
+inline void http_response::set_content_type(std::string_view content_type) {
+    const known_content_types& types = content_types();
+    for (size_t i = 0; i < types.count; i++) {
+        if (types.names[i] == content_type) {
+            content_type_index = static_cast<int>(i);
+            break;
+        }
+    }
+    if (content_type_index < 0) {
+        custom_content_type = std::string(content_type);
+    }
+    if (content_type_index < 0 || status_code < 0 || status_code >= 600 || heads().status_row[status_code] < 0) {
+        custom_head = render_head(status_code, content_type);
+    }
+}
+
+inline std::string_view http_response::content_type() const {
+    if (content_type_index >= 0) {
+        return content_types().names[content_type_index];
+    }
+    return custom_content_type;
+}
+
+inline std::string_view http_response::head() const {
+    if (!custom_head.empty()) {
+        return custom_head;
+    }
+    const head_table& table = heads();
+    return table.heads[table.status_row[status_code] * known_content_types::count + content_type_index];
+}
+
+inline http_response& http_response::add_header(std::string_view name, std::string_view value) & {
+    extra_headers.append(name.data(), name.size());
+    extra_headers += ": ";
+    extra_headers.append(value.data(), value.size());
+    extra_headers += "\r\n";
+    return *this;
+}
+
+inline http_response& http_response::add_header_lines(std::string_view lines) & {
+    extra_headers.append(lines.data(), lines.size());
+    return *this;
+}
+
+inline std::string_view http_response::body() const {
+    if (shared_body) {
+        return std::string_view(*shared_body).substr(body_offset, body_length);
+    }
+    if (file_body) {
+        return std::string_view();
+    }
+    return owned_body;
+}
+
+inline void http_response::set_body(std::string body) {
+    shared_body.reset();
+    file_body.reset();
+    body_offset = body_length = 0;
+    owned_body = std::move(body);
+}
+
+inline uint64_t http_response::content_length() const {
+    return owns_body() ? owned_body.size() : body_length;
+}
+
+inline void http_response::prepare(bool keep_alive) {
+    int written = 0;
+    // A 304 has no body; a Content-Length there would describe the cached
+    // representation, so leave it out.
+    if (status_code != 304) {
+        written = snprintf(tail, sizeof(tail), "Content-Length: %llu\r\n",
+                           static_cast<unsigned long long>(content_length()));
+    }
+    written += snprintf(tail + written, sizeof(tail) - written, "%s",
+                        keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    tail_size = written;
+}
+
+inline uint64_t http_response::memory_size() const {
+    return head().size() + extra_headers.size() + tail_size + (file_body ? 0 : body().size());
+}
+
+// Fills up to max_parts iovecs with the in-memory bytes from offset onward
+// and returns how many were used. Called again after a partial write with
+// the number of bytes already sent.
+inline int http_response::gather(struct iovec* parts, uint64_t offset) const {
+    std::string_view segments[max_parts] = {
+        head(), extra_headers, std::string_view(tail, tail_size), file_body ? std::string_view() : body()
+    };
+    int count = 0;
+    for (std::string_view segment : segments) {
+        if (offset >= segment.size()) {
+            offset -= segment.size();
+            continue;
+        }
+        parts[count].iov_base = const_cast<char*>(segment.data() + offset);
+        parts[count].iov_len = segment.size() - offset;
+        count++;
+        offset = 0;
+    }
+    return count;
+}
+
+// Flattens the in-memory parts; file bodies are not included.
+inline std::string http_response::to_string() const {
+    std::string flattened;
+    flattened.reserve(memory_size());
+    flattened += head();
+    flattened += extra_headers;
+    flattened.append(tail, tail_size);
+    if (!file_body) {
+        flattened += body();
+    }
+    return flattened;
+}
+
+#endif
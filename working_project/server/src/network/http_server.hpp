@@ -6,170 +6,561 @@
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <algorithm>
 #include <cstring>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <sched.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <csignal>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 #include <cerrno>
 #include <cstring>
 
 #include "request_parser.hpp"
 #include "response_builder.hpp"
+#include "http_response.hpp"
+#include "connection.hpp"
+#include "router.hpp"
+#include "worker_pool.hpp"
+#include "server_metrics.hpp"
+#include "static_cache.hpp"
+#include "io_uring_engine.hpp"
+#include "websocket.hpp"
+#include "channel_registry.hpp"
+#include "rate_limiter.hpp"
+#include "../core/timer_wheel.hpp"
+#include "../utils/time_utils.hpp"
+#include "../utils/gzip_utils.hpp"
 
-typedef std::function<std::string(const http_request&)> route_handler;
+// Handlers returning std::string still fit: it converts to a 200 JSON response.
+typedef std::function<http_response(const http_request_view&)> route_handler;
+
+// Answers a request handed to an async route. Safe to call from any thread;
+// only the first call counts.
+typedef std::function<void(http_response)> response_sink;
+
+// Runs on a worker like route_handler but may return before answering: the
+// connection stays parked, holding no thread, until the sink is called. The
+// request view is only valid for the duration of the call.
+typedef std::function<void(const http_request_view&, response_sink)> async_route_handler;
+
+// Adapts a synchronous handler into an async route whose work runs on pool,
+// so slow handlers (password hashing, graph walks) hold neither a request
+// worker nor the requests queued behind them. The request is copied, as the
+// view would not outlive the hand-off. A full pool answers 503.
+inline async_route_handler offload_to(worker_pool& pool, route_handler handler) {
+    std::shared_ptr<const route_handler> shared_handler = std::make_shared<const route_handler>(std::move(handler));
+    return [&pool, shared_handler](const http_request_view& req, response_sink respond) {
+        std::shared_ptr<const http_request_copy> request = std::make_shared<const http_request_copy>(req);
+        bool queued = pool.try_submit([shared_handler, request, respond]() {
+            const http_request_view& view = request->view();
+            try {
+                respond((*shared_handler)(view));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: handler for " << view.method << " " << view.path << " threw: " << e.what() << std::endl;
+                respond(http_response(500, "{\"error\":\"Internal server error\"}"));
+            }
+        });
+        if (!queued) {
+            respond(http_response(503, "{\"error\":\"Server busy\"}"));
+        }
+    };
+}
+
+struct http_server_config {
+    size_t reactor_threads;
+    int listen_backlog;
+    bool pin_reactor_threads;
+    size_t worker_threads;
+    size_t max_queue_depth;
+    uint64_t max_queue_age_ms;
+    // A request's headers must arrive within header_timeout_ms of its first
+    // byte (or of the accept), and its body within body_timeout_ms of the
+    // headers. A response that makes no progress for write_timeout_ms is
+    // abandoned.
+    uint64_t header_timeout_ms;
+    uint64_t body_timeout_ms;
+    uint64_t keep_alive_timeout_ms;
+    uint64_t write_timeout_ms;
+    uint32_t max_requests_per_connection;
+    size_t max_header_bytes;
+    size_t max_body_bytes;
+    bool watch_static_files;
+    size_t sendfile_min_bytes;
+    int gzip_level;
+    size_t gzip_min_bytes;
+    bool use_io_uring;
+    uint64_t websocket_ping_interval_ms;
+    size_t websocket_max_backlog_bytes;
+    
+    http_server_config()
+        : reactor_threads(std::max(1u, std::thread::hardware_concurrency())),
+          listen_backlog(SOMAXCONN),
+          pin_reactor_threads(false),
+          worker_threads(std::max(2u, std::thread::hardware_concurrency())),
+          max_queue_depth(1024),
+          max_queue_age_ms(500),
+          header_timeout_ms(10000),
+          body_timeout_ms(30000),
+          keep_alive_timeout_ms(5000),
+          write_timeout_ms(30000),
+          max_requests_per_connection(100),
+          max_header_bytes(16384),
+          max_body_bytes(1024 * 1024),
+          watch_static_files(false),
+          sendfile_min_bytes(64 * 1024),
+          gzip_level(6),
+          gzip_min_bytes(1024),
+          use_io_uring(false),
+          websocket_ping_interval_ms(30000),
+          websocket_max_backlog_bytes(1024 * 1024) {}
+};
 
 class http_server {
 private:
+    static const size_t read_chunk_size = 16384;
+    static const int max_events = 256;
+    static const uint64_t timer_tick_ms = 100;
+    static const uint64_t limiter_sweep_ms = 10000;
+    static const unsigned uring_queue_depth = 1024;
+    static const unsigned uring_accepts = 8;
+    static const unsigned uring_max_files = 65536;
+    static const unsigned uring_recv_buffers = 256;
+    static const unsigned uring_file_buffers = 16;
+    static const size_t uring_file_buffer_size = 64 * 1024;
+    
+    // Completion tags carry the operation, the fixed-file slot and the low
+    // bits of the connection id, so a stale completion is never mistaken for
+    // one belonging to the slot's next owner.
+    enum uring_op : uint64_t {
+        op_accept = 1, op_wake, op_tick, op_watch,
+        op_recv, op_send, op_file_read, op_file_send, op_frame_send, op_cancel, op_close
+    };
+    
+    struct route_entry {
+        route_handler handler;
+        async_route_handler async_handler;
+        websocket_endpoint websocket;
+        route_limits limits;
+        // Separates this route's buckets from every other route's.
+        uint64_t limit_scope;
+        
+        route_entry() : limit_scope(0) {}
+    };
+    
+    // Either a handler's response or WebSocket bytes for the reactor to
+    // queue: a frame published to the socket or, with upgrade set, the 101
+    // reply that turns the connection into a WebSocket on the given channel.
+    struct completion {
+        int fd;
+        uint64_t connection_id;
+        http_response response;
+        std::shared_ptr<const std::string> frame;
+        const websocket_endpoint* upgrade;
+        uint64_t channel;
+    };
+    
+    // Timers name their connection the way completions do, by descriptor (or
+    // slot) and id.
+    typedef std::pair<int, uint64_t> timer_target;
+    
+    // One event loop with its own SO_REUSEPORT listener; the kernel spreads
+    // incoming connections across the listeners, and a connection stays on
+    // the reactor that accepted it. Workers hand responses back through the
+    // owning reactor's completion queue.
+    struct reactor {
+        size_t index;
+        int listen_fd;
+        int epoll_fd;
+        int wake_fd;
+        std::unordered_map<int, std::unique_ptr<http_connection>> connections;
+        uint64_t next_connection_id;
+        std::vector<completion> completions;
+        std::mutex completions_mutex;
+        std::thread thread;
+        timer_wheel<timer_target> timers;
+        // Set when this reactor runs on io_uring instead of epoll; connections
+        // are then keyed by fixed-file slot rather than descriptor.
+        std::unique_ptr<io_uring_engine> ring;
+        // Bit i is set while accept i is in the kernel; each has its own
+        // address buffer.
+        uint32_t accepts_armed;
+        struct sockaddr_in accept_addresses[uring_accepts];
+        socklen_t accept_address_lengths[uring_accepts];
+        uint64_t wake_value;
+        struct __kernel_timespec tick_timeout;
+        std::deque<std::pair<int, uint64_t>> file_buffer_waiters;
+        
+        explicit reactor(size_t reactor_index)
+            : index(reactor_index), listen_fd(-1), epoll_fd(-1), wake_fd(-1), next_connection_id(1),
+              timers(timer_tick_ms, time_utils::get_current_timestamp_ms()),
+              accepts_armed(0), accept_addresses(), accept_address_lengths(), wake_value(0), tick_timeout() {}
+    };
+    
     int port;
-    bool running;
-    int server_socket;
-    std::unordered_map<std::string, route_handler> routes;
-    std::mutex routes_mutex;
-    std::string base_path;
+    http_server_config config;
+    std::atomic<bool> running;
+    std::vector<std::unique_ptr<reactor>> reactors;
+    std::mutex reactors_mutex;
+    int static_watch_fd;
+    router<route_entry> routes;
+    std::unique_ptr<worker_pool> workers;
+    static_cache assets;
+    server_metrics metrics;
+    std::vector<std::pair<std::string, std::function<std::string()>>> metrics_sources;
+    channel_registry channels;
+    rate_limiter limiter;
+    uint64_t limited_routes;
     
 public:
-    http_server(int port_num, const std::string& client_path = "client");
+    http_server(int port_num, const std::string& client_path = "client",
+                const http_server_config& server_config = http_server_config());
     ~http_server();
     
     void register_route(const std::string& method, const std::string& path, route_handler handler);
-    void handle_client(int client_socket);
+    void register_async_route(const std::string& method, const std::string& path, async_route_handler handler);
+    void register_websocket(const std::string& path, websocket_endpoint endpoint);
+    // Applies token-bucket limits to an already registered route. Requests
+    // over the limit get a 429 from the reactor without reaching a worker.
+    bool set_rate_limit(const std::string& method, const std::string& path, const route_limits& limits);
+    // Sends a text message to every WebSocket on the channel; safe from any
+    // thread. Returns the number of sockets it was queued for.
+    size_t publish(uint64_t channel, std::string_view message);
+    bool is_online(uint64_t channel);
     void start();
     void stop();
     bool is_running() const;
+    std::string metrics_json();
+    // Adds "name": source() to the metrics document; for counters kept
+    // outside the server. Register before start().
+    void add_metrics_source(const std::string& name, std::function<std::string()> source);
     
 private:
-    std::string read_file(const std::string& filepath);
-    std::string get_content_type(const std::string& filepath);
-    std::string serve_static(const std::string& path);
+    bool serve_static(const http_request_view& req, bool keep_alive, http_connection& conn);
+    http_response dispatch(const http_request_view& req, const route_handler* handler);
+    void dispatch_async(size_t reactor_index, int fd, uint64_t connection_id, const http_request_view& req,
+                        const async_route_handler& handler);
+    void compress_response(bool accepts_gzip, http_response& response);
+    void deliver(size_t reactor_index, int fd, uint64_t connection_id, http_response response);
+    void accept_websocket(reactor& loop, int fd, uint64_t connection_id, const http_request_view& req,
+                          const websocket_endpoint& endpoint);
+    
+    bool open_listener(reactor& loop);
+    bool open_reactor(reactor& loop);
+    bool open_ring(reactor& loop);
+    void run_event_loop(reactor& loop);
+    void run_uring_loop(reactor& loop);
+    void handle_uring_event(reactor& loop, const struct io_uring_cqe& cqe);
+    void uring_accepted(reactor& loop, const struct io_uring_cqe& cqe);
+    void uring_arm_recv(reactor& loop, http_connection& conn);
+    void uring_received(reactor& loop, http_connection& conn, const struct io_uring_cqe& cqe);
+    void uring_send(reactor& loop, http_connection& conn);
+    void uring_sent(reactor& loop, http_connection& conn, uring_op op, int result);
+    void release_file_buffer(reactor& loop, http_connection& conn);
+    void uring_send_frames(reactor& loop, http_connection& conn);
+    void uring_frames_sent(reactor& loop, http_connection& conn, int result);
+    void uring_arm_accepts(reactor& loop);
+    void accept_connections(reactor& loop);
+    void read_from(reactor& loop, http_connection& conn);
+    void take_input(reactor& loop, http_connection& conn, const char* data, size_t size);
+    void process_input(reactor& loop, http_connection& conn);
+    bool send_pending(reactor& loop, http_connection& conn);
+    void flush(reactor& loop, http_connection& conn);
+    void finish_write(reactor& loop, http_connection& conn);
+    bool within_limits(const route_entry& route, const http_connection& conn, const http_request_view& req,
+                       uint64_t& retry_after_ms);
+    void release_request(http_connection& conn);
+    void post_completion(reactor& loop, int fd, uint64_t connection_id, http_response response);
+    void post(reactor& loop, completion done);
+    void drain_completions(reactor& loop);
+    void begin_websocket(reactor& loop, http_connection& conn, completion& done);
+    void process_frames(reactor& loop, http_connection& conn);
+    void handle_frame(reactor& loop, http_connection& conn, websocket::frame& frame);
+    bool queue_frame(reactor& loop, http_connection& conn, std::shared_ptr<const std::string> frame);
+    bool send_frames(reactor& loop, http_connection& conn);
+    void fail_websocket(reactor& loop, http_connection& conn, uint16_t status);
+    void leave_channel(reactor& loop, http_connection& conn, bool notify);
+    void notify_presence(const websocket_endpoint& endpoint, uint64_t channel, bool online);
+    bool is_open(reactor& loop, int fd, uint64_t connection_id);
+    void close_connection(reactor& loop, int fd);
+    void set_deadline(reactor& loop, http_connection& conn, http_connection::deadline_kind kind, uint64_t deadline_ms);
+    void await_request(reactor& loop, http_connection& conn);
+    void expire_timers(reactor& loop);
+    void handle_deadline(reactor& loop, http_connection& conn, uint64_t now_ms);
+    void shutdown_loop(reactor& loop);
+    
+    static bool set_non_blocking(int fd);
+    static void raise_fd_limit();
+    static void pin_to_cpu(std::thread& thread, size_t cpu);
+    static uint64_t uring_tag(uring_op op, int slot = 0, uint64_t connection_id = 0) {
+        return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(slot & 0xffffff) << 32) |
+               (connection_id & 0xffffffff);
+    }
 };
 
-inline http_server::http_server(int port_num, const std::string& client_path) 
-    : port(port_num), running(false), server_socket(-1), base_path(client_path) {}
+inline http_server::http_server(int port_num, const std::string& client_path, const http_server_config& server_config) 
+    : port(port_num), config(server_config), running(false), static_watch_fd(-1),
+      assets(client_path, server_config.sendfile_min_bytes, server_config.gzip_level), limited_routes(0) {}
 
 inline http_server::~http_server() {
     stop();
 }
 
 inline void http_server::register_route(const std::string& method, const std::string& path, route_handler handler) {
-    std::lock_guard<std::mutex> lock(routes_mutex);
-    std::string key = method + " " + path;
-    routes[key] = handler;
+    route_entry entry;
+    entry.handler = std::move(handler);
+    routes.add(method, path, std::move(entry));
 }
 
-inline std::string http_server::read_file(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file.is_open()) {
-        return "";
+inline void http_server::register_async_route(const std::string& method, const std::string& path,
+                                              async_route_handler handler) {
+    route_entry entry;
+    entry.async_handler = std::move(handler);
+    routes.add(method, path, std::move(entry));
+}
+
+inline void http_server::register_websocket(const std::string& path, websocket_endpoint endpoint) {
+    route_entry entry;
+    entry.websocket = std::move(endpoint);
+    routes.add("GET", path, std::move(entry));
+}
+
+inline bool http_server::set_rate_limit(const std::string& method, const std::string& path,
+                                       const route_limits& limits) {
+    route_entry* route = routes.find(method, path);
+    if (!route) {
+        std::cerr << "Error: cannot limit " << method << " " << path
+                  << (routes.is_frozen() ? " after the server has started" : ": no such route") << std::endl;
+        return false;
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    route->limits = limits;
+    route->limit_scope = ++limited_routes;
+    return true;
 }
 
-inline std::string http_server::get_content_type(const std::string& filepath) {
-    if (filepath.find(".html") != std::string::npos) return "text/html";
-    if (filepath.find(".css") != std::string::npos) return "text/css";
-    if (filepath.find(".js") != std::string::npos) return "application/javascript";
-    if (filepath.find(".json") != std::string::npos) return "application/json";
-    if (filepath.find(".png") != std::string::npos) return "image/png";
-    if (filepath.find(".jpg") != std::string::npos) return "image/jpeg";
-    if (filepath.find(".gif") != std::string::npos) return "image/gif";
-    return "text/plain";
+// The frame is encoded once and shared by every subscriber; each owning
+// reactor writes it straight to the socket, so no worker is involved.
+inline size_t http_server::publish(uint64_t channel, std::string_view message) {
+    std::vector<channel_subscriber> targets;
+    if (channels.subscribers(channel, targets) == 0) {
+        return 0;
+    }
+    std::shared_ptr<const std::string> frame =
+        std::make_shared<const std::string>(websocket::encode_frame(websocket::text_frame, message));
+    std::lock_guard<std::mutex> lock(reactors_mutex);
+    for (const channel_subscriber& target : targets) {
+        if (target.reactor_index < reactors.size()) {
+            post(*reactors[target.reactor_index], {target.fd, target.connection_id, http_response(), frame, nullptr, 0});
+        }
+    }
+    return targets.size();
 }
 
-inline std::string http_server::serve_static(const std::string& path) {
-    std::string request_path = path;
-    if (request_path == "/") {
-        request_path = "/index.html";
+inline bool http_server::is_online(uint64_t channel) {
+    return channels.is_subscribed(channel);
+}
+
+// Static files are answered on the event loop thread from the in-memory
+// table. Only the headers are built per request: small bodies are written
+// from the shared cached string and large ones are sent with sendfile from
+// the cached descriptor, so the body is never copied into user space.
+inline bool http_server::serve_static(const http_request_view& req, bool keep_alive, http_connection& conn) {
+    std::shared_ptr<const static_asset_table> table = assets.snapshot();
+    const static_asset* asset = table->find(req.path);
+    if (!asset) {
+        return false;
     }
     
-    std::string filepath = base_path + request_path;
-    std::string content = read_file(filepath);
+    // Ranges address the identity bytes, so a ranged request is never served
+    // the gzip variant.
+    if (asset->gzip_content && req.header("Range").empty() &&
+        gzip_utils::accepts_gzip(req.header("Accept-Encoding"))) {
+        if (static_cache::etag_matches(req.header("If-None-Match"), asset->gzip_etag)) {
+            conn.begin_response(http_response(304, std::string(), asset->content_type)
+                                    .add_header_lines(asset->gzip_headers), keep_alive);
+            return true;
+        }
+        conn.begin_response(http_response::shared(200, asset->gzip_content, 0, asset->gzip_content->size(),
+                                                  asset->content_type).add_header_lines(asset->gzip_headers), keep_alive);
+        metrics.compressed_responses++;
+        metrics.compression_bytes_saved += asset->size - asset->gzip_content->size();
+        return true;
+    }
     
-    if (content.empty()) {
-        return "";
+    if (static_cache::etag_matches(req.header("If-None-Match"), asset->etag)) {
+        conn.begin_response(http_response(304, std::string(), asset->content_type)
+                                .add_header_lines(asset->headers), keep_alive);
+        return true;
+    }
+    
+    uint64_t first = 0;
+    uint64_t last = asset->size ? asset->size - 1 : 0;
+    static_cache::range_status range = static_cache::no_range;
+    std::string_view if_range = req.header("If-Range");
+    if (if_range.empty() || if_range == asset->etag) {
+        range = static_cache::parse_range(req.header("Range"), asset->size, first, last);
+    }
+    if (range == static_cache::range_unsatisfiable) {
+        conn.begin_response(http_response(416, std::string(), asset->content_type)
+                                .add_header_lines(asset->headers)
+                                .add_header("Content-Range", "bytes */" + std::to_string(asset->size)), keep_alive);
+        return true;
     }
     
-    return content;
+    int status_code = range == static_cache::range_ok ? 206 : 200;
+    uint64_t length = asset->size ? last - first + 1 : 0;
+    http_response response = asset->file
+        ? http_response::file(status_code, asset->file, first, length, asset->content_type)
+        : http_response::shared(status_code, asset->content, first, length, asset->content_type);
+    response.add_header_lines(asset->headers);
+    if (range == static_cache::range_ok) {
+        response.add_header("Content-Range", "bytes " + std::to_string(first) + "-" + std::to_string(last) +
+                                             "/" + std::to_string(asset->size));
+    }
+    conn.begin_response(std::move(response), keep_alive);
+    return true;
 }
 
-inline void http_server::handle_client(int client_socket) {
-    char buffer[8192] = {0};
-    ssize_t bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
+inline http_response http_server::dispatch(const http_request_view& req, const route_handler* handler) {
+    http_response response(404, "{\"error\":\"Route not found\"}");
     
-    if (bytes_received > 0) {
-        buffer[bytes_received] = '\0';
-        http_request req = request_parser::parse(std::string(buffer));
-        
-        size_t query_pos = req.path.find('?');
-        std::string path_without_query = req.path;
-        if (query_pos != std::string::npos) {
-            path_without_query = req.path.substr(0, query_pos);
-        }
-        
-        std::lock_guard<std::mutex> lock(routes_mutex);
-        std::string route_key = req.method + " " + path_without_query;
-        
-        std::string response_body;
-        int status_code = 404;
-        std::string content_type = "application/json";
-        
-        if (req.method == "OPTIONS") {
-            status_code = 200;
-            response_body = "";
-            content_type = "text/plain";
-        } else if (routes.find(route_key) != routes.end()) {
-            response_body = routes[route_key](req);
-            status_code = 200;
-        } else if (req.method == "GET") {
-            std::string static_path = path_without_query;
-            if (static_path == "/") {
-                static_path = "/index.html";
-            }
-            response_body = serve_static(static_path);
-            if (!response_body.empty()) {
-                status_code = 200;
-                std::string file_path_for_type = static_path;
-                content_type = get_content_type(file_path_for_type);
-            } else {
-                response_body = "{\"error\":\"Route not found\"}";
-                status_code = 404;
-            }
-        } else {
-            response_body = "{\"error\":\"Route not found\"}";
-            status_code = 404;
+    if (req.method == "OPTIONS") {
+        response = http_response(200, std::string(), "text/plain");
+    } else if (handler) {
+        try {
+            response = (*handler)(req);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: handler for " << req.method << " " << req.path << " threw: " << e.what() << std::endl;
+            response = http_response(500, "{\"error\":\"Internal server error\"}");
         }
-        
-        std::string response = response_builder::build(status_code, response_body, content_type);
-        send(client_socket, response.c_str(), response.length(), 0);
     }
     
-    close(client_socket);
+    compress_response(gzip_utils::accepts_gzip(req.header("Accept-Encoding")), response);
+    return response;
 }
 
-inline void http_server::start() {
-    if (running) {
-        std::cerr << "Server is already running!" << std::endl;
+// The sink outlives the request view, so anything it needs from the request
+// is captured up front.
+inline void http_server::dispatch_async(size_t reactor_index, int fd, uint64_t connection_id,
+                                        const http_request_view& req, const async_route_handler& handler) {
+    bool accepts_gzip = gzip_utils::accepts_gzip(req.header("Accept-Encoding"));
+    std::shared_ptr<std::atomic<bool>> answered = std::make_shared<std::atomic<bool>>(false);
+    response_sink respond = [this, reactor_index, fd, connection_id, accepts_gzip, answered](http_response response) {
+        if (answered->exchange(true)) {
+            return;
+        }
+        compress_response(accepts_gzip, response);
+        deliver(reactor_index, fd, connection_id, std::move(response));
+    };
+    try {
+        handler(req, respond);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: handler for " << req.method << " " << req.path << " threw: " << e.what() << std::endl;
+        respond(http_response(500, "{\"error\":\"Internal server error\"}"));
+    }
+}
+
+// Runs on the worker (or whichever thread answers an async route), so large
+// JSON payloads are compressed off the event loop thread. Every response of
+// a compressible type says Vary, compressed or not: whether it was depends
+// on this request and this body's size, and a shared cache must not hand
+// one client's encoding to another.
+inline void http_server::compress_response(bool accepts_gzip, http_response& response) {
+    if (!gzip_utils::is_compressible(response.content_type())) {
         return;
     }
-    
-    server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket < 0) {
-        std::cerr << "Error: Failed to create socket: " << strerror(errno) << std::endl;
+    response.add_header_lines("Vary: Accept-Encoding\r\n");
+    std::string compressed;
+    if (accepts_gzip && response.owns_body() && response.content_length() >= config.gzip_min_bytes &&
+        gzip_utils::compress(response.body(), config.gzip_level, compressed) &&
+        compressed.size() < response.content_length()) {
+        metrics.compressed_responses++;
+        metrics.compression_bytes_saved += response.content_length() - compressed.size();
+        response.set_body(std::move(compressed));
+        response.add_header_lines("Content-Encoding: gzip\r\n");
+    }
+}
+
+// A parked request may be answered after its reactor has shut down; the
+// reactors lock keeps that from touching a destroyed loop.
+inline void http_server::deliver(size_t reactor_index, int fd, uint64_t connection_id, http_response response) {
+    std::lock_guard<std::mutex> lock(reactors_mutex);
+    if (reactor_index < reactors.size()) {
+        post_completion(*reactors[reactor_index], fd, connection_id, std::move(response));
+    }
+}
+
+// Runs on a worker: validates the upgrade and authenticates it, then hands
+// the 101 reply back so the reactor switches the connection over.
+inline void http_server::accept_websocket(reactor& loop, int fd, uint64_t connection_id, const http_request_view& req,
+                                          const websocket_endpoint& endpoint) {
+    std::string_view key;
+    if (!websocket::handshake_key(req, key)) {
+        post_completion(loop, fd, connection_id, http_response(400, "{\"error\":\"Bad WebSocket handshake\"}")
+                                                     .add_header("Sec-WebSocket-Version", "13"));
+        return;
+    }
+    uint64_t channel = 0;
+    try {
+        channel = endpoint.authenticate(req);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: WebSocket authentication for " << req.path << " threw: " << e.what() << std::endl;
+        post_completion(loop, fd, connection_id, http_response(500, "{\"error\":\"Internal server error\"}"));
         return;
     }
+    if (channel == 0) {
+        post_completion(loop, fd, connection_id, http_response(401, "{\"error\":\"Invalid session\"}"));
+        return;
+    }
+    post(loop, {fd, connection_id, http_response(),
+                std::make_shared<const std::string>(websocket::handshake_response(key)), &endpoint, channel});
+}
+
+inline bool http_server::set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return false;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Each idle keep-alive client costs one descriptor, so lift the soft limit
+// to the hard limit instead of stalling at the usual 1024.
+inline void http_server::raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+inline bool http_server::open_listener(reactor& loop) {
+    loop.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (loop.listen_fd < 0) {
+        std::cerr << "Error: Failed to create socket: " << strerror(errno) << std::endl;
+        return false;
+    }
     
     int opt = 1;
-    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+    if (setsockopt(loop.listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        setsockopt(loop.listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
         std::cerr << "Error: Failed to set socket options: " << strerror(errno) << std::endl;
-        close(server_socket);
-        server_socket = -1;
-        return;
+        close(loop.listen_fd);
+        loop.listen_fd = -1;
+        return false;
     }
     
     struct sockaddr_in server_addr;
@@ -178,40 +569,1272 @@ inline void http_server::start() {
     server_addr.sin_addr.s_addr = INADDR_ANY;
     server_addr.sin_port = htons(port);
     
-    if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    if (bind(loop.listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         std::cerr << "Error: Failed to bind to port " << port << ": " << strerror(errno) << std::endl;
         std::cerr << "Port " << port << " may already be in use. Try: pkill -f chess_server" << std::endl;
-        close(server_socket);
-        server_socket = -1;
-        return;
+        close(loop.listen_fd);
+        loop.listen_fd = -1;
+        return false;
     }
     
-    if (listen(server_socket, 10) < 0) {
+    if (listen(loop.listen_fd, config.listen_backlog) < 0) {
         std::cerr << "Error: Failed to listen on socket: " << strerror(errno) << std::endl;
-        close(server_socket);
-        server_socket = -1;
+        close(loop.listen_fd);
+        loop.listen_fd = -1;
+        return false;
+    }
+    
+    return true;
+}
+
+inline bool http_server::open_reactor(reactor& loop) {
+    if (!open_listener(loop)) {
+        return false;
+    }
+    
+    loop.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop.wake_fd < 0) {
+        std::cerr << "Error: Failed to create event loop: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (loop.index == 0 && config.watch_static_files) {
+        static_watch_fd = assets.start_watching();
+    }
+    if (config.use_io_uring && open_ring(loop)) {
+        return true;
+    }
+    
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epoll_fd < 0) {
+        std::cerr << "Error: Failed to create event loop: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = loop.listen_fd;
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.listen_fd, &ev);
+    ev.events = EPOLLIN;
+    ev.data.fd = loop.wake_fd;
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wake_fd, &ev);
+    if (loop.index == 0 && static_watch_fd >= 0) {
+        ev.data.fd = static_watch_fd;
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, static_watch_fd, &ev);
+    }
+    return true;
+}
+
+// The fixed-file table cannot exceed RLIMIT_NOFILE, which raise_fd_limit()
+// has already lifted as far as it goes.
+inline bool http_server::open_ring(reactor& loop) {
+    unsigned max_files = uring_max_files;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < max_files) {
+        max_files = static_cast<unsigned>(limit.rlim_cur);
+    }
+    loop.ring = std::make_unique<io_uring_engine>();
+    if (!loop.ring->init(uring_queue_depth, max_files, uring_recv_buffers, read_chunk_size,
+                         uring_file_buffers, uring_file_buffer_size)) {
+        std::cerr << "Reactor " << loop.index << " falling back to epoll" << std::endl;
+        loop.ring.reset();
+        return false;
+    }
+    return true;
+}
+
+inline void http_server::pin_to_cpu(std::thread& thread, size_t cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int result = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+    if (result != 0) {
+        std::cerr << "Error: could not pin reactor to CPU " << cpu << ": " << strerror(result) << std::endl;
+    }
+}
+
+inline void http_server::start() {
+    if (running) {
+        std::cerr << "Server is already running!" << std::endl;
         return;
     }
     
+    // sendfile() has no MSG_NOSIGNAL; a peer reset must not kill the process.
+    std::signal(SIGPIPE, SIG_IGN);
+    routes.freeze();
+    if (assets.load()) {
+        std::cout << "Loaded " << assets.snapshot()->size() << " static assets" << std::endl;
+    }
+    raise_fd_limit();
+    
+    size_t reactor_count = std::max<size_t>(1, config.reactor_threads);
+    {
+        std::lock_guard<std::mutex> lock(reactors_mutex);
+        for (size_t i = 0; i < reactor_count; i++) {
+            reactors.push_back(std::make_unique<reactor>(i));
+            if (!open_reactor(*reactors.back())) {
+                for (auto& loop : reactors) {
+                    shutdown_loop(*loop);
+                }
+                reactors.clear();
+                return;
+            }
+        }
+    }
+    
+    workers = std::make_unique<worker_pool>(config.worker_threads, config.max_queue_depth, config.max_queue_age_ms);
+    if (limited_routes > 0) {
+        limiter.start(limiter_sweep_ms);
+    }
     running = true;
-    std::cout << "Server successfully bound to port " << port << std::endl;
+    std::cout << "Server successfully bound to port " << port << " with " << reactor_count
+              << " reactor threads (" << (reactors[0]->ring ? "io_uring" : "epoll") << ") and "
+              << workers->thread_count() << " worker threads" << std::endl;
+    
+    // The calling thread runs reactor 0, so start() still blocks until stop().
+    size_t cpu_count = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 1; i < reactor_count; i++) {
+        reactor& loop = *reactors[i];
+        loop.thread = std::thread([this, &loop]() { run_event_loop(loop); });
+        if (config.pin_reactor_threads) {
+            pin_to_cpu(loop.thread, i % cpu_count);
+        }
+    }
+    run_event_loop(*reactors[0]);
+    
+    running = false;
+    for (auto& loop : reactors) {
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+    }
+    // Workers may still post to a reactor's queue, so stop them first.
+    if (workers) {
+        workers->stop();
+        workers.reset();
+    }
+    limiter.stop();
+    {
+        std::lock_guard<std::mutex> lock(reactors_mutex);
+        for (auto& loop : reactors) {
+            shutdown_loop(*loop);
+        }
+        reactors.clear();
+    }
+    assets.stop_watching();
+    static_watch_fd = -1;
+}
+
+inline void http_server::run_event_loop(reactor& loop) {
+    if (loop.ring) {
+        run_uring_loop(loop);
+        return;
+    }
+    struct epoll_event events[max_events];
     
     while (running) {
+        // Sleep until the next tick only while some timer is pending.
+        int wait_ms = -1;
+        if (!loop.timers.empty()) {
+            wait_ms = static_cast<int>(timer_tick_ms - time_utils::get_current_timestamp_ms() % timer_tick_ms);
+        }
+        int ready = epoll_wait(loop.epoll_fd, events, max_events, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+            
+            if (fd == loop.listen_fd) {
+                accept_connections(loop);
+                continue;
+            }
+            if (fd == loop.wake_fd) {
+                uint64_t value;
+                while (read(loop.wake_fd, &value, sizeof(value)) > 0) {}
+                drain_completions(loop);
+                continue;
+            }
+            if (fd == static_watch_fd) {
+                assets.handle_watch_events();
+                continue;
+            }
+            
+            auto it = loop.connections.find(fd);
+            if (it == loop.connections.end()) continue;
+            http_connection& conn = *it->second;
+            
+            if (flags & (EPOLLERR | EPOLLHUP)) {
+                close_connection(loop, fd);
+                continue;
+            }
+            if (flags & EPOLLRDHUP) {
+                conn.peer_closed = true;
+            }
+            if (flags & EPOLLIN) {
+                read_from(loop, conn);
+                if (loop.connections.find(fd) == loop.connections.end()) continue;
+            }
+            if ((flags & EPOLLOUT) && conn.has_pending_output()) {
+                flush(loop, conn);
+            } else if ((flags & EPOLLOUT) && !conn.frames_out.empty()) {
+                send_frames(loop, conn);
+            }
+        }
+        expire_timers(loop);
+    }
+}
+
+inline void http_server::accept_connections(reactor& loop) {
+    while (true) {
         struct sockaddr_in client_addr;
         socklen_t client_addr_len = sizeof(client_addr);
+        int client_socket = accept4(loop.listen_fd, (struct sockaddr*)&client_addr, &client_addr_len,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "Error: accept failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = client_socket;
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+            close(client_socket);
+            continue;
+        }
+        uint64_t now_ms = time_utils::get_current_timestamp_ms();
+        std::unique_ptr<http_connection>& conn = loop.connections[client_socket];
+        conn = std::make_unique<http_connection>(client_socket, loop.next_connection_id++, now_ms,
+                                                 config.max_header_bytes, config.max_body_bytes);
+        conn->peer_address = client_addr.sin_addr.s_addr;
+        set_deadline(loop, *conn, http_connection::header_deadline, now_ms + config.header_timeout_ms);
+        metrics.connections_accepted++;
+        metrics.connections_open++;
+    }
+}
+
+// The io_uring loop keeps a few accepts, one wake read, one tick timeout and
+// (on reactor 0) one watch poll armed, plus at most one recv and one send or
+// file read per connection. Each pass submits whatever the previous
+// completions queued and sleeps in the same syscall.
+inline void http_server::run_uring_loop(reactor& loop) {
+    io_uring_engine& ring = *loop.ring;
+    loop.tick_timeout.tv_sec = timer_tick_ms / 1000;
+    loop.tick_timeout.tv_nsec = (timer_tick_ms % 1000) * 1000000LL;
+    uring_arm_accepts(loop);
+    ring.prep_read(loop.wake_fd, &loop.wake_value, sizeof(loop.wake_value), uring_tag(op_wake));
+    ring.prep_timeout(&loop.tick_timeout, uring_tag(op_tick));
+    if (loop.index == 0 && static_watch_fd >= 0) {
+        ring.prep_poll(static_watch_fd, uring_tag(op_watch));
+    }
+    
+    while (running) {
+        int result = ring.submit(1);
+        if (result < 0 && result != -EBUSY && result != -EAGAIN) {
+            std::cerr << "Error: io_uring_enter failed: " << strerror(-result) << std::endl;
+            break;
+        }
+        ring.drain([this, &loop](const struct io_uring_cqe& cqe) { handle_uring_event(loop, cqe); });
+    }
+}
+
+inline void http_server::handle_uring_event(reactor& loop, const struct io_uring_cqe& cqe) {
+    io_uring_engine& ring = *loop.ring;
+    uring_op op = static_cast<uring_op>(cqe.user_data >> 56);
+    switch (op) {
+    case op_accept:
+        uring_accepted(loop, cqe);
+        return;
+    case op_wake:
+        drain_completions(loop);
+        if (running) {
+            ring.prep_read(loop.wake_fd, &loop.wake_value, sizeof(loop.wake_value), uring_tag(op_wake));
+        }
+        return;
+    case op_tick:
+        expire_timers(loop);
+        uring_arm_accepts(loop);
+        ring.prep_timeout(&loop.tick_timeout, uring_tag(op_tick));
+        return;
+    case op_watch:
+        assets.handle_watch_events();
+        ring.prep_poll(static_watch_fd, uring_tag(op_watch));
+        return;
+    case op_cancel:
+    case op_close:
+        return;
+    default:
+        break;
+    }
+    
+    int slot = static_cast<int>((cqe.user_data >> 32) & 0xffffff);
+    auto it = loop.connections.find(slot);
+    if (it == loop.connections.end() || (it->second->id & 0xffffffff) != (cqe.user_data & 0xffffffff)) {
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            ring.recycle_recv_buffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        return;
+    }
+    http_connection* conn = it->second.get();
+    conn->ops_pending--;
+    if (conn->closing) {
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            ring.recycle_recv_buffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        close_connection(loop, slot);
+        return;
+    }
+    if (op == op_recv) {
+        uring_received(loop, *conn, cqe);
+    } else if (op == op_frame_send) {
+        uring_frames_sent(loop, *conn, cqe.res);
+    } else {
+        uring_sent(loop, *conn, op, cqe.res);
+    }
+    
+    auto still_open = loop.connections.find(slot);
+    if (still_open != loop.connections.end() && still_open->second.get() == conn && !conn->closing) {
+        uring_arm_recv(loop, *conn);
+    }
+}
+
+inline void http_server::uring_arm_accepts(reactor& loop) {
+    if (!running) {
+        return;
+    }
+    for (unsigned i = 0; i < uring_accepts; i++) {
+        if (loop.accepts_armed & (1u << i)) {
+            continue;
+        }
+        loop.accept_address_lengths[i] = sizeof(loop.accept_addresses[i]);
+        loop.ring->prep_accept(loop.listen_fd, reinterpret_cast<struct sockaddr*>(&loop.accept_addresses[i]),
+                               &loop.accept_address_lengths[i], uring_tag(op_accept, static_cast<int>(i)));
+        loop.accepts_armed |= 1u << i;
+    }
+}
+
+inline void http_server::uring_accepted(reactor& loop, const struct io_uring_cqe& cqe) {
+    unsigned index = static_cast<unsigned>((cqe.user_data >> 32) & 0xffffff);
+    loop.accepts_armed &= ~(1u << index);
+    if (cqe.res < 0) {
+        // After an error (e.g. a full fixed-file table) the accept is left
+        // for the next tick to rearm, so a persistent failure doesn't spin.
+        if (cqe.res != -ECANCELED) {
+            std::cerr << "Error: accept failed: " << strerror(-cqe.res) << std::endl;
+        }
+        return;
+    }
+    int slot = cqe.res;
+    uint64_t now_ms = time_utils::get_current_timestamp_ms();
+    std::unique_ptr<http_connection>& conn = loop.connections[slot];
+    conn = std::make_unique<http_connection>(slot, loop.next_connection_id++, now_ms,
+                                             config.max_header_bytes, config.max_body_bytes);
+    conn->peer_address = loop.accept_addresses[index].sin_addr.s_addr;
+    set_deadline(loop, *conn, http_connection::header_deadline, now_ms + config.header_timeout_ms);
+    metrics.connections_accepted++;
+    metrics.connections_open++;
+    uring_arm_recv(loop, *conn);
+    uring_arm_accepts(loop);
+}
+
+// No receive is posted while a handler runs; drain_completions() restarts
+// input once the response is back, as with epoll.
+inline void http_server::uring_arm_recv(reactor& loop, http_connection& conn) {
+    if (conn.closing || conn.recv_armed || conn.peer_closed || conn.in_flight) {
+        return;
+    }
+    conn.recv_armed = true;
+    conn.ops_pending++;
+    loop.ring->prep_recv(conn.fd, uring_tag(op_recv, conn.fd, conn.id));
+}
+
+inline void http_server::uring_received(reactor& loop, http_connection& conn, const struct io_uring_cqe& cqe) {
+    conn.recv_armed = false;
+    if (cqe.res == -ENOBUFS) {
+        // Every provided buffer is in use; the caller posts the recv again.
+        return;
+    }
+    if (cqe.res < 0) {
+        close_connection(loop, conn.fd);
+        return;
+    }
+    
+    if (cqe.res == 0) {
+        conn.peer_closed = true;
+    }
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        const char* data = loop.ring->recv_buffer(buffer_id);
+        if (conn.in_flight) {
+            // Park the bytes: a handler still reads views into in_buffer.
+            conn.deferred_input.append(data, cqe.res);
+        } else {
+            // Recycling only queues an entry, so the kernel cannot refill the
+            // buffer until after take_input() has copied it into in_buffer.
+            take_input(loop, conn, data, cqe.res);
+            loop.ring->recycle_recv_buffer(buffer_id);
+            return;
+        }
+        loop.ring->recycle_recv_buffer(buffer_id);
+    }
+    if (conn.in_flight) {
+        conn.read_pending = true;
+        return;
+    }
+    process_input(loop, conn);
+}
+
+// Queues the next piece of the current response. The in-memory parts go out
+// in one sendmsg; a file body is read into a registered buffer with
+// READ_FIXED and sent from there, since io_uring has no sendfile.
+inline void http_server::uring_send(reactor& loop, http_connection& conn) {
+    if (conn.closing) {
+        return;
+    }
+    io_uring_engine& ring = *loop.ring;
+    const http_response& response = conn.out_response;
+    uint64_t memory_size = response.memory_size();
+    
+    if (conn.out_sent < memory_size) {
+        memset(&conn.send_message, 0, sizeof(conn.send_message));
+        conn.send_message.msg_iov = conn.send_parts;
+        conn.send_message.msg_iovlen = response.gather(conn.send_parts, conn.out_sent);
+        int flags = MSG_NOSIGNAL | (response.file_source() ? MSG_MORE : 0);
+        ring.prep_sendmsg(conn.fd, &conn.send_message, flags, uring_tag(op_send, conn.fd, conn.id));
+    } else if (conn.file_chunk_sent < conn.file_chunk) {
+        ring.prep_send(conn.fd, ring.fixed_buffer(conn.file_buffer) + conn.file_chunk_sent,
+                       conn.file_chunk - conn.file_chunk_sent, uring_tag(op_file_send, conn.fd, conn.id));
+    } else {
+        if (conn.file_buffer < 0) {
+            conn.file_buffer = ring.acquire_fixed_buffer();
+        }
+        if (conn.file_buffer < 0) {
+            loop.file_buffer_waiters.push_back(std::make_pair(conn.fd, conn.id));
+            return;
+        }
+        uint64_t body_sent = conn.out_sent - memory_size;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(ring.fixed_buffer_size(), conn.out_total - conn.out_sent));
+        ring.prep_read_fixed(response.file_source()->fd, conn.file_buffer, length,
+                             response.file_start() + body_sent, uring_tag(op_file_read, conn.fd, conn.id));
+    }
+    conn.ops_pending++;
+}
+
+inline void http_server::uring_sent(reactor& loop, http_connection& conn, uring_op op, int result) {
+    // A zero-byte file read means the file shrank under us; the promised
+    // length can't be met.
+    if (result <= 0) {
+        close_connection(loop, conn.fd);
+        return;
+    }
+    if (op == op_file_read) {
+        conn.file_chunk = static_cast<uint32_t>(result);
+        conn.file_chunk_sent = 0;
+        uring_send(loop, conn);
+        return;
+    }
+    
+    conn.out_sent += result;
+    conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+    if (op == op_file_send) {
+        conn.file_chunk_sent += result;
+        if (conn.file_chunk_sent == conn.file_chunk) {
+            conn.file_chunk = conn.file_chunk_sent = 0;
+        }
+    }
+    if (conn.has_pending_output()) {
+        uring_send(loop, conn);
+        return;
+    }
+    release_file_buffer(loop, conn);
+    conn.clear_output();
+    finish_write(loop, conn);
+}
+
+// Hands the buffer to the first connection still waiting for one.
+inline void http_server::release_file_buffer(reactor& loop, http_connection& conn) {
+    if (conn.file_buffer < 0) {
+        return;
+    }
+    loop.ring->release_fixed_buffer(conn.file_buffer);
+    conn.file_buffer = -1;
+    conn.file_chunk = conn.file_chunk_sent = 0;
+    while (!loop.file_buffer_waiters.empty()) {
+        std::pair<int, uint64_t> waiter = loop.file_buffer_waiters.front();
+        loop.file_buffer_waiters.pop_front();
+        auto it = loop.connections.find(waiter.first);
+        if (it != loop.connections.end() && it->second->id == waiter.second && !it->second->closing) {
+            uring_send(loop, *it->second);
+            return;
+        }
+    }
+}
+
+// One sendmsg of queued frames is in the kernel at a time; frames queued
+// meanwhile go out with the next one.
+inline void http_server::uring_send_frames(reactor& loop, http_connection& conn) {
+    if (conn.closing || conn.frames_sending || conn.frames_out.empty()) {
+        return;
+    }
+    memset(&conn.send_message, 0, sizeof(conn.send_message));
+    conn.send_message.msg_iov = conn.send_parts;
+    conn.send_message.msg_iovlen = conn.gather_frames(conn.send_parts);
+    loop.ring->prep_sendmsg(conn.fd, &conn.send_message, MSG_NOSIGNAL, uring_tag(op_frame_send, conn.fd, conn.id));
+    conn.frames_sending = true;
+    conn.ops_pending++;
+}
+
+inline void http_server::uring_frames_sent(reactor& loop, http_connection& conn, int result) {
+    conn.frames_sending = false;
+    if (result <= 0) {
+        close_connection(loop, conn.fd);
+        return;
+    }
+    conn.frames_written(result);
+    if (!conn.frames_out.empty()) {
+        uring_send_frames(loop, conn);
+    } else if (conn.close_sent) {
+        close_connection(loop, conn.fd);
+    }
+}
+
+inline void http_server::read_from(reactor& loop, http_connection& conn) {
+    // A handler is still reading views into in_buffer; growing it now could
+    // move the bytes under it. Resume once the response is handed back.
+    if (conn.in_flight) {
+        conn.read_pending = true;
+        return;
+    }
+    // With io_uring the bytes arrive in recv completions; only those parked
+    // while a handler ran are left to pick up here.
+    if (loop.ring) {
+        std::string parked;
+        parked.swap(conn.deferred_input);
+        take_input(loop, conn, parked.data(), parked.size());
+        return;
+    }
+    
+    size_t max_buffered = config.max_header_bytes + config.max_body_bytes;
+    
+    // Slide unconsumed pipelined bytes to the front once the consumed prefix
+    // dominates; the parser's offsets are relative to in_start so stay valid.
+    if (conn.in_start > 0 && conn.in_start >= conn.buffered_input()) {
+        conn.in_buffer.erase(0, conn.in_start);
+        conn.in_start = 0;
+    }
+    
+    // Edge-triggered: drain the socket until the kernel reports EAGAIN.
+    while (true) {
+        size_t used = conn.in_buffer.size();
+        conn.in_buffer.resize(used + read_chunk_size);
+        ssize_t bytes_received = recv(conn.fd, &conn.in_buffer[used], read_chunk_size, 0);
+        conn.in_buffer.resize(used + (bytes_received > 0 ? bytes_received : 0));
+        if (bytes_received > 0) {
+            if (conn.buffered_input() > max_buffered) {
+                close_connection(loop, conn.fd);
+                return;
+            }
+            continue;
+        }
+        if (bytes_received == 0) {
+            conn.peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            close_connection(loop, conn.fd);
+            return;
+        }
+        break;
+    }
+    
+    conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+    process_input(loop, conn);
+}
+
+inline void http_server::take_input(reactor& loop, http_connection& conn, const char* data, size_t size) {
+    if (conn.in_start > 0 && conn.in_start >= conn.buffered_input()) {
+        conn.in_buffer.erase(0, conn.in_start);
+        conn.in_start = 0;
+    }
+    conn.in_buffer.append(data, size);
+    if (conn.buffered_input() > config.max_header_bytes + config.max_body_bytes) {
+        close_connection(loop, conn.fd);
+        return;
+    }
+    conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+    process_input(loop, conn);
+}
+
+inline void http_server::process_input(reactor& loop, http_connection& conn) {
+    if (conn.is_websocket()) {
+        process_frames(loop, conn);
+        return;
+    }
+    // Loops rather than recursing through flush() so a long run of pipelined
+    // static requests cannot grow the stack.
+    while (!conn.in_flight && !conn.has_pending_output() && !conn.close_after_write) {
+        request_parser::parse_status status = conn.parser.feed(conn.in_buffer.data() + conn.in_start,
+                                                               conn.buffered_input());
+        if (status == request_parser::need_more) {
+            if (conn.peer_closed) {
+                close_connection(loop, conn.fd);
+                return;
+            }
+            await_request(loop, conn);
+            return;
+        }
+        // Whatever the request waited on is over; the write or the handler
+        // decides what comes next.
+        set_deadline(loop, conn, http_connection::no_deadline, 0);
+        if (status == request_parser::failed) {
+            int error_status = conn.parser.error_status();
+            conn.close_after_write = true;
+            conn.begin_response(http_response(error_status,
+                "{\"error\":\"" + response_builder::get_status_message(error_status) + "\"}"), false);
+            flush(loop, conn);
+            return;
+        }
+        if (status == request_parser::headers_complete) {
+            // A body is on its way. A limited client is refused now, before
+            // any of it is buffered, and the connection is closed rather
+            // than left to drain the body.
+            http_request_view req = conn.parser.to_view();
+            const route_entry* route = routes.match(req.method, req.path, req);
+            uint64_t retry_after_ms = 0;
+            if (route && route->limit_scope && !within_limits(*route, conn, req, retry_after_ms)) {
+                conn.requests_served++;
+                metrics.requests_total++;
+                metrics.requests_limited++;
+                conn.close_after_write = true;
+                conn.begin_response(http_response(429, "{\"error\":\"Too many requests\"}")
+                                        .add_header("Retry-After", std::to_string((retry_after_ms + 999) / 1000)),
+                                    false);
+                flush(loop, conn);
+                return;
+            }
+            conn.limits_checked = true;
+            continue;
+        }
+        
+        http_request_view req = conn.parser.to_view();
+        const route_entry* route = routes.match(req.method, req.path, req);
+        conn.requests_served++;
+        metrics.requests_total++;
+        
+        bool keep_alive = running && !conn.peer_closed &&
+                          conn.requests_served < config.max_requests_per_connection &&
+                          request_parser::wants_keep_alive(req);
+        conn.close_after_write = !keep_alive;
         
-        int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_addr_len);
-        if (client_socket >= 0) {
-            std::thread(&http_server::handle_client, this, client_socket).detach();
+        // Static files and over-limit rejections are answered right here.
+        bool answered = false;
+        uint64_t retry_after_ms = 0;
+        if (!route) {
+            answered = req.method == "GET" && serve_static(req, keep_alive, conn);
+        } else if (route->limit_scope && !conn.limits_checked && !within_limits(*route, conn, req, retry_after_ms)) {
+            metrics.requests_limited++;
+            conn.begin_response(http_response(429, "{\"error\":\"Too many requests\"}")
+                                    .add_header("Retry-After", std::to_string((retry_after_ms + 999) / 1000)),
+                                keep_alive);
+            answered = true;
+        }
+        if (answered) {
+            release_request(conn);
+            if (!send_pending(loop, conn)) {
+                return;
+            }
+            if (conn.close_after_write) {
+                close_connection(loop, conn.fd);
+                return;
+            }
+            conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+            continue;
         }
+        
+        int fd = conn.fd;
+        uint64_t connection_id = conn.id;
+        bool admitted = workers->try_submit([this, &loop, fd, connection_id, req, route]() {
+            if (route && route->websocket.authenticate) {
+                accept_websocket(loop, fd, connection_id, req, route->websocket);
+                return;
+            }
+            if (route && route->async_handler && req.method != "OPTIONS") {
+                dispatch_async(loop.index, fd, connection_id, req, route->async_handler);
+                return;
+            }
+            post_completion(loop, fd, connection_id, dispatch(req, route ? &route->handler : nullptr));
+        });
+        
+        if (!admitted) {
+            metrics.requests_rejected++;
+            release_request(conn);
+            conn.close_after_write = true;
+            conn.begin_response(http_response(503, "{\"error\":\"Server busy\"}"), false);
+            flush(loop, conn);
+            return;
+        }
+        conn.in_flight = true;
+        return;
+    }
+}
+
+// Runs on the reactor before the body is looked at or a worker is involved,
+// so a flood costs a hash lookup per request. Requests without a bearer
+// token are limited by address alone.
+inline bool http_server::within_limits(const route_entry& route, const http_connection& conn,
+                                       const http_request_view& req, uint64_t& retry_after_ms) {
+    uint64_t now_ms = time_utils::get_current_timestamp_ms();
+    const route_limits& limits = route.limits;
+    if (limits.per_address.enabled() &&
+        !limiter.allow(rate_limiter::make_key(route.limit_scope * 2, conn.peer_address), limits.per_address,
+                       now_ms, retry_after_ms)) {
+        return false;
+    }
+    std::string_view authorization = req.header("Authorization");
+    if (limits.per_token.enabled() && authorization.size() > 7 && authorization.compare(0, 7, "Bearer ") == 0) {
+        uint64_t token_hash = std::hash<std::string_view>()(authorization.substr(7));
+        return limiter.allow(rate_limiter::make_key(route.limit_scope * 2 + 1, token_hash), limits.per_token,
+                             now_ms, retry_after_ms);
+    }
+    return true;
+}
+
+// Drops the bytes of the request that just finished; views handed to its
+// handler are dead after this.
+inline void http_server::release_request(http_connection& conn) {
+    conn.in_start += conn.parser.consumed();
+    conn.parser.reset();
+    conn.limits_checked = false;
+    if (conn.in_start == conn.in_buffer.size()) {
+        conn.in_buffer.clear();
+        conn.in_start = 0;
+    }
+}
+
+inline void http_server::post_completion(reactor& loop, int fd, uint64_t connection_id, http_response response) {
+    post(loop, {fd, connection_id, std::move(response), nullptr, nullptr, 0});
+}
+
+// Only the post that finds the queue empty wakes the reactor: it reads the
+// eventfd before taking the queue, so later posts ride on the same wakeup.
+inline void http_server::post(reactor& loop, completion done) {
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(loop.completions_mutex);
+        was_empty = loop.completions.empty();
+        loop.completions.push_back(std::move(done));
+    }
+    if (!was_empty) {
+        return;
+    }
+    uint64_t value = 1;
+    ssize_t written = write(loop.wake_fd, &value, sizeof(value));
+    (void)written;
+}
+
+inline void http_server::drain_completions(reactor& loop) {
+    std::vector<completion> ready;
+    {
+        std::lock_guard<std::mutex> lock(loop.completions_mutex);
+        ready.swap(loop.completions);
+    }
+    
+    for (auto& done : ready) {
+        auto it = loop.connections.find(done.fd);
+        // The descriptor may have been closed and reused while the handler ran.
+        if (it == loop.connections.end() || it->second->id != done.connection_id) {
+            continue;
+        }
+        http_connection& conn = *it->second;
+        if (done.frame && !done.upgrade) {
+            if (conn.is_websocket() && !conn.close_sent && !conn.closing) {
+                queue_frame(loop, conn, std::move(done.frame));
+            }
+            continue;
+        }
+        conn.in_flight = false;
+        if (conn.abandoned) {
+            close_connection(loop, done.fd);
+            continue;
+        }
+        
+        release_request(conn);
+        if (done.upgrade) {
+            begin_websocket(loop, conn, done);
+            continue;
+        }
+        conn.begin_response(std::move(done.response), !conn.close_after_write);
+        if (conn.read_pending) {
+            conn.read_pending = false;
+            read_from(loop, conn);
+            auto still_open = loop.connections.find(done.fd);
+            if (still_open == loop.connections.end() || still_open->second->id != done.connection_id ||
+                still_open->second->closing) {
+                continue;
+            }
+        }
+        flush(loop, conn);
+    }
+}
+
+inline bool http_server::is_open(reactor& loop, int fd, uint64_t connection_id) {
+    auto it = loop.connections.find(fd);
+    return it != loop.connections.end() && it->second->id == connection_id && !it->second->closing;
+}
+
+// The 101 reply is the first thing queued, so it precedes any frame; bytes
+// the client sent right after the upgrade request are parsed as frames.
+inline void http_server::begin_websocket(reactor& loop, http_connection& conn, completion& done) {
+    int fd = conn.fd;
+    uint64_t connection_id = conn.id;
+    conn.endpoint = done.upgrade;
+    conn.channel = done.channel;
+    conn.close_after_write = false;
+    conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+    set_deadline(loop, conn, http_connection::ping_deadline,
+                 conn.last_activity_ms + config.websocket_ping_interval_ms);
+    metrics.websockets_open++;
+    if (channels.subscribe(conn.channel, {loop.index, fd, connection_id})) {
+        notify_presence(*conn.endpoint, conn.channel, true);
+    }
+    if (!queue_frame(loop, conn, std::move(done.frame))) {
+        return;
+    }
+    if (conn.read_pending) {
+        conn.read_pending = false;
+        read_from(loop, conn);
+    } else {
+        process_input(loop, conn);
     }
 }
 
+inline void http_server::process_frames(reactor& loop, http_connection& conn) {
+    int fd = conn.fd;
+    uint64_t connection_id = conn.id;
+    conn.ping_sent_ms = 0;
+    while (!conn.close_sent) {
+        websocket::frame frame;
+        websocket::parse_status status = websocket::parse_frame(conn.in_buffer.data() + conn.in_start,
+                                                                conn.buffered_input(),
+                                                                config.max_body_bytes - conn.message.size(), frame);
+        if (status == websocket::need_more) {
+            if (conn.peer_closed) {
+                close_connection(loop, fd);
+            }
+            return;
+        }
+        if (status == websocket::failed) {
+            fail_websocket(loop, conn, frame.error_code);
+            return;
+        }
+        conn.in_start += frame.consumed;
+        if (conn.in_start == conn.in_buffer.size()) {
+            conn.in_buffer.clear();
+            conn.in_start = 0;
+        }
+        handle_frame(loop, conn, frame);
+        if (!is_open(loop, fd, connection_id)) {
+            return;
+        }
+    }
+}
+
+// Control frames are answered right here on the reactor. A finished data
+// message goes to a worker; if none can take it the client is told to come
+// back later (1013) rather than have the message silently dropped.
+inline void http_server::handle_frame(reactor& loop, http_connection& conn, websocket::frame& frame) {
+    switch (frame.opcode) {
+    case websocket::ping_frame:
+        queue_frame(loop, conn, std::make_shared<const std::string>(
+                                    websocket::encode_frame(websocket::pong_frame, frame.payload)));
+        return;
+    case websocket::pong_frame:
+        return;
+    case websocket::close_frame:
+        conn.close_sent = true;
+        queue_frame(loop, conn, std::make_shared<const std::string>(
+                                    websocket::encode_close(websocket::close_status(frame.payload))));
+        return;
+    default:
+        break;
+    }
+    
+    bool continuation = frame.opcode == websocket::continuation_frame;
+    if (continuation != (conn.message_opcode != 0)) {
+        fail_websocket(loop, conn, websocket::close_protocol_error);
+        return;
+    }
+    if (!continuation) {
+        conn.message_opcode = frame.opcode;
+    }
+    conn.message += frame.payload;
+    if (!frame.fin) {
+        return;
+    }
+    std::string message;
+    message.swap(conn.message);
+    conn.message_opcode = 0;
+    metrics.websocket_messages_in++;
+    if (!conn.endpoint->on_message) {
+        return;
+    }
+    
+    const websocket_endpoint* endpoint = conn.endpoint;
+    uint64_t channel = conn.channel;
+    bool admitted = workers->try_submit([endpoint, channel, message = std::move(message)]() {
+        try {
+            endpoint->on_message(channel, message);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: WebSocket handler for channel " << channel << " threw: " << e.what() << std::endl;
+        }
+    });
+    if (!admitted) {
+        metrics.requests_rejected++;
+        fail_websocket(loop, conn, websocket::close_try_again);
+    }
+}
+
+// Appends a frame and starts writing if nothing else is in progress. A
+// client that lets more than the backlog limit pile up is disconnected
+// instead of buffering without bound. Returns false if the connection closed.
+inline bool http_server::queue_frame(reactor& loop, http_connection& conn, std::shared_ptr<const std::string> frame) {
+    if (conn.frames_out_bytes + frame->size() > config.websocket_max_backlog_bytes) {
+        close_connection(loop, conn.fd);
+        return false;
+    }
+    bool idle = conn.frames_out.empty();
+    conn.frames_out_bytes += frame->size();
+    conn.frames_out.push_back(std::move(frame));
+    metrics.websocket_frames_out++;
+    if (!idle) {
+        return true;
+    }
+    return send_frames(loop, conn);
+}
+
+// Writes queued frames, several per sendmsg, until the socket pushes back;
+// EPOLLOUT resumes the rest. Once a close frame has gone out the connection
+// is closed. Returns false if the connection was closed.
+inline bool http_server::send_frames(reactor& loop, http_connection& conn) {
+    if (loop.ring) {
+        uring_send_frames(loop, conn);
+        return true;
+    }
+    while (!conn.frames_out.empty()) {
+        struct iovec parts[http_connection::max_frame_batch];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = parts;
+        message.msg_iovlen = conn.gather_frames(parts);
+        ssize_t sent = sendmsg(conn.fd, &message, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn.frames_written(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        close_connection(loop, conn.fd);
+        return false;
+    }
+    if (conn.close_sent) {
+        close_connection(loop, conn.fd);
+        return false;
+    }
+    return true;
+}
+
+inline void http_server::fail_websocket(reactor& loop, http_connection& conn, uint16_t status) {
+    conn.close_sent = true;
+    queue_frame(loop, conn, std::make_shared<const std::string>(websocket::encode_close(status)));
+}
+
+inline void http_server::leave_channel(reactor& loop, http_connection& conn, bool notify) {
+    if (!conn.is_websocket() || conn.channel == 0) {
+        return;
+    }
+    if (channels.unsubscribe(conn.channel, {loop.index, conn.fd, conn.id}) && notify) {
+        notify_presence(*conn.endpoint, conn.channel, false);
+    }
+    conn.channel = 0;
+    metrics.websockets_open--;
+}
+
+// Presence is advisory, so it is dropped rather than queued when the
+// workers are saturated.
+inline void http_server::notify_presence(const websocket_endpoint& endpoint, uint64_t channel, bool online) {
+    if (!endpoint.on_presence || !workers) {
+        return;
+    }
+    const websocket_endpoint* target = &endpoint;
+    workers->try_submit([target, channel, online]() {
+        try {
+            target->on_presence(channel, online);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: presence handler for channel " << channel << " threw: " << e.what() << std::endl;
+        }
+    });
+}
+
+// Writes as much of the current response as the socket accepts. Head,
+// headers and any in-memory body leave in one sendmsg (writev semantics plus
+// MSG_NOSIGNAL); a file body follows through sendfile. After a partial write
+// the next call resumes from out_sent. Returns true once everything is sent;
+// false if the rest waits for EPOLLOUT or the connection was closed on error.
+// On io_uring the write is only queued and finish_write() runs on completion.
+inline bool http_server::send_pending(reactor& loop, http_connection& conn) {
+    if (loop.ring) {
+        if (conn.deadline != http_connection::write_deadline) {
+            conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+            set_deadline(loop, conn, http_connection::write_deadline, conn.last_activity_ms + config.write_timeout_ms);
+        }
+        uring_send(loop, conn);
+        return false;
+    }
+    const http_response& response = conn.out_response;
+    uint64_t memory_size = response.memory_size();
+    while (conn.has_pending_output()) {
+        ssize_t sent;
+        if (conn.out_sent < memory_size) {
+            struct iovec parts[http_response::max_parts];
+            struct msghdr message;
+            memset(&message, 0, sizeof(message));
+            message.msg_iov = parts;
+            message.msg_iovlen = response.gather(parts, conn.out_sent);
+            int flags = MSG_NOSIGNAL | (response.file_source() ? MSG_MORE : 0);
+            sent = sendmsg(conn.fd, &message, flags);
+        } else {
+            off_t offset = static_cast<off_t>(response.file_start() + (conn.out_sent - memory_size));
+            sent = sendfile(conn.fd, response.file_source()->fd, &offset, conn.out_total - conn.out_sent);
+            if (sent == 0) {
+                // The file shrank under us; the promised length can't be met.
+                close_connection(loop, conn.fd);
+                return false;
+            }
+        }
+        if (sent > 0) {
+            conn.out_sent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // EPOLLOUT is already armed; the next edge resumes the write.
+            // Progress pushes the write deadline back when it fires.
+            conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+            if (conn.deadline != http_connection::write_deadline) {
+                set_deadline(loop, conn, http_connection::write_deadline,
+                             conn.last_activity_ms + config.write_timeout_ms);
+            }
+            return false;
+        }
+        close_connection(loop, conn.fd);
+        return false;
+    }
+    
+    conn.clear_output();
+    return true;
+}
+
+inline void http_server::flush(reactor& loop, http_connection& conn) {
+    if (send_pending(loop, conn)) {
+        finish_write(loop, conn);
+    }
+}
+
+inline void http_server::finish_write(reactor& loop, http_connection& conn) {
+    if (conn.close_after_write) {
+        close_connection(loop, conn.fd);
+        return;
+    }
+    
+    // Pipelined requests may already be buffered; answer them in order.
+    conn.last_activity_ms = time_utils::get_current_timestamp_ms();
+    process_input(loop, conn);
+}
+
+inline void http_server::close_connection(reactor& loop, int fd) {
+    auto it = loop.connections.find(fd);
+    if (it == loop.connections.end()) {
+        return;
+    }
+    http_connection& conn = *it->second;
+    leave_channel(loop, conn, true);
+    set_deadline(loop, conn, http_connection::no_deadline, 0);
+    if (!loop.ring) {
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    } else if (!conn.closing) {
+        conn.closing = true;
+        loop.ring->prep_cancel_slot(fd, uring_tag(op_cancel));
+    }
+    
+    // A worker still holds views into this connection's buffer, so keep the
+    // object (and the descriptor, which stops it being reused) until the
+    // handler completes.
+    if (conn.in_flight) {
+        conn.abandoned = true;
+        return;
+    }
+    if (loop.ring) {
+        // The kernel still points at this object; each cancelled operation
+        // completes and calls back in.
+        if (conn.ops_pending > 0) {
+            return;
+        }
+        release_file_buffer(loop, conn);
+        loop.ring->prep_close_slot(fd, uring_tag(op_close));
+    } else {
+        close(fd);
+    }
+    loop.connections.erase(it);
+    metrics.connections_open--;
+}
+
+// Each connection has at most one timer, for whatever it is waiting on.
+// Replacing it is a cancel and a schedule on the wheel, both O(1).
+inline void http_server::set_deadline(reactor& loop, http_connection& conn, http_connection::deadline_kind kind,
+                                      uint64_t deadline_ms) {
+    loop.timers.cancel(conn.timer);
+    conn.timer = 0;
+    conn.deadline = kind;
+    if (kind != http_connection::no_deadline) {
+        conn.timer = loop.timers.schedule(deadline_ms, timer_target(conn.fd, conn.id));
+    }
+}
+
+// A request still arriving keeps the deadline of the phase it is in: more
+// bytes trickling in never extend it, which is what stops slowloris-style
+// clients from holding a connection open. A new phase starts a new clock.
+inline void http_server::await_request(reactor& loop, http_connection& conn) {
+    http_connection::deadline_kind kind;
+    uint64_t timeout_ms;
+    if (conn.parser.reading_body()) {
+        kind = http_connection::body_deadline;
+        timeout_ms = config.body_timeout_ms;
+    } else if (conn.buffered_input() > 0 || conn.requests_served == 0) {
+        kind = http_connection::header_deadline;
+        timeout_ms = config.header_timeout_ms;
+    } else {
+        kind = http_connection::idle_deadline;
+        timeout_ms = config.keep_alive_timeout_ms;
+    }
+    if (conn.deadline != kind) {
+        set_deadline(loop, conn, kind, time_utils::get_current_timestamp_ms() + timeout_ms);
+    }
+}
+
+inline void http_server::expire_timers(reactor& loop) {
+    uint64_t now_ms = time_utils::get_current_timestamp_ms();
+    loop.timers.advance(now_ms, [this, &loop, now_ms](const timer_target& target) {
+        auto it = loop.connections.find(target.first);
+        if (it == loop.connections.end() || it->second->id != target.second || it->second->closing) {
+            return;
+        }
+        it->second->timer = 0;
+        handle_deadline(loop, *it->second, now_ms);
+    });
+}
+
+// Write and WebSocket deadlines are pushed back lazily: progress only
+// updates last_activity_ms, and the timer re-arms itself when it fires
+// early. A quiet WebSocket is pinged and closed only if nothing (not even
+// the pong) arrives within an interval of the ping.
+inline void http_server::handle_deadline(reactor& loop, http_connection& conn, uint64_t now_ms) {
+    switch (conn.deadline) {
+    case http_connection::header_deadline:
+    case http_connection::body_deadline:
+        metrics.connections_timed_out++;
+        conn.deadline = http_connection::no_deadline;
+        conn.close_after_write = true;
+        conn.begin_response(http_response(408, "{\"error\":\"Request Timeout\"}"), false);
+        flush(loop, conn);
+        return;
+    case http_connection::idle_deadline:
+        close_connection(loop, conn.fd);
+        return;
+    case http_connection::write_deadline:
+        if (now_ms - conn.last_activity_ms < config.write_timeout_ms) {
+            set_deadline(loop, conn, http_connection::write_deadline, conn.last_activity_ms + config.write_timeout_ms);
+            return;
+        }
+        metrics.connections_timed_out++;
+        close_connection(loop, conn.fd);
+        return;
+    case http_connection::ping_deadline:
+        break;
+    default:
+        return;
+    }
+    
+    static const std::shared_ptr<const std::string> ping =
+        std::make_shared<const std::string>(websocket::encode_frame(websocket::ping_frame, std::string_view()));
+    uint64_t since_ms = conn.ping_sent_ms ? conn.ping_sent_ms : conn.last_activity_ms;
+    if (now_ms - since_ms < config.websocket_ping_interval_ms) {
+        set_deadline(loop, conn, http_connection::ping_deadline, since_ms + config.websocket_ping_interval_ms);
+        return;
+    }
+    if (conn.ping_sent_ms || conn.close_sent) {
+        metrics.connections_timed_out++;
+        close_connection(loop, conn.fd);
+        return;
+    }
+    conn.ping_sent_ms = now_ms;
+    set_deadline(loop, conn, http_connection::ping_deadline, now_ms + config.websocket_ping_interval_ms);
+    queue_frame(loop, conn, ping);
+}
+
+inline void http_server::shutdown_loop(reactor& loop) {
+    loop.completions.clear();
+    metrics.connections_open -= loop.connections.size();
+    for (auto& entry : loop.connections) {
+        leave_channel(loop, *entry.second, false);
+    }
+    if (loop.ring) {
+        // Tearing the ring down closes every socket in its fixed-file table.
+        loop.ring.reset();
+    } else {
+        for (auto& entry : loop.connections) {
+            close(entry.first);
+        }
+    }
+    loop.connections.clear();
+    loop.file_buffer_waiters.clear();
+    if (loop.listen_fd >= 0) {
+        close(loop.listen_fd);
+        loop.listen_fd = -1;
+    }
+    if (loop.wake_fd >= 0) {
+        close(loop.wake_fd);
+        loop.wake_fd = -1;
+    }
+    if (loop.epoll_fd >= 0) {
+        close(loop.epoll_fd);
+        loop.epoll_fd = -1;
+    }
+}
+
+// Safe from any thread, but not from a signal handler since it takes
+// reactors_mutex; main calls it from a sigwait() instead. Each loop notices
+// the flag on its next wakeup, which the eventfd write forces.
 inline void http_server::stop() {
     running = false;
-    if (server_socket >= 0) {
-        close(server_socket);
-        server_socket = -1;
+    std::lock_guard<std::mutex> lock(reactors_mutex);
+    for (auto& loop : reactors) {
+        if (loop->wake_fd >= 0) {
+            uint64_t value = 1;
+            ssize_t written = write(loop->wake_fd, &value, sizeof(value));
+            (void)written;
+        }
     }
 }
 
@@ -219,4 +1842,17 @@ inline bool http_server::is_running() const {
     return running;
 }
 
+inline std::string http_server::metrics_json() {
+    metrics.queue_depth = workers ? workers->queue_depth() : 0;
+    std::string json = metrics.to_json();
+    for (const auto& source : metrics_sources) {
+        json.insert(json.size() - 1, ",\"" + source.first + "\":" + source.second());
+    }
+    return json;
+}
+
+inline void http_server::add_metrics_source(const std::string& name, std::function<std::string()> source) {
+    metrics_sources.emplace_back(name, std::move(source));
+}
+
 #endif
@@ -0,0 +1,489 @@
+#ifndef IO_URING_ENGINE_HPP
+#define IO_URING_ENGINE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing dependency).
+// One engine belongs to one reactor thread; nothing here is thread-safe.
+//
+// Besides the rings it owns three registered resources:
+//   - a sparse fixed-file table that accept fills directly, so client
+//     sockets never occupy a normal descriptor;
+//   - a provided-buffer group that recv picks from only when data actually
+//     arrives, so idle connections pin no memory. Buffers are handed back
+//     with IORING_OP_PROVIDE_BUFFERS rather than a mapped buffer ring, which
+//     some kernels accept at registration but never consume;
+//   - a pool of registered buffers for READ_FIXED file reads.
+class io_uring_engine {
+private:
+    static const uint16_t recv_group = 0;
+    // Housekeeping entries (buffer returns) carry this tag; drain() skips them.
+    static const uint64_t internal_tag = 0;
+
+    int ring_fd;
+    unsigned sq_entries;
+    void* sq_ring;
+    void* cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    unsigned local_tail;
+    unsigned submitted_tail;
+
+    char* recv_memory;
+    size_t recv_size;
+
+    char* fixed_memory;
+    unsigned fixed_count;
+    size_t fixed_size;
+    std::vector<int> free_fixed;
+
+    // Completions moved off a full completion ring by get_sqe(); drain()
+    // hands them out before reading the ring.
+    std::vector<struct io_uring_cqe> parked;
+
+    static int sys_setup(unsigned entries, struct io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+    static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+    static int sys_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+
+    bool map_rings(const struct io_uring_params& params);
+    bool register_files(unsigned max_files);
+    bool register_recv_buffers(unsigned count, size_t size);
+    bool register_fixed_buffers(unsigned count, size_t size);
+    bool probe_ops();
+    void release();
+    void park_completions();
+
+public:
+    io_uring_engine();
+    ~io_uring_engine();
+
+    io_uring_engine(const io_uring_engine&) = delete;
+    io_uring_engine& operator=(const io_uring_engine&) = delete;
+
+    bool init(unsigned entries, unsigned max_files, unsigned recv_buffers, size_t recv_buffer_size,
+              unsigned fixed_buffers, size_t fixed_buffer_size);
+
+    struct io_uring_sqe* get_sqe();
+    int submit(unsigned wait_for = 0);
+
+    // Calls handler(const io_uring_cqe&) for each ready completion.
+    template<typename Handler>
+    unsigned drain(Handler handler);
+
+    void prep_accept(int listen_fd, struct sockaddr* addr, socklen_t* addr_length, uint64_t user_data);
+    void prep_recv(int slot, uint64_t user_data);
+    void prep_sendmsg(int slot, const struct msghdr* message, int flags, uint64_t user_data);
+    void prep_send(int slot, const char* data, size_t length, uint64_t user_data);
+    void prep_read_fixed(int fd, int buffer_index, size_t length, uint64_t offset, uint64_t user_data);
+    void prep_read(int fd, void* buffer, size_t length, uint64_t user_data);
+    void prep_poll(int fd, uint64_t user_data);
+    void prep_timeout(const struct __kernel_timespec* timeout, uint64_t user_data);
+    void prep_cancel_slot(int slot, uint64_t user_data);
+    void prep_close_slot(int slot, uint64_t user_data);
+
+    const char* recv_buffer(uint16_t buffer_id) const { return recv_memory + buffer_id * recv_size; }
+    void recycle_recv_buffer(uint16_t buffer_id);
+
+    int acquire_fixed_buffer();
+    void release_fixed_buffer(int index) { free_fixed.push_back(index); }
+    char* fixed_buffer(int index) const { return fixed_memory + index * fixed_size; }
+    size_t fixed_buffer_size() const { return fixed_size; }
+};
+
+inline io_uring_engine::io_uring_engine()
+    : ring_fd(-1), sq_entries(0), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sq_ring_size(0), cq_ring_size(0),
+      sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)), sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr),
+      sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr), cqes(nullptr), local_tail(0),
+      submitted_tail(0), recv_memory(nullptr), recv_size(0),
+      fixed_memory(nullptr), fixed_count(0), fixed_size(0) {}
+
+inline io_uring_engine::~io_uring_engine() {
+    release();
+}
+
+inline void io_uring_engine::release() {
+    // Closing the ring fd also closes every socket in the fixed-file table.
+    if (ring_fd >= 0) {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+    if (sqes != MAP_FAILED) munmap(sqes, sq_entries * sizeof(struct io_uring_sqe));
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+    sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    sq_ring = cq_ring = MAP_FAILED;
+    free(recv_memory);
+    free(fixed_memory);
+    recv_memory = nullptr;
+    fixed_memory = nullptr;
+}
+
+inline bool io_uring_engine::map_rings(const struct io_uring_params& params) {
+    sq_entries = params.sq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) return false;
+    cq_ring = single_mmap ? sq_ring
+                          : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) return false;
+    sqes = static_cast<struct io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(struct io_uring_sqe),
+                                                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                  ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) return false;
+
+    char* sq = static_cast<char*>(sq_ring);
+    char* cq = static_cast<char*>(cq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    local_tail = submitted_tail = *sq_tail;
+    return true;
+}
+
+// Every opcode the server issues must be known to the running kernel.
+inline bool io_uring_engine::probe_ops() {
+    const unsigned op_slots = 256;
+    size_t bytes = sizeof(struct io_uring_probe) + op_slots * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = static_cast<struct io_uring_probe*>(calloc(1, bytes));
+    if (!probe) return false;
+    bool supported = sys_register(ring_fd, IORING_REGISTER_PROBE, probe, op_slots) == 0;
+    const int required[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_PROVIDE_BUFFERS, IORING_OP_SEND, IORING_OP_SENDMSG,
+                            IORING_OP_READ_FIXED, IORING_OP_READ, IORING_OP_POLL_ADD, IORING_OP_TIMEOUT,
+                            IORING_OP_ASYNC_CANCEL, IORING_OP_CLOSE};
+    for (int op : required) {
+        if (!supported || op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            supported = false;
+        }
+    }
+    free(probe);
+    return supported;
+}
+
+inline bool io_uring_engine::register_files(unsigned max_files) {
+    struct io_uring_rsrc_register files;
+    memset(&files, 0, sizeof(files));
+    files.nr = max_files;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    return sys_register(ring_fd, IORING_REGISTER_FILES2, &files, sizeof(files)) == 0;
+}
+
+inline bool io_uring_engine::register_recv_buffers(unsigned count, size_t size) {
+    recv_size = size;
+    recv_memory = static_cast<char*>(malloc(count * size));
+    if (!recv_memory) return false;
+
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(recv_memory);
+    sqe->len = static_cast<uint32_t>(size);
+    sqe->buf_group = recv_group;
+    sqe->user_data = internal_tag;
+    if (submit(1) != 1) return false;
+    struct io_uring_cqe cqe = cqes[*cq_head & *cq_mask];
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+    if (cqe.res < 0) {
+        errno = -cqe.res;
+        return false;
+    }
+    return true;
+}
+
+inline bool io_uring_engine::register_fixed_buffers(unsigned count, size_t size) {
+    fixed_count = count;
+    fixed_size = size;
+    if (posix_memalign(reinterpret_cast<void**>(&fixed_memory), 4096, count * size) != 0) {
+        fixed_memory = nullptr;
+        return false;
+    }
+    std::vector<struct iovec> buffers(count);
+    for (unsigned i = 0; i < count; i++) {
+        buffers[i].iov_base = fixed_memory + i * size;
+        buffers[i].iov_len = size;
+        free_fixed.push_back(static_cast<int>(i));
+    }
+    return sys_register(ring_fd, IORING_REGISTER_BUFFERS, buffers.data(), count) == 0;
+}
+
+// Returns false (with the reason on stderr) when the kernel is too old or
+// io_uring is disabled; the caller then stays on epoll.
+inline bool io_uring_engine::init(unsigned entries, unsigned max_files, unsigned recv_buffers, size_t recv_buffer_size,
+                                  unsigned fixed_buffers, size_t fixed_buffer_size) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    ring_fd = sys_setup(entries, &params);
+    if (ring_fd < 0) {
+        std::cerr << "io_uring unavailable: setup failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    const char* failure = nullptr;
+    if (!(params.features & IORING_FEAT_NODROP) || !probe_ops()) {
+        failure = "kernel lacks required operations";
+    } else if (!map_rings(params)) {
+        failure = "could not map rings";
+    } else if (!register_files(max_files)) {
+        failure = "could not register the fixed-file table";
+    } else if (!register_recv_buffers(recv_buffers, recv_buffer_size)) {
+        failure = "could not provide recv buffers";
+    } else if (!register_fixed_buffers(fixed_buffers, fixed_buffer_size)) {
+        failure = "could not register file buffers";
+    }
+    if (failure) {
+        std::cerr << "io_uring unavailable: " << failure << ": " << strerror(errno) << std::endl;
+        release();
+        return false;
+    }
+    return true;
+}
+
+// Submits queued entries when the ring is full so callers always get a slot.
+// The kernel refuses while completions are backed up, and nothing else reaps
+// them here, so they are parked to make room before trying again.
+inline struct io_uring_sqe* io_uring_engine::get_sqe() {
+    while (local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        int result = submit();
+        if (result == -EBUSY || result == -EAGAIN) {
+            park_completions();
+        } else if (result < 0) {
+            std::cerr << "Error: io_uring_enter failed with a full ring: " << strerror(-result) << std::endl;
+            abort();
+        }
+    }
+    unsigned index = local_tail & *sq_mask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    local_tail++;
+    return sqe;
+}
+
+inline void io_uring_engine::park_completions() {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe& cqe = cqes[head & *cq_mask];
+        if (cqe.user_data != internal_tag) {
+            parked.push_back(cqe);
+        }
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Never sleeps while parked completions are waiting to be drained.
+inline int io_uring_engine::submit(unsigned wait_for) {
+    if (!parked.empty()) {
+        wait_for = 0;
+    }
+    __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = local_tail - submitted_tail;
+    while (true) {
+        int result = sys_enter(ring_fd, to_submit, wait_for, wait_for ? IORING_ENTER_GETEVENTS : 0);
+        if (result >= 0) {
+            submitted_tail += result;
+            return result;
+        }
+        if (errno == EINTR) {
+            if (wait_for) return 0;
+            continue;
+        }
+        // EBUSY/EAGAIN: completions must be reaped first; the caller drains
+        // and submits again.
+        return -errno;
+    }
+}
+
+// The head is re-read each pass: a handler that fills the submission ring
+// may park completions and move it.
+template<typename Handler>
+unsigned io_uring_engine::drain(Handler handler) {
+    unsigned handled = 0;
+    while (true) {
+        if (!parked.empty()) {
+            std::vector<struct io_uring_cqe> ready;
+            ready.swap(parked);
+            for (const auto& cqe : ready) {
+                handler(cqe);
+                handled++;
+            }
+            continue;
+        }
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        struct io_uring_cqe cqe = cqes[head & *cq_mask];
+        // Publish before the handler runs; it may queue work that completes
+        // into the slot just freed.
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        if (cqe.user_data == internal_tag) {
+            continue;
+        }
+        handler(cqe);
+        handled++;
+    }
+    return handled;
+}
+
+// Single-shot: a multishot accept shares one address buffer across all its
+// completions, so the peer address could be overwritten before it is read.
+inline void io_uring_engine::prep_accept(int listen_fd, struct sockaddr* addr, socklen_t* addr_length,
+                                         uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(addr);
+    sqe->addr2 = reinterpret_cast<uint64_t>(addr_length);
+    // Direct descriptors live only in the ring, so SOCK_CLOEXEC is rejected.
+    sqe->file_index = IORING_FILE_INDEX_ALLOC;
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_recv(int slot, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->buf_group = recv_group;
+    sqe->len = static_cast<uint32_t>(recv_size);
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_sendmsg(int slot, const struct msghdr* message, int flags, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = reinterpret_cast<uint64_t>(message);
+    sqe->len = 1;
+    sqe->msg_flags = static_cast<uint32_t>(flags);
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_send(int slot, const char* data, size_t length, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = slot;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_read_fixed(int fd, int buffer_index, size_t length, uint64_t offset,
+                                             uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(fixed_buffer(buffer_index));
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(buffer_index);
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_read(int fd, void* buffer, size_t length, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_poll(int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_timeout(const struct __kernel_timespec* timeout, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(timeout);
+    sqe->len = 1;
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_cancel_slot(int slot, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = slot;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_FD_FIXED | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::prep_close_slot(int slot, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = static_cast<uint32_t>(slot) + 1;
+    sqe->user_data = user_data;
+}
+
+inline void io_uring_engine::recycle_recv_buffer(uint16_t buffer_id) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = reinterpret_cast<uint64_t>(recv_memory + buffer_id * recv_size);
+    sqe->len = static_cast<uint32_t>(recv_size);
+    sqe->off = buffer_id;
+    sqe->buf_group = recv_group;
+    sqe->user_data = internal_tag;
+}
+
+inline int io_uring_engine::acquire_fixed_buffer() {
+    if (free_fixed.empty()) {
+        return -1;
+    }
+    int index = free_fixed.back();
+    free_fixed.pop_back();
+    return index;
+}
+
+#endif
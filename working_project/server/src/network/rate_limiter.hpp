@@ -0,0 +1,169 @@
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+#include "../utils/time_utils.hpp"
+
+// Token bucket: refills at per_second up to burst. A zero rate means no
+// limit.
+struct rate_limit {
+    double per_second;
+    double burst;
+
+    rate_limit(double rate = 0, double burst_size = 0) : per_second(rate), burst(burst_size) {}
+    bool enabled() const { return per_second > 0 && burst >= 1; }
+};
+
+// Limits for one route, applied separately to each client address and to
+// each bearer token. A request must pass both.
+struct route_limits {
+    rate_limit per_address;
+    rate_limit per_token;
+};
+
+// Buckets keyed by a 64-bit hash of (route, client), spread over mutex
+// shards so reactors checking different clients rarely contend. A bucket
+// idle long enough to have refilled is indistinguishable from a new one, so
+// the eviction thread drops those without changing any outcome.
+class rate_limiter {
+private:
+    static const size_t shard_count = 32;
+
+    struct bucket {
+        double tokens;
+        uint64_t updated_ms;
+        // When the bucket will be full again; past this it can be evicted.
+        uint64_t full_ms;
+    };
+
+    struct shard {
+        std::mutex lock;
+        std::unordered_map<uint64_t, bucket> buckets;
+    };
+
+    shard shards[shard_count];
+    std::mutex thread_lock;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread eviction_thread;
+
+    void eviction_loop(uint64_t interval_ms);
+
+public:
+    rate_limiter() : stopping(false) {}
+    ~rate_limiter() { stop(); }
+
+    // Takes one token from key's bucket. On refusal, retry_after_ms says
+    // when the next token will be available.
+    bool allow(uint64_t key, const rate_limit& limit, uint64_t now_ms, uint64_t& retry_after_ms);
+    size_t evict_full(uint64_t now_ms);
+    size_t bucket_count();
+
+    void start(uint64_t interval_ms);
+    void stop();
+
+    static uint64_t make_key(uint64_t scope, uint64_t client) {
+        uint64_t key = client ^ (scope * 0x9E3779B97F4A7C15ull);
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return key;
+    }
+};
+
+inline bool rate_limiter::allow(uint64_t key, const rate_limit& limit, uint64_t now_ms, uint64_t& retry_after_ms) {
+    shard& target = shards[key % shard_count];
+    std::lock_guard<std::mutex> lock(target.lock);
+    auto inserted = target.buckets.emplace(key, bucket{limit.burst, now_ms, now_ms});
+    bucket& entry = inserted.first->second;
+    if (!inserted.second && now_ms > entry.updated_ms) {
+        entry.tokens += (now_ms - entry.updated_ms) * limit.per_second / 1000.0;
+        if (entry.tokens > limit.burst) {
+            entry.tokens = limit.burst;
+        }
+    }
+    entry.updated_ms = std::max(entry.updated_ms, now_ms);
+    bool allowed = entry.tokens >= 1;
+    if (allowed) {
+        entry.tokens -= 1;
+        retry_after_ms = 0;
+    } else {
+        retry_after_ms = static_cast<uint64_t>((1 - entry.tokens) * 1000.0 / limit.per_second) + 1;
+    }
+    entry.full_ms = entry.updated_ms + static_cast<uint64_t>((limit.burst - entry.tokens) * 1000.0 / limit.per_second);
+    return allowed;
+}
+
+// One shard at a time, so a request never waits on more than a single
+// shard's scan.
+inline size_t rate_limiter::evict_full(uint64_t now_ms) {
+    size_t evicted = 0;
+    for (shard& each : shards) {
+        std::lock_guard<std::mutex> lock(each.lock);
+        for (auto it = each.buckets.begin(); it != each.buckets.end();) {
+            if (it->second.full_ms <= now_ms) {
+                it = each.buckets.erase(it);
+                evicted++;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return evicted;
+}
+
+inline size_t rate_limiter::bucket_count() {
+    size_t total = 0;
+    for (shard& each : shards) {
+        std::lock_guard<std::mutex> lock(each.lock);
+        total += each.buckets.size();
+    }
+    return total;
+}
+
+inline void rate_limiter::start(uint64_t interval_ms) {
+    std::lock_guard<std::mutex> lock(thread_lock);
+    if (eviction_thread.joinable()) {
+        return;
+    }
+    stopping = false;
+    eviction_thread = std::thread(&rate_limiter::eviction_loop, this, interval_ms);
+}
+
+// The thread is taken out under the lock, so when two threads stop at once
+// only one of them joins it and the other returns straight away.
+inline void rate_limiter::stop() {
+    std::thread stopped;
+    {
+        std::lock_guard<std::mutex> lock(thread_lock);
+        if (!eviction_thread.joinable()) {
+            return;
+        }
+        stopping = true;
+        stopped = std::move(eviction_thread);
+    }
+    wake.notify_all();
+    stopped.join();
+}
+
+inline void rate_limiter::eviction_loop(uint64_t interval_ms) {
+    std::unique_lock<std::mutex> lock(thread_lock);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(interval_ms));
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+        evict_full(time_utils::get_current_timestamp_ms());
+        lock.lock();
+    }
+}
+
+#endif
@@ -2,9 +2,14 @@
 #define REQUEST_PARSER_HPP
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
 
 struct http_request {
     std::string method;
@@ -14,14 +19,544 @@ struct http_request {
     std::string body;
 };
 
+struct http_header_view {
+    std::string_view name;
+    std::string_view value;
+};
+
+// Non-owning request whose fields point into the connection's receive
+// buffer (or, for chunked bodies, the parser's decoded body). It is only
+// valid until that buffer is modified, so handlers that need the data
+// later must copy it.
+struct http_request_view {
+    static const size_t max_headers = 32;
+    static const size_t max_params = 8;
+    
+    std::string_view method;
+    std::string_view target;
+    std::string_view path;
+    std::string_view query;
+    std::string_view http_version;
+    std::string_view body;
+    http_header_view headers[max_headers];
+    size_t header_count = 0;
+    http_header_view params[max_params];
+    size_t param_count = 0;
+    
+    std::string_view header(std::string_view name) const;
+    std::string_view param(std::string_view name) const;
+    bool query_param(std::string_view name, std::string& value) const;
+    
+    static std::string url_decode(std::string_view encoded);
+};
+
+inline std::string_view http_request_view::header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; i++) {
+        if (headers[i].name.size() == name.size() &&
+            strncasecmp(headers[i].name.data(), name.data(), name.size()) == 0) {
+            return headers[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+// Path parameter bound by the router, e.g. "id" for "/users/:id".
+inline std::string_view http_request_view::param(std::string_view name) const {
+    for (size_t i = 0; i < param_count; i++) {
+        if (params[i].name == name) {
+            return params[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+inline bool http_request_view::query_param(std::string_view name, std::string& value) const {
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string_view::npos) end = query.size();
+        std::string_view pair = query.substr(pos, end - pos);
+        size_t equals = pair.find('=');
+        if (pair.substr(0, equals) == name) {
+            value = equals == std::string_view::npos ? std::string() : url_decode(pair.substr(equals + 1));
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+inline std::string http_request_view::url_decode(std::string_view encoded) {
+    auto hex_value = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    
+    std::string decoded;
+    decoded.reserve(encoded.size());
+    for (size_t i = 0; i < encoded.size(); i++) {
+        if (encoded[i] == '+') {
+            decoded += ' ';
+        } else if (encoded[i] == '%' && i + 2 < encoded.size() &&
+                   hex_value(encoded[i + 1]) >= 0 && hex_value(encoded[i + 2]) >= 0) {
+            decoded += static_cast<char>(hex_value(encoded[i + 1]) * 16 + hex_value(encoded[i + 2]));
+            i += 2;
+        } else {
+            decoded += encoded[i];
+        }
+    }
+    return decoded;
+}
+
+// A request view together with the bytes it points at, for work that
+// finishes a request on another thread after the connection's buffer has
+// moved on. Not copyable: the view points into this object.
+class http_request_copy {
+public:
+    explicit http_request_copy(const http_request_view& source);
+    http_request_copy(const http_request_copy&) = delete;
+    http_request_copy& operator=(const http_request_copy&) = delete;
+    
+    const http_request_view& view() const { return request; }
+    
+private:
+    std::string storage;
+    http_request_view request;
+};
+
+// Everything is copied into one buffer reserved up front, so the views
+// taken into it stay put. Path and query keep pointing into the target.
+inline http_request_copy::http_request_copy(const http_request_view& source) : request(source) {
+    size_t total = source.method.size() + source.target.size() + source.http_version.size() + source.body.size();
+    for (size_t i = 0; i < source.header_count; i++) {
+        total += source.headers[i].name.size() + source.headers[i].value.size();
+    }
+    for (size_t i = 0; i < source.param_count; i++) {
+        total += source.params[i].name.size() + source.params[i].value.size();
+    }
+    storage.reserve(total);
+    auto keep = [this](std::string_view part) {
+        size_t offset = storage.size();
+        storage.append(part.data(), part.size());
+        return std::string_view(storage.data() + offset, part.size());
+    };
+    auto within = [](std::string_view part, std::string_view whole, std::string_view copy) {
+        if (!part.empty() && part.data() >= whole.data() && part.data() + part.size() <= whole.data() + whole.size()) {
+            return copy.substr(part.data() - whole.data(), part.size());
+        }
+        return std::string_view();
+    };
+    
+    request.method = keep(source.method);
+    request.target = keep(source.target);
+    request.path = within(source.path, source.target, request.target);
+    request.query = within(source.query, source.target, request.target);
+    request.http_version = keep(source.http_version);
+    request.body = keep(source.body);
+    for (size_t i = 0; i < source.header_count; i++) {
+        request.headers[i].name = keep(source.headers[i].name);
+        request.headers[i].value = keep(source.headers[i].value);
+    }
+    for (size_t i = 0; i < source.param_count; i++) {
+        request.params[i].name = keep(source.params[i].name);
+        request.params[i].value = keep(source.params[i].value);
+    }
+}
+
+// Resumable HTTP/1.x request parser. feed() is handed the connection's
+// unconsumed bytes each time more arrive and continues scanning from where
+// the previous call stopped, recording offsets rather than copying. Once it
+// reports complete, consumed() bytes form one request and anything after
+// them belongs to the next pipelined request.
+//
+// With pause_at_body set, feed() also reports headers_complete once per
+// request whose body is still to come, so the caller can look at the
+// headers (and refuse the request) before any of the body is buffered.
+// Calling feed() again carries on with the body.
 class request_parser {
 public:
+    enum parse_status { need_more, headers_complete, complete, failed };
+    
+    request_parser(size_t header_limit = 16384, size_t body_limit = 1024 * 1024, bool pause_at_body = false);
+    
+    parse_status feed(const char* data, size_t size);
+    http_request_view to_view() const;
+    http_request to_request() const;
+    void reset();
+    
+    size_t consumed() const { return consumed_bytes; }
+    // True once the headers are in and the body is still arriving.
+    bool reading_body() const { return state > headers_state && state < done_state; }
+    int error_status() const { return error_code; }
+    
     static http_request parse(const std::string& raw_request);
+    static bool wants_keep_alive(const http_request_view& req);
     
 private:
+    enum parse_state {
+        request_line_state,
+        headers_state,
+        body_state,
+        chunk_size_state,
+        chunk_data_state,
+        trailers_state,
+        done_state,
+        error_state
+    };
+    
+    struct span {
+        size_t offset;
+        size_t length;
+    };
+    
+    struct header_span {
+        span name;
+        span value;
+    };
+    
+    size_t max_header_bytes;
+    size_t max_body_bytes;
+    bool pause_before_body;
+    
+    parse_state state;
+    const char* input;
+    size_t scan_pos;
+    size_t consumed_bytes;
+    int error_code;
+    
+    span method;
+    span target;
+    span version;
+    header_span header_spans[http_request_view::max_headers];
+    size_t header_count;
+    
+    bool chunked;
+    bool has_content_length;
+    size_t content_length;
+    size_t body_start;
+    size_t chunk_remaining;
+    std::string chunked_body;
+    
+    bool next_line(size_t size, size_t& line_start, size_t& line_length);
+    bool parse_request_line(size_t line_start, size_t line_length);
+    bool parse_header_line(size_t line_start, size_t line_length);
+    bool finish_headers();
+    parse_status fail(int status);
+    
+    static bool equals_ignore_case(const char* data, size_t length, const char* name);
+    static bool is_chunked_only(const char* value, size_t length);
     static std::vector<std::string> split(const std::string& str, char delimiter);
 };
 
+inline request_parser::request_parser(size_t header_limit, size_t body_limit, bool pause_at_body)
+    : max_header_bytes(header_limit), max_body_bytes(body_limit), pause_before_body(pause_at_body) {
+    reset();
+}
+
+inline void request_parser::reset() {
+    state = request_line_state;
+    input = nullptr;
+    scan_pos = 0;
+    consumed_bytes = 0;
+    error_code = 0;
+    method = {0, 0};
+    target = {0, 0};
+    version = {0, 0};
+    header_count = 0;
+    chunked = false;
+    has_content_length = false;
+    content_length = 0;
+    body_start = 0;
+    chunk_remaining = 0;
+    chunked_body.clear();
+}
+
+inline bool request_parser::equals_ignore_case(const char* data, size_t length, const char* name) {
+    size_t name_length = strlen(name);
+    return length == name_length && strncasecmp(data, name, length) == 0;
+}
+
+// True when a Transfer-Encoding list names chunked and nothing else. Empty
+// list elements are allowed; "xchunked" or "gzip, chunked" are not.
+inline bool request_parser::is_chunked_only(const char* value, size_t length) {
+    size_t codings = 0;
+    bool chunked_seen = false;
+    size_t start = 0;
+    while (start <= length) {
+        const char* comma = static_cast<const char*>(memchr(value + start, ',', length - start));
+        size_t end = comma ? comma - value : length;
+        size_t first = start;
+        size_t last = end;
+        while (first < last && (value[first] == ' ' || value[first] == '\t')) first++;
+        while (last > first && (value[last - 1] == ' ' || value[last - 1] == '\t')) last--;
+        if (last > first) {
+            codings++;
+            chunked_seen = equals_ignore_case(value + first, last - first, "chunked");
+        }
+        start = end + 1;
+    }
+    return codings == 1 && chunked_seen;
+}
+
+inline request_parser::parse_status request_parser::fail(int status) {
+    state = error_state;
+    error_code = status;
+    return failed;
+}
+
+// Finds the next line at scan_pos, accepting CRLF or a bare LF, and moves
+// scan_pos past its terminator.
+inline bool request_parser::next_line(size_t size, size_t& line_start, size_t& line_length) {
+    const void* found = memchr(input + scan_pos, '\n', size - scan_pos);
+    if (!found) {
+        return false;
+    }
+    size_t newline = static_cast<const char*>(found) - input;
+    line_start = scan_pos;
+    line_length = newline - scan_pos;
+    if (line_length > 0 && input[newline - 1] == '\r') {
+        line_length--;
+    }
+    scan_pos = newline + 1;
+    return true;
+}
+
+inline bool request_parser::parse_request_line(size_t line_start, size_t line_length) {
+    const char* line = input + line_start;
+    const char* line_end = line + line_length;
+    const char* first_space = static_cast<const char*>(memchr(line, ' ', line_length));
+    if (!first_space) return false;
+    const char* second_space = static_cast<const char*>(memchr(first_space + 1, ' ', line_end - first_space - 1));
+    if (!second_space) return false;
+    
+    method = {line_start, static_cast<size_t>(first_space - line)};
+    target = {static_cast<size_t>(first_space + 1 - input), static_cast<size_t>(second_space - first_space - 1)};
+    version = {static_cast<size_t>(second_space + 1 - input), static_cast<size_t>(line_end - second_space - 1)};
+    
+    return method.length > 0 && target.length > 0 &&
+           version.length == 8 && strncmp(input + version.offset, "HTTP/1.", 7) == 0;
+}
+
+inline bool request_parser::parse_header_line(size_t line_start, size_t line_length) {
+    const char* line = input + line_start;
+    const char* colon = static_cast<const char*>(memchr(line, ':', line_length));
+    if (!colon || colon == line) {
+        return false;
+    }
+    
+    size_t name_length = colon - line;
+    size_t value_start = name_length + 1;
+    size_t value_end = line_length;
+    while (value_start < value_end && (line[value_start] == ' ' || line[value_start] == '\t')) value_start++;
+    while (value_end > value_start && (line[value_end - 1] == ' ' || line[value_end - 1] == '\t')) value_end--;
+    
+    if (header_count == http_request_view::max_headers) {
+        return false;
+    }
+    header_span header = {{line_start, name_length}, {line_start + value_start, value_end - value_start}};
+    header_spans[header_count++] = header;
+    
+    const char* value = input + header.value.offset;
+    if (equals_ignore_case(line, name_length, "content-length")) {
+        if (header.value.length == 0 || header.value.length > 18) return false;
+        size_t length = 0;
+        for (size_t i = 0; i < header.value.length; i++) {
+            if (!std::isdigit(static_cast<unsigned char>(value[i]))) return false;
+            length = length * 10 + (value[i] - '0');
+        }
+        // Repeats must agree: a proxy that frames by the first value and a
+        // server that framed by the last would split the stream differently.
+        if (has_content_length && length != content_length) return false;
+        has_content_length = true;
+        content_length = length;
+    } else if (equals_ignore_case(line, name_length, "transfer-encoding")) {
+        // chunked is the only coding decoded here. Anything more, including a
+        // second header, would leave the body framed one way here and maybe
+        // another way by a proxy in front.
+        if (chunked || !is_chunked_only(value, header.value.length)) return false;
+        chunked = true;
+    }
+    return true;
+}
+
+inline bool request_parser::finish_headers() {
+    body_start = scan_pos;
+    if (chunked) {
+        state = chunk_size_state;
+    } else if (content_length > 0) {
+        state = body_state;
+    } else {
+        state = done_state;
+        consumed_bytes = scan_pos;
+    }
+    return true;
+}
+
+inline request_parser::parse_status request_parser::feed(const char* data, size_t size) {
+    input = data;
+    
+    while (true) {
+        size_t line_start = 0;
+        size_t line_length = 0;
+        
+        switch (state) {
+        case request_line_state:
+            if (!next_line(size, line_start, line_length)) {
+                return size > max_header_bytes ? fail(431) : need_more;
+            }
+            if (line_length == 0) {
+                continue;
+            }
+            if (!parse_request_line(line_start, line_length)) {
+                return fail(400);
+            }
+            state = headers_state;
+            break;
+            
+        case headers_state:
+            if (!next_line(size, line_start, line_length)) {
+                return size > max_header_bytes ? fail(431) : need_more;
+            }
+            if (scan_pos > max_header_bytes) {
+                return fail(431);
+            }
+            if (line_length == 0) {
+                if (chunked && has_content_length) {
+                    return fail(400);
+                }
+                if (content_length > max_body_bytes) {
+                    return fail(413);
+                }
+                finish_headers();
+                if (pause_before_body && state != done_state) {
+                    return headers_complete;
+                }
+                break;
+            }
+            if (!parse_header_line(line_start, line_length)) {
+                return fail(header_count == http_request_view::max_headers ? 431 : 400);
+            }
+            break;
+            
+        case body_state:
+            if (size - body_start < content_length) {
+                return need_more;
+            }
+            consumed_bytes = body_start + content_length;
+            state = done_state;
+            break;
+            
+        case chunk_size_state: {
+            if (!next_line(size, line_start, line_length)) {
+                return size - scan_pos > 64 ? fail(400) : need_more;
+            }
+            size_t chunk_size = 0;
+            size_t digits = 0;
+            for (size_t i = 0; i < line_length; i++) {
+                char c = input[line_start + i];
+                if (c == ';' || c == ' ') break;
+                int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                          : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                          : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if (digit < 0 || ++digits > 15) return fail(400);
+                chunk_size = chunk_size * 16 + digit;
+            }
+            if (digits == 0) {
+                return fail(400);
+            }
+            if (chunk_size == 0) {
+                state = trailers_state;
+                break;
+            }
+            if (chunked_body.size() + chunk_size > max_body_bytes) {
+                return fail(413);
+            }
+            chunk_remaining = chunk_size;
+            state = chunk_data_state;
+            break;
+        }
+            
+        case chunk_data_state:
+            if (size - scan_pos < chunk_remaining + 2) {
+                return need_more;
+            }
+            if (input[scan_pos + chunk_remaining] != '\r' || input[scan_pos + chunk_remaining + 1] != '\n') {
+                return fail(400);
+            }
+            chunked_body.append(input + scan_pos, chunk_remaining);
+            scan_pos += chunk_remaining + 2;
+            chunk_remaining = 0;
+            state = chunk_size_state;
+            break;
+            
+        case trailers_state:
+            if (!next_line(size, line_start, line_length)) {
+                return size - scan_pos > max_header_bytes ? fail(431) : need_more;
+            }
+            if (line_length == 0) {
+                consumed_bytes = scan_pos;
+                state = done_state;
+            }
+            break;
+            
+        case done_state:
+            return complete;
+            
+        case error_state:
+            return failed;
+        }
+    }
+}
+
+// Views into the buffer last passed to feed(); no bytes are copied.
+inline http_request_view request_parser::to_view() const {
+    http_request_view req;
+    req.method = std::string_view(input + method.offset, method.length);
+    req.target = std::string_view(input + target.offset, target.length);
+    req.http_version = std::string_view(input + version.offset, version.length);
+    
+    size_t query_pos = req.target.find('?');
+    req.path = req.target.substr(0, query_pos);
+    if (query_pos != std::string_view::npos) {
+        req.query = req.target.substr(query_pos + 1);
+    }
+    
+    for (size_t i = 0; i < header_count; i++) {
+        req.headers[i].name = std::string_view(input + header_spans[i].name.offset, header_spans[i].name.length);
+        req.headers[i].value = std::string_view(input + header_spans[i].value.offset, header_spans[i].value.length);
+    }
+    req.header_count = header_count;
+    
+    // Before complete (at headers_complete) the body is not there yet.
+    if (chunked) {
+        req.body = chunked_body;
+    } else if (state == done_state) {
+        req.body = std::string_view(input + body_start, content_length);
+    }
+    return req;
+}
+
+// Owning copy of the parsed request for callers that outlive the buffer.
+inline http_request request_parser::to_request() const {
+    http_request req;
+    req.method.assign(input + method.offset, method.length);
+    req.path.assign(input + target.offset, target.length);
+    req.http_version.assign(input + version.offset, version.length);
+    for (size_t i = 0; i < header_count; i++) {
+        const header_span& header = header_spans[i];
+        req.headers[std::string(input + header.name.offset, header.name.length)] =
+            std::string(input + header.value.offset, header.value.length);
+    }
+    if (chunked) {
+        req.body = chunked_body;
+    } else {
+        req.body.assign(input + body_start, content_length);
+    }
+    return req;
+}
+
 inline std::vector<std::string> request_parser::split(const std::string& str, char delimiter) {
     std::vector<std::string> result;
     std::stringstream ss(str);
@@ -32,6 +567,26 @@ inline std::vector<std::string> request_parser::split(const std::string& str, ch
     return result;
 }
 
+// HTTP/1.1 connections persist unless the client says otherwise; HTTP/1.0
+// clients have to opt in.
+inline bool request_parser::wants_keep_alive(const http_request_view& req) {
+    std::string_view connection_header = req.header("Connection");
+    auto contains_token = [&](const char* token) {
+        size_t token_length = strlen(token);
+        for (size_t i = 0; i + token_length <= connection_header.size(); i++) {
+            if (strncasecmp(connection_header.data() + i, token, token_length) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    
+    if (req.http_version == "HTTP/1.1") {
+        return !contains_token("close");
+    }
+    return contains_token("keep-alive");
+}
+
 inline http_request request_parser::parse(const std::string& raw_request) {
     http_request req;
     std::stringstream ss(raw_request);
@@ -17,10 +17,17 @@ private:
 inline std::unordered_map<int, std::string> response_builder::status_messages = {
     {200, "OK"},
     {201, "Created"},
+    {206, "Partial Content"},
+    {304, "Not Modified"},
     {400, "Bad Request"},
     {401, "Unauthorized"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {408, "Request Timeout"},
+    {413, "Payload Too Large"},
+    {416, "Range Not Satisfiable"},
+    {429, "Too Many Requests"},
+    {431, "Request Header Fields Too Large"},
     {500, "Internal Server Error"},
     {503, "Service Unavailable"}
 };
@@ -0,0 +1,194 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include "request_parser.hpp"
+
+// Segment trie per HTTP method. Routes are added during startup and the
+// table is then frozen; after that match() only reads immutable nodes, so
+// any number of threads can route concurrently without a lock.
+// Patterns may contain ":name" segments, which bind into req.params.
+template<typename Handler>
+class router {
+private:
+    enum method_index { get_method, post_method, put_method, delete_method,
+                        patch_method, head_method, options_method, method_count };
+
+    struct node {
+        std::string segment;
+        std::vector<std::unique_ptr<node>> literal_children;
+        std::unique_ptr<node> param_child;
+        std::string param_name;
+        Handler handler;
+        bool has_handler;
+
+        node() : has_handler(false) {}
+    };
+
+    node roots[method_count];
+    bool frozen;
+    size_t route_count;
+
+    static int method_to_index(std::string_view method);
+    static bool next_segment(std::string_view path, size_t& pos, std::string_view& segment);
+    const node* match_from(const node* current, std::string_view path, size_t pos,
+                           http_request_view& req) const;
+
+public:
+    router() : frozen(false), route_count(0) {}
+
+    bool add(std::string_view method, std::string_view pattern, Handler handler);
+    void freeze() { frozen = true; }
+    bool is_frozen() const { return frozen; }
+    size_t size() const { return route_count; }
+
+    const Handler* match(std::string_view method, std::string_view path, http_request_view& req) const;
+    // The handler registered for exactly this pattern, for amending it
+    // before the table is frozen.
+    Handler* find(std::string_view method, std::string_view pattern);
+};
+
+template<typename Handler>
+int router<Handler>::method_to_index(std::string_view method) {
+    if (method == "GET") return get_method;
+    if (method == "POST") return post_method;
+    if (method == "PUT") return put_method;
+    if (method == "DELETE") return delete_method;
+    if (method == "PATCH") return patch_method;
+    if (method == "HEAD") return head_method;
+    if (method == "OPTIONS") return options_method;
+    return -1;
+}
+
+// Yields the next non-empty '/'-separated segment, so "/a//b/" and "/a/b"
+// route identically.
+template<typename Handler>
+bool router<Handler>::next_segment(std::string_view path, size_t& pos, std::string_view& segment) {
+    while (pos < path.size() && path[pos] == '/') pos++;
+    if (pos >= path.size()) {
+        return false;
+    }
+    size_t end = path.find('/', pos);
+    if (end == std::string_view::npos) end = path.size();
+    segment = path.substr(pos, end - pos);
+    pos = end;
+    return true;
+}
+
+template<typename Handler>
+bool router<Handler>::add(std::string_view method, std::string_view pattern, Handler handler) {
+    int index = method_to_index(method);
+    if (frozen || index < 0) {
+        std::cerr << "Error: cannot register route " << method << " " << pattern
+                  << (frozen ? " after the server has started" : ": unsupported method") << std::endl;
+        return false;
+    }
+
+    node* current = &roots[index];
+    size_t pos = 0;
+    std::string_view segment;
+    while (next_segment(pattern, pos, segment)) {
+        if (segment[0] == ':') {
+            if (!current->param_child) {
+                current->param_child = std::make_unique<node>();
+                current->param_child->param_name = std::string(segment.substr(1));
+            }
+            current = current->param_child.get();
+            continue;
+        }
+
+        node* next = nullptr;
+        for (auto& child : current->literal_children) {
+            if (child->segment == segment) {
+                next = child.get();
+                break;
+            }
+        }
+        if (!next) {
+            current->literal_children.push_back(std::make_unique<node>());
+            next = current->literal_children.back().get();
+            next->segment = std::string(segment);
+        }
+        current = next;
+    }
+
+    if (!current->has_handler) {
+        route_count++;
+    }
+    current->handler = std::move(handler);
+    current->has_handler = true;
+    return true;
+}
+
+// Literal segments win over parameters; if a literal branch dead-ends the
+// parameter branch is tried before giving up.
+template<typename Handler>
+const typename router<Handler>::node* router<Handler>::match_from(const node* current, std::string_view path,
+                                                                  size_t pos, http_request_view& req) const {
+    std::string_view segment;
+    if (!next_segment(path, pos, segment)) {
+        return current->has_handler ? current : nullptr;
+    }
+
+    for (const auto& child : current->literal_children) {
+        if (child->segment == segment) {
+            const node* found = match_from(child.get(), path, pos, req);
+            if (found) return found;
+            break;
+        }
+    }
+
+    if (current->param_child && req.param_count < http_request_view::max_params) {
+        size_t slot = req.param_count++;
+        req.params[slot].name = current->param_child->param_name;
+        req.params[slot].value = segment;
+        const node* found = match_from(current->param_child.get(), path, pos, req);
+        if (found) return found;
+        req.param_count = slot;
+    }
+    return nullptr;
+}
+
+template<typename Handler>
+const Handler* router<Handler>::match(std::string_view method, std::string_view path, http_request_view& req) const {
+    int index = method_to_index(method);
+    if (index < 0) {
+        return nullptr;
+    }
+    req.param_count = 0;
+    const node* found = match_from(&roots[index], path, 0, req);
+    return found ? &found->handler : nullptr;
+}
+
+template<typename Handler>
+Handler* router<Handler>::find(std::string_view method, std::string_view pattern) {
+    int index = method_to_index(method);
+    if (frozen || index < 0) {
+        return nullptr;
+    }
+    node* current = &roots[index];
+    size_t pos = 0;
+    std::string_view segment;
+    while (current && next_segment(pattern, pos, segment)) {
+        node* next = nullptr;
+        if (segment[0] == ':') {
+            next = current->param_child.get();
+        } else {
+            for (auto& child : current->literal_children) {
+                if (child->segment == segment) {
+                    next = child.get();
+                    break;
+                }
+            }
+        }
+        current = next;
+    }
+    return current && current->has_handler ? &current->handler : nullptr;
+}
+
+#endif
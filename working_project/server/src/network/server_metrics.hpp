@@ -0,0 +1,40 @@
+#ifndef SERVER_METRICS_HPP
+#define SERVER_METRICS_HPP
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+struct server_metrics {
+    std::atomic<uint64_t> connections_accepted{0};
+    std::atomic<uint64_t> connections_open{0};
+    std::atomic<uint64_t> requests_total{0};
+    std::atomic<uint64_t> requests_rejected{0};
+    std::atomic<uint64_t> requests_limited{0};
+    std::atomic<uint64_t> connections_timed_out{0};
+    std::atomic<uint64_t> queue_depth{0};
+    std::atomic<uint64_t> compressed_responses{0};
+    std::atomic<uint64_t> compression_bytes_saved{0};
+    std::atomic<uint64_t> websockets_open{0};
+    std::atomic<uint64_t> websocket_messages_in{0};
+    std::atomic<uint64_t> websocket_frames_out{0};
+
+    std::string to_json() const;
+};
+
+inline std::string server_metrics::to_json() const {
+    return "{\"connections_accepted\":" + std::to_string(connections_accepted.load()) +
+           ",\"connections_open\":" + std::to_string(connections_open.load()) +
+           ",\"requests_total\":" + std::to_string(requests_total.load()) +
+           ",\"requests_rejected\":" + std::to_string(requests_rejected.load()) +
+           ",\"requests_limited\":" + std::to_string(requests_limited.load()) +
+           ",\"connections_timed_out\":" + std::to_string(connections_timed_out.load()) +
+           ",\"queue_depth\":" + std::to_string(queue_depth.load()) +
+           ",\"compressed_responses\":" + std::to_string(compressed_responses.load()) +
+           ",\"compression_bytes_saved\":" + std::to_string(compression_bytes_saved.load()) +
+           ",\"websockets_open\":" + std::to_string(websockets_open.load()) +
+           ",\"websocket_messages_in\":" + std::to_string(websocket_messages_in.load()) +
+           ",\"websocket_frames_out\":" + std::to_string(websocket_frames_out.load()) + "}";
+}
+
+#endif
@@ -0,0 +1,407 @@
+#ifndef STATIC_CACHE_HPP
+#define STATIC_CACHE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+
+#include "../utils/gzip_utils.hpp"
+
+// Open descriptor for a large asset, shared by every response streaming it
+// and closed when the last one (and the table) lets go.
+struct static_file {
+    int fd;
+
+    explicit static_file(int file_fd) : fd(file_fd) {}
+    ~static_file() { close(fd); }
+
+    static_file(const static_file&) = delete;
+    static_file& operator=(const static_file&) = delete;
+};
+
+// Exactly one of content (small files, held in memory) or file (large
+// files, sent with sendfile) is set.
+struct static_asset {
+    std::string path;
+    uint64_t size;
+    std::shared_ptr<const std::string> content;
+    std::shared_ptr<const static_file> file;
+    std::string content_type;
+    std::string etag;
+    // Pre-rendered ETag, Cache-Control and Accept-Ranges header lines.
+    std::string headers;
+    // Gzip variant built at load time for compressible types, when it is
+    // actually smaller. It has its own ETag, as RFC 7232 requires.
+    std::shared_ptr<const std::string> gzip_content;
+    std::string gzip_etag;
+    std::string gzip_headers;
+};
+
+// Snapshot of the client directory. Never modified once built; a reload
+// builds a new table and swaps the pointer, so readers holding the old one
+// keep a consistent view.
+class static_asset_table {
+private:
+    std::vector<static_asset> assets;
+
+    friend class static_cache;
+
+public:
+    const static_asset* find(std::string_view path) const;
+    size_t size() const { return assets.size(); }
+};
+
+class static_cache {
+private:
+    static constexpr const char* html_cache_control = "no-cache";
+    static constexpr const char* asset_cache_control = "public, max-age=300";
+
+    std::string root;
+    size_t sendfile_threshold;
+    int gzip_level;
+    std::shared_ptr<const static_asset_table> table;
+    int watch_fd;
+
+    static constexpr uint64_t etag_seed = 14695981039346656037ULL;
+    static constexpr size_t scan_chunk_bytes = 64 * 1024;
+
+    static std::string content_type_for(const std::string& path);
+    static uint64_t hash_bytes(uint64_t hash, std::string_view data);
+    static std::string make_etag(uint64_t hash);
+    static bool read_file(const std::string& filepath, std::string& content);
+    static bool scan_file(int fd, uint64_t& hash, uint64_t& size, gzip_writer* gzip);
+    void add_watches();
+
+public:
+    enum range_status { no_range, range_ok, range_unsatisfiable };
+
+    static_cache(const std::string& root_dir, size_t sendfile_min_bytes = 64 * 1024, int gzip_level = 6);
+    ~static_cache();
+
+    static_cache(const static_cache&) = delete;
+    static_cache& operator=(const static_cache&) = delete;
+
+    bool load();
+    std::shared_ptr<const static_asset_table> snapshot() const;
+
+    int start_watching();
+    bool handle_watch_events();
+    void stop_watching();
+
+    static bool etag_matches(std::string_view if_none_match, std::string_view etag);
+    static range_status parse_range(std::string_view header, uint64_t size, uint64_t& first, uint64_t& last);
+};
+
+inline const static_asset* static_asset_table::find(std::string_view path) const {
+    auto it = std::lower_bound(assets.begin(), assets.end(), path,
+        [](const static_asset& asset, std::string_view key) { return asset.path < key; });
+    if (it == assets.end() || it->path != path) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+inline static_cache::static_cache(const std::string& root_dir, size_t sendfile_min_bytes, int level)
+    : root(root_dir), sendfile_threshold(sendfile_min_bytes), gzip_level(level), table(std::make_shared<static_asset_table>()), watch_fd(-1) {}
+
+inline static_cache::~static_cache() {
+    stop_watching();
+}
+
+inline std::string static_cache::content_type_for(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".html" || extension == ".htm") return "text/html";
+    if (extension == ".css") return "text/css";
+    if (extension == ".js") return "application/javascript";
+    if (extension == ".json") return "application/json";
+    if (extension == ".png") return "image/png";
+    if (extension == ".jpg" || extension == ".jpeg") return "image/jpeg";
+    if (extension == ".gif") return "image/gif";
+    if (extension == ".svg") return "image/svg+xml";
+    if (extension == ".ico") return "image/x-icon";
+    if (extension == ".woff2") return "font/woff2";
+    return "text/plain";
+}
+
+// FNV-1a over the file contents, continued from hash so a file can be fed
+// in pieces: identical bytes give the same tag across restarts and
+// reloads, so browser caches survive a server bounce.
+inline uint64_t static_cache::hash_bytes(uint64_t hash, std::string_view data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline std::string static_cache::make_etag(uint64_t hash) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "\"%016llx\"", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+inline bool static_cache::read_file(const std::string& filepath, std::string& content) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+// Hashes, and gzips when given a writer, a file read in fixed-size chunks
+// from the descriptor sendfile will serve it from, so a large asset is
+// never held whole.
+inline bool static_cache::scan_file(int fd, uint64_t& hash, uint64_t& size, gzip_writer* gzip) {
+    std::vector<char> chunk(scan_chunk_bytes);
+    size = 0;
+    while (true) {
+        ssize_t bytes = pread(fd, chunk.data(), chunk.size(), size);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes < 0) {
+            return false;
+        }
+        if (bytes == 0) {
+            return true;
+        }
+        std::string_view piece(chunk.data(), bytes);
+        hash = hash_bytes(hash, piece);
+        if (gzip) {
+            gzip->append(piece);
+        }
+        size += bytes;
+    }
+}
+
+inline bool static_cache::load() {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+        std::cerr << "Error: static directory " << root << " not found" << std::endl;
+        return false;
+    }
+
+    auto next = std::make_shared<static_asset_table>();
+    for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        std::string relative = fs::relative(it->path(), root, ec).generic_string();
+        if (ec || relative.empty() || relative[0] == '.' || relative.find("/.") != std::string::npos) {
+            continue;
+        }
+
+        static_asset asset;
+        asset.path = "/" + relative;
+        asset.content_type = content_type_for(relative);
+        bool compressible = gzip_utils::is_compressible(asset.content_type);
+
+        // Large files are scanned from the descriptor that will serve them;
+        // only the ones below the threshold are read into memory.
+        std::error_code size_ec;
+        int fd = -1;
+        if (it->file_size(size_ec) >= sendfile_threshold && !size_ec) {
+            fd = open(it->path().c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        uint64_t hash = etag_seed;
+        std::string compressed;
+        bool has_compressed = false;
+        if (fd >= 0) {
+            gzip_writer gzip(compressible ? gzip_level : 0);
+            if (!scan_file(fd, hash, asset.size, compressible ? &gzip : nullptr)) {
+                std::cerr << "Error: could not read static file " << it->path() << std::endl;
+                close(fd);
+                continue;
+            }
+            asset.file = std::make_shared<const static_file>(fd);
+            has_compressed = compressible && gzip.finish(compressed);
+        } else {
+            std::string content;
+            if (!read_file(it->path().string(), content)) {
+                std::cerr << "Error: could not read static file " << it->path() << std::endl;
+                continue;
+            }
+            asset.size = content.size();
+            hash = hash_bytes(hash, content);
+            has_compressed = compressible && gzip_utils::compress(content, gzip_level, compressed);
+            asset.content = std::make_shared<const std::string>(std::move(content));
+        }
+
+        asset.etag = make_etag(hash);
+        std::string cache_control = std::string("Cache-Control: ") +
+            (asset.content_type == "text/html" ? html_cache_control : asset_cache_control) + "\r\n";
+        asset.headers = "ETag: " + asset.etag + "\r\n" + cache_control + "Accept-Ranges: bytes\r\n";
+        if (compressible) {
+            // Even without a gzip variant: an edit can make one appear.
+            asset.headers += "Vary: Accept-Encoding\r\n";
+        }
+
+        if (has_compressed && compressed.size() + compressed.size() / 8 < asset.size) {
+            asset.gzip_etag = asset.etag;
+            asset.gzip_etag.insert(asset.gzip_etag.size() - 1, "-gz");
+            asset.gzip_headers = "ETag: " + asset.gzip_etag + "\r\n" + cache_control +
+                                 "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n";
+            asset.gzip_content = std::make_shared<const std::string>(std::move(compressed));
+        }
+        next->assets.push_back(asset);
+
+        // Directory indexes answer for the bare directory path too.
+        std::string filename = it->path().filename().string();
+        if (filename == "index.html") {
+            asset.path.resize(asset.path.size() - filename.size());
+            next->assets.push_back(std::move(asset));
+        }
+    }
+    if (ec) {
+        std::cerr << "Error: failed to scan " << root << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    std::sort(next->assets.begin(), next->assets.end(),
+              [](const static_asset& a, const static_asset& b) { return a.path < b.path; });
+    std::atomic_store(&table, std::shared_ptr<const static_asset_table>(std::move(next)));
+    return true;
+}
+
+inline std::shared_ptr<const static_asset_table> static_cache::snapshot() const {
+    return std::atomic_load(&table);
+}
+
+inline void static_cache::add_watches() {
+    namespace fs = std::filesystem;
+    const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    std::error_code ec;
+    inotify_add_watch(watch_fd, root.c_str(), mask);
+    for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            inotify_add_watch(watch_fd, it->path().c_str(), mask);
+        }
+    }
+}
+
+// Returns a non-blocking inotify descriptor for the caller's event loop, or
+// -1 if watching is unavailable.
+inline int static_cache::start_watching() {
+    if (watch_fd >= 0) {
+        return watch_fd;
+    }
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0) {
+        std::cerr << "Error: cannot watch " << root << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+    add_watches();
+    return watch_fd;
+}
+
+// Drains pending change notifications and rebuilds the table once for the
+// whole batch. New subdirectories are picked up by re-adding watches.
+inline bool static_cache::handle_watch_events() {
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    while (read(watch_fd, buffer, sizeof(buffer)) > 0) {
+        changed = true;
+    }
+    if (!changed) {
+        return false;
+    }
+    add_watches();
+    if (!load()) {
+        return false;
+    }
+    std::cout << "Reloaded " << snapshot()->size() << " static assets from " << root << std::endl;
+    return true;
+}
+
+inline void static_cache::stop_watching() {
+    if (watch_fd >= 0) {
+        close(watch_fd);
+        watch_fd = -1;
+    }
+}
+
+// If-None-Match carries "*" or a comma-separated list of tags, possibly
+// weak ("W/..."); weak comparison is what RFC 7232 asks for here.
+inline bool static_cache::etag_matches(std::string_view if_none_match, std::string_view etag) {
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        size_t end = if_none_match.find(',', pos);
+        if (end == std::string_view::npos) end = if_none_match.size();
+        std::string_view candidate = if_none_match.substr(pos, end - pos);
+        while (!candidate.empty() && (candidate.front() == ' ' || candidate.front() == '\t')) candidate.remove_prefix(1);
+        while (!candidate.empty() && (candidate.back() == ' ' || candidate.back() == '\t')) candidate.remove_suffix(1);
+        if (candidate.substr(0, 2) == "W/") candidate.remove_prefix(2);
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+// Single "bytes=first-last", "bytes=first-" or "bytes=-suffix" ranges are
+// honoured. Multi-range and unknown units fall back to the full body, which
+// RFC 7233 permits.
+inline static_cache::range_status static_cache::parse_range(std::string_view header, uint64_t size,
+                                                            uint64_t& first, uint64_t& last) {
+    if (header.substr(0, 6) != "bytes=" || header.find(',') != std::string_view::npos) {
+        return no_range;
+    }
+    std::string_view spec = header.substr(6);
+    size_t dash = spec.find('-');
+    if (dash == std::string_view::npos) {
+        return no_range;
+    }
+
+    auto parse_number = [](std::string_view digits, uint64_t& value) {
+        if (digits.empty() || digits.size() > 19) return false;
+        value = 0;
+        for (char c : digits) {
+            if (c < '0' || c > '9') return false;
+            value = value * 10 + (c - '0');
+        }
+        return true;
+    };
+
+    std::string_view first_part = spec.substr(0, dash);
+    std::string_view last_part = spec.substr(dash + 1);
+    if (first_part.empty()) {
+        uint64_t suffix;
+        if (!parse_number(last_part, suffix)) return no_range;
+        if (suffix == 0 || size == 0) return range_unsatisfiable;
+        first = suffix >= size ? 0 : size - suffix;
+        last = size - 1;
+        return range_ok;
+    }
+
+    if (!parse_number(first_part, first)) return no_range;
+    if (last_part.empty()) {
+        last = size ? size - 1 : 0;
+    } else if (!parse_number(last_part, last) || last < first) {
+        return no_range;
+    }
+    if (first >= size) {
+        return range_unsatisfiable;
+    }
+    if (last >= size) last = size - 1;
+    return range_ok;
+}
+
+#endif
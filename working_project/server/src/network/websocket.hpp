@@ -0,0 +1,225 @@
+#ifndef WEBSOCKET_HPP
+#define WEBSOCKET_HPP
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <strings.h>
+
+#include "request_parser.hpp"
+#include "../utils/sha1.hpp"
+#include "../utils/base64.hpp"
+
+// Callbacks behind one WebSocket path. authenticate runs on a worker for
+// the upgrade request and returns the channel (user id) the socket joins, or
+// 0 to refuse it. on_message and on_presence also run on workers; presence
+// fires when a channel gains its first socket or loses its last one.
+struct websocket_endpoint {
+    std::function<uint64_t(const http_request_view&)> authenticate;
+    std::function<void(uint64_t channel, std::string message)> on_message;
+    std::function<void(uint64_t channel, bool online)> on_presence;
+};
+
+// RFC 6455 handshake and framing. The server never masks what it sends and
+// rejects client frames that are not masked; no extensions are negotiated,
+// so any RSV bit is a protocol error.
+class websocket {
+public:
+    enum opcode : uint8_t {
+        continuation_frame = 0x0, text_frame = 0x1, binary_frame = 0x2,
+        close_frame = 0x8, ping_frame = 0x9, pong_frame = 0xA
+    };
+    enum parse_status { need_more, complete, failed };
+
+    static const uint16_t close_normal = 1000;
+    static const uint16_t close_going_away = 1001;
+    static const uint16_t close_protocol_error = 1002;
+    static const uint16_t close_too_big = 1009;
+    static const uint16_t close_try_again = 1013;
+    static const size_t max_control_payload = 125;
+    static const size_t max_header_size = 14;
+
+    struct frame {
+        bool fin;
+        uint8_t opcode;
+        std::string payload;
+        // Bytes the frame occupied on the wire; set when complete.
+        size_t consumed;
+        // Close code to send back when parsing failed.
+        uint16_t error_code;
+    };
+
+    // Checks the upgrade headers and hands back the client's key.
+    static bool handshake_key(const http_request_view& req, std::string_view& key);
+    static std::string accept_key(std::string_view key);
+    static std::string handshake_response(std::string_view key);
+
+    static std::string encode_frame(uint8_t code, std::string_view payload);
+    static std::string encode_close(uint16_t status);
+    // Client-side framing; used by tests and the benchmark client.
+    static std::string encode_masked_frame(uint8_t code, std::string_view payload, const unsigned char mask[4],
+                                           bool fin = true);
+
+    // Decodes one client frame from the front of data, unmasking the payload
+    // into out. Frames whose payload exceeds max_payload fail with 1009.
+    static parse_status parse_frame(const char* data, size_t size, size_t max_payload, frame& out);
+
+    static uint16_t close_status(std::string_view payload);
+
+private:
+    static bool has_token(std::string_view header, std::string_view token);
+    static void append_header(std::string& out, uint8_t first_byte, bool masked, size_t length);
+};
+
+// Header values such as "keep-alive, Upgrade" are comma-separated token
+// lists compared case-insensitively.
+inline bool websocket::has_token(std::string_view header, std::string_view token) {
+    size_t pos = 0;
+    while (pos <= header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string_view::npos) end = header.size();
+        std::string_view item = header.substr(pos, end - pos);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item.size() == token.size() && strncasecmp(item.data(), token.data(), token.size()) == 0) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+inline bool websocket::handshake_key(const http_request_view& req, std::string_view& key) {
+    if (req.method != "GET" || !has_token(req.header("Upgrade"), "websocket") ||
+        !has_token(req.header("Connection"), "upgrade") || req.header("Sec-WebSocket-Version") != "13") {
+        return false;
+    }
+    key = req.header("Sec-WebSocket-Key");
+    // The key is a base64-encoded 16-byte nonce.
+    return base64::decoded_size(key) == 16;
+}
+
+inline std::string websocket::accept_key(std::string_view key) {
+    std::string input(key);
+    input += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    return base64::encode(sha1::digest(input));
+}
+
+inline std::string websocket::handshake_response(std::string_view key) {
+    return "HTTP/1.1 101 Switching Protocols\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: " + accept_key(key) + "\r\n\r\n";
+}
+
+inline void websocket::append_header(std::string& out, uint8_t first_byte, bool masked, size_t length) {
+    out += static_cast<char>(first_byte);
+    uint8_t mask_bit = masked ? 0x80 : 0;
+    if (length <= 125) {
+        out += static_cast<char>(mask_bit | length);
+    } else if (length <= 0xFFFF) {
+        out += static_cast<char>(mask_bit | 126);
+        out += static_cast<char>(length >> 8);
+        out += static_cast<char>(length & 0xFF);
+    } else {
+        out += static_cast<char>(mask_bit | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out += static_cast<char>((static_cast<uint64_t>(length) >> shift) & 0xFF);
+        }
+    }
+}
+
+inline std::string websocket::encode_frame(uint8_t code, std::string_view payload) {
+    std::string out;
+    out.reserve(payload.size() + 10);
+    append_header(out, 0x80 | code, false, payload.size());
+    out.append(payload.data(), payload.size());
+    return out;
+}
+
+inline std::string websocket::encode_close(uint16_t status) {
+    char payload[2] = {static_cast<char>(status >> 8), static_cast<char>(status & 0xFF)};
+    return encode_frame(close_frame, std::string_view(payload, sizeof(payload)));
+}
+
+inline std::string websocket::encode_masked_frame(uint8_t code, std::string_view payload, const unsigned char mask[4],
+                                                  bool fin) {
+    std::string out;
+    out.reserve(payload.size() + max_header_size);
+    append_header(out, (fin ? 0x80 : 0) | code, true, payload.size());
+    out.append(reinterpret_cast<const char*>(mask), 4);
+    for (size_t i = 0; i < payload.size(); i++) {
+        out += static_cast<char>(payload[i] ^ mask[i & 3]);
+    }
+    return out;
+}
+
+inline websocket::parse_status websocket::parse_frame(const char* data, size_t size, size_t max_payload,
+                                                      frame& out) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    if (size < 2) {
+        return need_more;
+    }
+    out.fin = (bytes[0] & 0x80) != 0;
+    out.opcode = bytes[0] & 0x0F;
+    out.error_code = close_protocol_error;
+    bool masked = (bytes[1] & 0x80) != 0;
+    bool control = (out.opcode & 0x8) != 0;
+    if ((bytes[0] & 0x70) || !masked) {
+        return failed;
+    }
+    if (out.opcode != continuation_frame && out.opcode != text_frame && out.opcode != binary_frame &&
+        out.opcode != close_frame && out.opcode != ping_frame && out.opcode != pong_frame) {
+        return failed;
+    }
+
+    uint64_t length = bytes[1] & 0x7F;
+    size_t header_size = 2;
+    if (length == 126) {
+        header_size = 4;
+        if (size < header_size) return need_more;
+        length = (static_cast<uint64_t>(bytes[2]) << 8) | bytes[3];
+    } else if (length == 127) {
+        header_size = 10;
+        if (size < header_size) return need_more;
+        length = 0;
+        for (int i = 2; i < 10; i++) {
+            length = (length << 8) | bytes[i];
+        }
+        if (length >> 63) {
+            return failed;
+        }
+    }
+    if (control && (!out.fin || length > max_control_payload)) {
+        return failed;
+    }
+    if (length > max_payload) {
+        out.error_code = close_too_big;
+        return failed;
+    }
+
+    header_size += 4;
+    if (size < header_size || size - header_size < length) {
+        return need_more;
+    }
+    const unsigned char* mask = bytes + header_size - 4;
+    const unsigned char* payload = bytes + header_size;
+    out.payload.resize(length);
+    for (size_t i = 0; i < length; i++) {
+        out.payload[i] = static_cast<char>(payload[i] ^ mask[i & 3]);
+    }
+    out.consumed = header_size + length;
+    return complete;
+}
+
+// Status code carried by a close frame, or 1000 if it carried none.
+inline uint16_t websocket::close_status(std::string_view payload) {
+    if (payload.size() < 2) {
+        return close_normal;
+    }
+    return static_cast<uint16_t>((static_cast<unsigned char>(payload[0]) << 8) | static_cast<unsigned char>(payload[1]));
+}
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+// Fixed set of threads draining a bounded FIFO. try_submit refuses work
+// instead of queueing it once the backlog is too deep or too old, so the
+// caller can shed load while admitted tasks keep a flat queueing delay.
+class worker_pool {
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct task {
+        std::function<void()> run;
+        clock::time_point enqueued_at;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<task> tasks;
+    mutable std::mutex mutex_lock;
+    std::condition_variable task_ready;
+    size_t max_queue_depth;
+    std::chrono::milliseconds max_queue_age;
+    bool stopping;
+
+    void worker_loop();
+
+public:
+    worker_pool(size_t thread_count, size_t max_depth, uint64_t max_age_ms);
+    ~worker_pool();
+
+    bool try_submit(std::function<void()> fn);
+    void stop();
+
+    size_t queue_depth() const;
+    size_t thread_count() const;
+};
+
+inline worker_pool::worker_pool(size_t thread_count, size_t max_depth, uint64_t max_age_ms)
+    : max_queue_depth(max_depth), max_queue_age(max_age_ms), stopping(false) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        workers.emplace_back(&worker_pool::worker_loop, this);
+    }
+}
+
+inline worker_pool::~worker_pool() {
+    stop();
+}
+
+inline bool worker_pool::try_submit(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        if (stopping || tasks.size() >= max_queue_depth) {
+            return false;
+        }
+        if (!tasks.empty() && clock::now() - tasks.front().enqueued_at > max_queue_age) {
+            return false;
+        }
+        tasks.push_back({std::move(fn), clock::now()});
+    }
+    task_ready.notify_one();
+    return true;
+}
+
+inline void worker_pool::worker_loop() {
+    while (true) {
+        task next;
+        {
+            std::unique_lock<std::mutex> lock(mutex_lock);
+            task_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping) {
+                return;
+            }
+            next = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        next.run();
+    }
+}
+
+inline void worker_pool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+        tasks.clear();
+    }
+    task_ready.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+inline size_t worker_pool::queue_depth() const {
+    std::lock_guard<std::mutex> lock(mutex_lock);
+    return tasks.size();
+}
+
+inline size_t worker_pool::thread_count() const {
+    return workers.size();
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef BASE64_HPP
+#define BASE64_HPP
+
+#include <string>
+#include <string_view>
+
+class base64 {
+public:
+    // Standard alphabet with '=' padding (RFC 4648 section 4).
+    static std::string encode(std::string_view input) {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string encoded;
+        encoded.reserve((input.size() + 2) / 3 * 4);
+        size_t i = 0;
+        for (; i + 2 < input.size(); i += 3) {
+            unsigned value = (static_cast<unsigned char>(input[i]) << 16) |
+                             (static_cast<unsigned char>(input[i + 1]) << 8) |
+                             static_cast<unsigned char>(input[i + 2]);
+            encoded += alphabet[(value >> 18) & 63];
+            encoded += alphabet[(value >> 12) & 63];
+            encoded += alphabet[(value >> 6) & 63];
+            encoded += alphabet[value & 63];
+        }
+        if (i < input.size()) {
+            unsigned value = static_cast<unsigned char>(input[i]) << 16;
+            if (i + 1 < input.size()) {
+                value |= static_cast<unsigned char>(input[i + 1]) << 8;
+            }
+            encoded += alphabet[(value >> 18) & 63];
+            encoded += alphabet[(value >> 12) & 63];
+            encoded += i + 1 < input.size() ? alphabet[(value >> 6) & 63] : '=';
+            encoded += '=';
+        }
+        return encoded;
+    }
+
+    // Length of the decoded form of a well-formed encoding, or -1; used to
+    // validate keys without materialising them.
+    static long decoded_size(std::string_view encoded) {
+        if (encoded.size() % 4 != 0) {
+            return -1;
+        }
+        size_t padding = 0;
+        for (size_t i = 0; i < encoded.size(); i++) {
+            char c = encoded[i];
+            bool valid = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                         c == '+' || c == '/';
+            if (c == '=' && i + 2 >= encoded.size()) {
+                padding++;
+                continue;
+            }
+            if (!valid || padding > 0) {
+                return -1;
+            }
+        }
+        return static_cast<long>(encoded.size() / 4 * 3 - padding);
+    }
+};
+
+#endif
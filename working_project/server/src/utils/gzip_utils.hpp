@@ -0,0 +1,171 @@
+#ifndef GZIP_UTILS_HPP
+#define GZIP_UTILS_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include <cctype>
+#include <zlib.h>
+
+class gzip_utils {
+public:
+    // Level 1 (fastest) to 9 (smallest); 0 means compression is disabled.
+    static bool compress(std::string_view input, int level, std::string& output) {
+        if (level <= 0) {
+            return false;
+        }
+        z_stream stream = {};
+        // windowBits 15 + 16 asks zlib for a gzip header and trailer.
+        if (deflateInit2(&stream, level > 9 ? 9 : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        output.resize(deflateBound(&stream, input.size()) + 32);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = input.size();
+        stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+        stream.avail_out = output.size();
+        int result = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result == Z_STREAM_END;
+    }
+
+    static bool decompress(std::string_view input, std::string& output) {
+        z_stream stream = {};
+        if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+            return false;
+        }
+        output.clear();
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = input.size();
+        char chunk[16384];
+        int result;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(chunk);
+            stream.avail_out = sizeof(chunk);
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                inflateEnd(&stream);
+                return false;
+            }
+            output.append(chunk, sizeof(chunk) - stream.avail_out);
+        } while (result != Z_STREAM_END);
+        inflateEnd(&stream);
+        return true;
+    }
+
+    // True if an Accept-Encoding header allows gzip, honouring "q=0" opt-outs
+    // and the "*" wildcard.
+    static bool accepts_gzip(std::string_view accept_encoding) {
+        bool wildcard = false;
+        size_t pos = 0;
+        while (pos < accept_encoding.size()) {
+            size_t end = accept_encoding.find(',', pos);
+            if (end == std::string_view::npos) end = accept_encoding.size();
+            std::string_view entry = accept_encoding.substr(pos, end - pos);
+            pos = end + 1;
+
+            size_t semicolon = entry.find(';');
+            std::string_view coding = trim(entry.substr(0, semicolon));
+            bool allowed = true;
+            if (semicolon != std::string_view::npos) {
+                std::string_view params = trim(entry.substr(semicolon + 1));
+                if (params.substr(0, 2) == "q=" || params.substr(0, 2) == "Q=") {
+                    allowed = std::strtod(std::string(params.substr(2)).c_str(), nullptr) > 0.0;
+                }
+            }
+            if (equals_ignore_case(coding, "gzip") || equals_ignore_case(coding, "x-gzip")) {
+                return allowed;
+            }
+            if (coding == "*") {
+                wildcard = allowed;
+            }
+        }
+        return wildcard;
+    }
+
+    // Images and fonts are already compressed; gzipping them wastes CPU.
+    static bool is_compressible(std::string_view content_type) {
+        return content_type.substr(0, 5) == "text/" ||
+               content_type == "application/javascript" ||
+               content_type == "application/json" ||
+               content_type == "image/svg+xml";
+    }
+
+private:
+    static std::string_view trim(std::string_view value) {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+        return value;
+    }
+
+    static bool equals_ignore_case(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// compress() for input that arrives in pieces, such as a file read in
+// chunks, so the whole input never has to be held at once.
+class gzip_writer {
+public:
+    explicit gzip_writer(int level) : stream(), ready(false) {
+        if (level > 0) {
+            ready = deflateInit2(&stream, level > 9 ? 9 : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+    }
+
+    ~gzip_writer() {
+        deflateEnd(&stream);
+    }
+
+    gzip_writer(const gzip_writer&) = delete;
+    gzip_writer& operator=(const gzip_writer&) = delete;
+
+    bool append(std::string_view input) {
+        return run(input, Z_NO_FLUSH);
+    }
+
+    // Writes the trailer and hands over the whole gzip member.
+    bool finish(std::string& output) {
+        if (!run(std::string_view(), Z_FINISH)) {
+            return false;
+        }
+        output = std::move(compressed);
+        return true;
+    }
+
+private:
+    z_stream stream;
+    bool ready;
+    std::string compressed;
+
+    bool run(std::string_view input, int flush) {
+        if (!ready) {
+            return false;
+        }
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = input.size();
+        char chunk[16384];
+        int result;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(chunk);
+            stream.avail_out = sizeof(chunk);
+            result = deflate(&stream, flush);
+            if (result == Z_STREAM_ERROR) {
+                ready = false;
+                return false;
+            }
+            compressed.append(chunk, sizeof(chunk) - stream.avail_out);
+        } while (stream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+        ready = flush != Z_FINISH;
+        return true;
+    }
+};
+
+#endif
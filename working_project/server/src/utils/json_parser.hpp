@@ -2,6 +2,7 @@
 #define JSON_PARSER_HPP
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <sstream>
@@ -23,35 +24,41 @@ public:
 
 class json_parser {
 public:
-    static json_value parse(const std::string& json_str);
+    static json_value parse(std::string_view json_str);
     static std::string stringify(const json_value& val);
     
 private:
-    static json_value parse_value(const std::string& str, size_t& pos);
-    static json_value parse_object(const std::string& str, size_t& pos);
-    static json_value parse_array(const std::string& str, size_t& pos);
-    static json_value parse_string(const std::string& str, size_t& pos);
-    static json_value parse_number(const std::string& str, size_t& pos);
-    static void skip_whitespace(const std::string& str, size_t& pos);
+    static json_value parse_value(std::string_view str, size_t& pos);
+    static json_value parse_object(std::string_view str, size_t& pos);
+    static json_value parse_array(std::string_view str, size_t& pos);
+    static json_value parse_string(std::string_view str, size_t& pos);
+    static json_value parse_number(std::string_view str, size_t& pos);
+    static void skip_whitespace(std::string_view str, size_t& pos);
+    static char peek(std::string_view str, size_t pos);
 };
 
-inline void json_parser::skip_whitespace(const std::string& str, size_t& pos) {
+// Views are not NUL-terminated, so reads past the end yield '\0' explicitly.
+inline char json_parser::peek(std::string_view str, size_t pos) {
+    return pos < str.length() ? str[pos] : '\0';
+}
+
+inline void json_parser::skip_whitespace(std::string_view str, size_t& pos) {
     while (pos < str.length() && std::isspace(str[pos])) pos++;
 }
 
-inline json_value json_parser::parse_number(const std::string& str, size_t& pos) {
+inline json_value json_parser::parse_number(std::string_view str, size_t& pos) {
     size_t start = pos;
-    if (str[pos] == '-') pos++;
+    if (peek(str, pos) == '-') pos++;
     while (pos < str.length() && (std::isdigit(str[pos]) || str[pos] == '.' || str[pos] == 'e' || str[pos] == 'E' || str[pos] == '+' || str[pos] == '-')) {
         pos++;
     }
     json_value val;
     val.value_type = json_value::number_type;
-    val.number_val = std::stod(str.substr(start, pos - start));
+    val.number_val = std::stod(std::string(str.substr(start, pos - start)));
     return val;
 }
 
-inline json_value json_parser::parse_string(const std::string& str, size_t& pos) {
+inline json_value json_parser::parse_string(std::string_view str, size_t& pos) {
     pos++;
     size_t start = pos;
     while (pos < str.length() && str[pos] != '"') {
@@ -60,12 +67,12 @@ inline json_value json_parser::parse_string(const std::string& str, size_t& pos)
     }
     json_value val;
     val.value_type = json_value::string_type;
-    val.string_val = str.substr(start, pos - start);
+    val.string_val = std::string(str.substr(start, pos - start));
     pos++;
     return val;
 }
 
-inline json_value json_parser::parse_array(const std::string& str, size_t& pos) {
+inline json_value json_parser::parse_array(std::string_view str, size_t& pos) {
     json_value val;
     val.value_type = json_value::array_type;
     pos++;
@@ -73,7 +80,7 @@ inline json_value json_parser::parse_array(const std::string& str, size_t& pos)
     while (pos < str.length() && str[pos] != ']') {
         val.array_val.push_back(parse_value(str, pos));
         skip_whitespace(str, pos);
-        if (str[pos] == ',') {
+        if (peek(str, pos) == ',') {
             pos++;
             skip_whitespace(str, pos);
         }
@@ -82,24 +89,24 @@ inline json_value json_parser::parse_array(const std::string& str, size_t& pos)
     return val;
 }
 
-inline json_value json_parser::parse_object(const std::string& str, size_t& pos) {
+inline json_value json_parser::parse_object(std::string_view str, size_t& pos) {
     json_value val;
     val.value_type = json_value::object_type;
     pos++;
     skip_whitespace(str, pos);
     while (pos < str.length() && str[pos] != '}') {
         skip_whitespace(str, pos);
-        if (str[pos] == '"') {
+        if (peek(str, pos) == '"') {
             json_value key_val = parse_string(str, pos);
             skip_whitespace(str, pos);
-            if (str[pos] == ':') {
+            if (peek(str, pos) == ':') {
                 pos++;
                 skip_whitespace(str, pos);
                 val.object_val[key_val.string_val] = parse_value(str, pos);
             }
         }
         skip_whitespace(str, pos);
-        if (str[pos] == ',') {
+        if (peek(str, pos) == ',') {
             pos++;
         }
     }
@@ -107,19 +114,19 @@ inline json_value json_parser::parse_object(const std::string& str, size_t& pos)
     return val;
 }
 
-inline json_value json_parser::parse_value(const std::string& str, size_t& pos) {
+inline json_value json_parser::parse_value(std::string_view str, size_t& pos) {
     skip_whitespace(str, pos);
-    if (str[pos] == '{') return parse_object(str, pos);
-    if (str[pos] == '[') return parse_array(str, pos);
-    if (str[pos] == '"') return parse_string(str, pos);
-    if (str[pos] == 't' || str[pos] == 'f') {
+    if (peek(str, pos) == '{') return parse_object(str, pos);
+    if (peek(str, pos) == '[') return parse_array(str, pos);
+    if (peek(str, pos) == '"') return parse_string(str, pos);
+    if (peek(str, pos) == 't' || peek(str, pos) == 'f') {
         json_value val;
         val.value_type = json_value::bool_type;
-        val.bool_val = (str[pos] == 't');
+        val.bool_val = (peek(str, pos) == 't');
         pos += (val.bool_val ? 4 : 5);
         return val;
     }
-    if (str[pos] == 'n') {
+    if (peek(str, pos) == 'n') {
         pos += 4;
         json_value val;
         val.value_type = json_value::null_type;
@@ -128,7 +135,7 @@ inline json_value json_parser::parse_value(const std::string& str, size_t& pos)
     return parse_number(str, pos);
 }
 
-inline json_value json_parser::parse(const std::string& json_str) {
+inline json_value json_parser::parse(std::string_view json_str) {
     size_t pos = 0;
     return parse_value(json_str, pos);
 }
@@ -19,9 +19,9 @@ public:
 };
 
 inline std::string password_hash::generate_salt(size_t length) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 255);
+    // Per thread: registrations generate salts concurrently.
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<> dis(0, 255);
     
     std::string salt;
     for (size_t i = 0; i < length; i++) {
@@ -0,0 +1,101 @@
+#ifndef SHA1_HPP
+#define SHA1_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+// SHA-1 as needed for the WebSocket handshake (RFC 6455 section 4.2.2).
+// Not for anything security-sensitive.
+class sha1 {
+public:
+    static const size_t digest_size = 20;
+
+    // Returns the raw 20-byte digest.
+    static std::string digest(std::string_view input);
+
+private:
+    static uint32_t rotate_left(uint32_t value, int bits) {
+        return (value << bits) | (value >> (32 - bits));
+    }
+    static void process_block(const unsigned char* block, uint32_t state[5]);
+};
+
+inline void sha1::process_block(const unsigned char* block, uint32_t state[5]) {
+    uint32_t words[80];
+    for (int i = 0; i < 16; i++) {
+        words[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 80; i++) {
+        words[i] = rotate_left(words[i - 3] ^ words[i - 8] ^ words[i - 14] ^ words[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = rotate_left(a, 5) + f + e + k + words[i];
+        e = d;
+        d = c;
+        c = rotate_left(b, 30);
+        b = a;
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+inline std::string sha1::digest(std::string_view input) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+    size_t full_blocks = input.size() / 64;
+    for (size_t i = 0; i < full_blocks; i++) {
+        process_block(data + i * 64, state);
+    }
+
+    // Final block(s): the leftover bytes, a 0x80 marker, zero padding and the
+    // message length in bits as a big-endian 64-bit integer.
+    unsigned char tail[128];
+    size_t remaining = input.size() - full_blocks * 64;
+    memset(tail, 0, sizeof(tail));
+    if (remaining > 0) {
+        memcpy(tail, data + full_blocks * 64, remaining);
+    }
+    tail[remaining] = 0x80;
+    size_t tail_size = remaining + 9 <= 64 ? 64 : 128;
+    uint64_t bit_length = static_cast<uint64_t>(input.size()) * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_size - 1 - i] = static_cast<unsigned char>(bit_length >> (i * 8));
+    }
+    for (size_t offset = 0; offset < tail_size; offset += 64) {
+        process_block(tail + offset, state);
+    }
+
+    std::string result(digest_size, '\0');
+    for (int i = 0; i < 5; i++) {
+        result[i * 4] = static_cast<char>(state[i] >> 24);
+        result[i * 4 + 1] = static_cast<char>(state[i] >> 16);
+        result[i * 4 + 2] = static_cast<char>(state[i] >> 8);
+        result[i * 4 + 3] = static_cast<char>(state[i]);
+    }
+    return result;
+}
+
+#endif
@@ -1,13 +1,21 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <cassert>
 #include <cstdint>
+#include <vector>
+#include <random>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
 
 #include "../server/src/core/hash_table.hpp"
 #include "../server/src/core/b_tree.hpp"
 #include "../server/src/core/graph.hpp"
 #include "../server/src/core/max_heap.hpp"
 #include "../server/src/core/lru_cache.hpp"
+#include "../server/src/core/timer_wheel.hpp"
 
 void test_hash_table() {
     std::cout << "Testing hash_table..." << std::endl;
@@ -36,6 +44,14 @@ void test_hash_table() {
     assert(ht.find("key_50", value));
     assert(value == 500);
     
+    assert(ht.modify("key_50", [](int& stored) { stored += 5; }));
+    assert(!ht.modify("key_999", [](int& stored) { stored = -1; }));
+    int seen = 0;
+    assert(ht.with_value(std::string_view("key_50_suffix").substr(0, 6), [&seen](const int& stored) { seen = stored; }));
+    assert(seen == 505);
+    assert(!ht.with_value("key_999", [&seen](const int& stored) { seen = stored; }));
+    assert(seen == 505);
+    
     assert(ht.remove("key_50"));
     assert(!ht.contains("key_50"));
     assert(ht.size() == 99);
@@ -46,6 +62,123 @@ void test_hash_table() {
     std::cout << "hash_table tests passed!" << std::endl;
 }
 
+// Random inserts, updates and removes checked against std::map, enough to
+// fill groups with tombstones and force both growing and same-size rehashes.
+void test_hash_table_churn() {
+    std::cout << "Testing hash_table churn..." << std::endl;
+    
+    hash_table<uint64_t, uint64_t> ht(16);
+    std::map<uint64_t, uint64_t> reference;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint64_t> key_dist(0, 3000);
+    
+    for (int i = 0; i < 200000; i++) {
+        // Multiples of 4096 share their low bits, which a plain modulo
+        // would send to one bucket.
+        uint64_t key = key_dist(gen) * 4096;
+        uint64_t value = 0;
+        switch (gen() % 4) {
+            case 0:
+            case 1:
+                assert(ht.insert(key, i) == reference.emplace(key, i).second);
+                break;
+            case 2:
+                assert(ht.remove(key) == (reference.erase(key) == 1));
+                break;
+            case 3:
+                if (reference.count(key)) {
+                    assert(ht.update(key, i));
+                    reference[key] = i;
+                } else {
+                    assert(!ht.update(key, i));
+                }
+                break;
+        }
+        assert(ht.find(key, value) == (reference.count(key) == 1));
+        assert(ht.size() == reference.size());
+    }
+    
+    size_t visited = 0;
+    ht.iterate([&](uint64_t key, uint64_t value) {
+        assert(reference.at(key) == value);
+        visited++;
+    });
+    assert(visited == reference.size());
+    
+    // Growing keeps old entries in the previous arrays for a while; they
+    // must stay findable, removable and visited exactly once meanwhile.
+    hash_table<uint64_t, uint64_t> growing(16);
+    std::set<uint64_t> live;
+    for (uint64_t i = 0; i < 20000; i++) {
+        assert(growing.insert(i, i));
+        live.insert(i);
+        uint64_t value = 0;
+        assert(growing.find(i / 2, value) == (live.count(i / 2) == 1));
+        if (i > 0 && i % 3 == 0 && live.count(i / 3)) {
+            assert(growing.remove(i / 3));
+            live.erase(i / 3);
+            assert(!growing.contains(i / 3));
+            assert(!growing.insert(i, 0));
+        }
+    }
+    std::set<uint64_t> seen;
+    growing.iterate([&](uint64_t key, uint64_t value) {
+        assert(key == value && live.count(key) && seen.insert(key).second);
+    });
+    assert(seen.size() == live.size() && growing.size() == live.size());
+    
+    hash_table<std::string, std::vector<int>> owners(16);
+    for (int i = 0; i < 1000; i++) {
+        owners.insert("user_" + std::to_string(i), std::vector<int>(i % 5, i));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        assert(owners.remove("user_" + std::to_string(i)));
+    }
+    std::vector<int> held;
+    assert(owners.find("user_999", held) && held.size() == 4 && held[0] == 999);
+    assert(!owners.contains("user_998"));
+    
+    std::cout << "hash_table churn tests passed!" << std::endl;
+}
+
+// Readers keep finding settled keys while a writer forces repeated resizes.
+void test_hash_table_concurrent_reads() {
+    std::cout << "Testing hash_table concurrent reads..." << std::endl;
+    
+    hash_table<uint64_t, uint64_t> ht(16);
+    for (uint64_t i = 0; i < 1000; i++) {
+        ht.insert(i, i * 3);
+    }
+    
+    std::atomic<bool> writing{true};
+    std::atomic<int> misses{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; r++) {
+        readers.emplace_back([&, r]() {
+            uint64_t key = r;
+            do {
+                uint64_t value = 0;
+                if (!ht.find(key, value) || value != key * 3 || !ht.contains(key)) {
+                    misses++;
+                }
+                key = (key + 7) % 1000;
+            } while (writing);
+        });
+    }
+    for (uint64_t i = 1000; i < 50000; i++) {
+        assert(ht.insert(i, i * 3));
+    }
+    writing = false;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    
+    assert(misses == 0);
+    assert(ht.size() == 50000);
+    
+    std::cout << "hash_table concurrent read tests passed!" << std::endl;
+}
+
 void test_b_tree() {
     std::cout << "Testing b_tree..." << std::endl;
     
@@ -179,13 +312,117 @@ void test_lru_cache() {
     std::cout << "lru_cache tests passed!" << std::endl;
 }
 
+void test_timer_wheel() {
+    std::cout << "Testing timer_wheel..." << std::endl;
+    
+    timer_wheel<int> wheel(10, 1000);
+    std::vector<int> fired;
+    auto record = [&](int value) { fired.push_back(value); };
+    
+    assert(wheel.empty());
+    timer_wheel<int>::timer_id a = wheel.schedule(1050, 1);
+    wheel.schedule(1020, 2);
+    timer_wheel<int>::timer_id c = wheel.schedule(1100, 3);
+    assert(wheel.size() == 3);
+    
+    // Nothing fires before its deadline.
+    assert(wheel.advance(1019, record) == 0);
+    assert(wheel.advance(1020, record) == 1);
+    assert(fired.size() == 1 && fired[0] == 2);
+    
+    assert(wheel.cancel(c));
+    assert(!wheel.cancel(c));
+    assert(wheel.advance(2000, record) == 1);
+    assert(fired.size() == 2 && fired[1] == 1);
+    assert(!wheel.cancel(a));  // already fired
+    assert(wheel.empty());
+    
+    // A reused slot gets a new id; the stale one stays dead.
+    timer_wheel<int>::timer_id reused = wheel.schedule(2500, 4);
+    assert(reused != a && reused != c);
+    assert(!wheel.cancel(a));
+    assert(wheel.cancel(reused));
+    
+    // Deadlines across every level, and past the wheel's range, fire on time
+    // and in order.
+    fired.clear();
+    std::vector<uint64_t> deadlines = {2005, 2640, 6096, 45000, 300000, 2700000, 90000000, 200000000};
+    for (size_t i = 0; i < deadlines.size(); i++) {
+        wheel.schedule(deadlines[i], static_cast<int>(i));
+    }
+    uint64_t now = 2000;
+    std::vector<uint64_t> fired_at(deadlines.size(), 0);
+    while (!wheel.empty()) {
+        now += 997;
+        wheel.advance(now, [&](int value) { fired_at[value] = now; fired.push_back(value); });
+    }
+    for (size_t i = 0; i < deadlines.size(); i++) {
+        assert(fired[i] == static_cast<int>(i));
+        assert(fired_at[i] >= deadlines[i] && fired_at[i] < deadlines[i] + 997 + 10);
+    }
+    
+    // Callbacks may cancel a neighbour due on the same tick and schedule new
+    // timers, including one a full lap away that lands in the firing slot.
+    timer_wheel<int> nested(1, 0);
+    timer_wheel<int>::timer_id victim = 0;
+    std::vector<int> order;
+    nested.schedule(5, 1);
+    victim = nested.schedule(5, 2);
+    nested.advance(10, [&](int value) {
+        order.push_back(value);
+        if (value == 1) {
+            nested.cancel(victim);
+            nested.schedule(10 + 64, 3);
+            nested.schedule(0, 4);
+        }
+    });
+    // The already-due timer still fires within the same advance.
+    assert(order.size() == 2 && order[0] == 1 && order[1] == 4);
+    nested.advance(73, [&](int value) { order.push_back(value); });
+    assert(order.size() == 2);
+    nested.advance(74, [&](int value) { order.push_back(value); });
+    assert(order.size() == 3 && order[2] == 3);
+    
+    // Randomised against a sorted reference.
+    std::mt19937 rng(7);
+    timer_wheel<int> randomized(4, 0);
+    std::map<int, uint64_t> expected;
+    std::vector<timer_wheel<int>::timer_id> ids;
+    for (int i = 0; i < 5000; i++) {
+        uint64_t deadline = rng() % 400000;
+        ids.push_back(randomized.schedule(deadline, i));
+        expected[i] = deadline;
+    }
+    for (int i = 0; i < 5000; i += 3) {
+        assert(randomized.cancel(ids[i]));
+        expected.erase(i);
+    }
+    uint64_t clock = 0;
+    size_t total = 0;
+    while (!randomized.empty()) {
+        clock += 1 + rng() % 3000;
+        total += randomized.advance(clock, [&](int value) {
+            auto it = expected.find(value);
+            assert(it != expected.end());
+            assert(it->second <= clock && clock - it->second < 3000 + 4);
+            expected.erase(it);
+        });
+    }
+    assert(expected.empty() && total == 5000 - 1667);
+    
+    std::cout << "timer_wheel tests passed!" << std::endl;
+}
+
 int main() {
     try {
         test_hash_table();
+        test_hash_table_churn();
+        test_hash_table_concurrent_reads();
         test_b_tree();
         test_graph();
         test_max_heap();
         test_lru_cache();
+        test_timer_wheel();
         
         std::cout << "\nAll tests passed successfully!" << std::endl;
         return 0;
@@ -0,0 +1,372 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+#include "../server/src/core/hash_table.hpp"
+#include "../server/src/models/user.hpp"
+#include "../server/src/models/session.hpp"
+
+// Bytes currently held from the heap, to price a table per entry, and
+// calls made to it, to count what each request allocates.
+static std::atomic<int64_t> live_bytes{0};
+static std::atomic<uint64_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        live_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// Kept out of line: once inlined, GCC sees free() on memory from a new
+// expression and warns -Wmismatched-new-delete at every delete site.
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    if (ptr) {
+        live_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+    }
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+// The table as it was before readers could share the lock: a heap node per
+// entry chained off a bucket array, behind one exclusive mutex. Only what
+// the benchmarks call is kept.
+template<typename K, typename V>
+class legacy_hash_table {
+private:
+    struct node {
+        K key;
+        V value;
+        node* next;
+        node(const K& k, const V& v) : key(k), value(v), next(nullptr) {}
+    };
+
+    std::vector<node*> buckets;
+    size_t count;
+    mutable std::mutex mutex_lock;
+
+    size_t hash_function(const K& key) const {
+        return std::hash<K>()(key) % buckets.size();
+    }
+
+    void resize() {
+        std::vector<node*> old_buckets(buckets.size() * 2, nullptr);
+        old_buckets.swap(buckets);
+        for (node* current : old_buckets) {
+            while (current) {
+                node* next_node = current->next;
+                size_t index = hash_function(current->key);
+                current->next = buckets[index];
+                buckets[index] = current;
+                current = next_node;
+            }
+        }
+    }
+
+public:
+    explicit legacy_hash_table(size_t initial_capacity = 1024) : buckets(initial_capacity, nullptr), count(0) {}
+
+    ~legacy_hash_table() {
+        for (node* current : buckets) {
+            while (current) {
+                node* temp = current;
+                current = current->next;
+                delete temp;
+            }
+        }
+    }
+
+    bool insert(const K& key, const V& value) {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        if (static_cast<double>(count) / buckets.size() > 0.75) {
+            resize();
+        }
+        size_t index = hash_function(key);
+        for (node* current = buckets[index]; current; current = current->next) {
+            if (current->key == key) {
+                return false;
+            }
+        }
+        node* new_node = new node(key, value);
+        new_node->next = buckets[index];
+        buckets[index] = new_node;
+        count++;
+        return true;
+    }
+
+    bool find(const K& key, V& value) const {
+        std::lock_guard<std::mutex> lock(mutex_lock);
+        for (node* current = buckets[hash_function(key)]; current; current = current->next) {
+            if (current->key == key) {
+                value = current->value;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static std::string user_key(uint64_t i) {
+    return "player_" + std::to_string(i);
+}
+
+// Each thread looks up existing keys for duration_ms; returns lookups/s.
+template<typename Table>
+double measure_reads(Table& table, uint64_t key_count, int thread_count, int duration_ms) {
+    std::vector<std::string> keys;
+    keys.reserve(key_count);
+    for (uint64_t i = 0; i < key_count; i++) {
+        keys.push_back(user_key(i));
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> found{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < thread_count; t++) {
+        readers.emplace_back([&, t]() {
+            uint64_t done = 0;
+            uint64_t hits = 0;
+            size_t index = (t * 7919) % key_count;
+            while (running) {
+                uint64_t value;
+                if (table.find(keys[index], value)) {
+                    hits++;
+                }
+                index = (index + 7919) % key_count;
+                done++;
+            }
+            lookups += done;
+            found += hits;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    running = false;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    if (found != lookups) {
+        std::cout << "unexpected missing key" << std::endl;
+    }
+    return lookups.load() * 1000.0 / duration_ms;
+}
+
+void bench_concurrent_reads(uint64_t key_count, int duration_ms) {
+    std::cout << "Concurrent reads (" << key_count << " keys, " << std::thread::hardware_concurrency()
+              << " cores, " << duration_ms << "ms per run)" << std::endl;
+
+    legacy_hash_table<std::string, uint64_t> legacy;
+    hash_table<std::string, uint64_t> current;
+    for (uint64_t i = 0; i < key_count; i++) {
+        legacy.insert(user_key(i), i);
+        current.insert(user_key(i), i);
+    }
+
+    for (int thread_count : {1, 4, 16, 32}) {
+        double legacy_rate = measure_reads(legacy, key_count, thread_count, duration_ms);
+        double current_rate = measure_reads(current, key_count, thread_count, duration_ms);
+        std::cout << "  " << thread_count << " threads: exclusive mutex " << legacy_rate / 1e6
+                  << " M lookups/s, shared mutex " << current_rate / 1e6 << " M lookups/s ("
+                  << current_rate / legacy_rate << "x)" << std::endl;
+    }
+}
+
+// Single-threaded: build the table, then time lookups of present keys in
+// random order and of absent ones.
+template<typename Table>
+void measure_lookups(const std::string& name, uint64_t key_count, int lookup_count) {
+    std::vector<std::string> keys;
+    keys.reserve(key_count);
+    for (uint64_t i = 0; i < key_count; i++) {
+        keys.push_back(user_key(i));
+    }
+    std::vector<uint32_t> order(lookup_count);
+    std::mt19937 gen(7);
+    for (uint32_t& index : order) {
+        index = gen() % key_count;
+    }
+    std::vector<std::string> missing;
+    for (int i = 0; i < 1000; i++) {
+        missing.push_back("absent_" + std::to_string(i));
+    }
+    
+    int64_t bytes_before = live_bytes.load();
+    Table* table = new Table(1024);
+    for (uint64_t i = 0; i < key_count; i++) {
+        table->insert(keys[i], i);
+    }
+    double bytes_per_entry = static_cast<double>(live_bytes.load() - bytes_before) / key_count;
+    
+    uint64_t sink = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t index : order) {
+        uint64_t value = 0;
+        table->find(keys[index], value);
+        sink += value;
+    }
+    auto after_hits = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < lookup_count; i++) {
+        uint64_t value = 0;
+        sink += table->find(missing[i % missing.size()], value);
+    }
+    auto after_misses = std::chrono::high_resolution_clock::now();
+    delete table;
+    
+    double hit_ns = std::chrono::duration<double, std::nano>(after_hits - start).count() / lookup_count;
+    double miss_ns = std::chrono::duration<double, std::nano>(after_misses - after_hits).count() / lookup_count;
+    std::cout << "  " << name << ": hit " << hit_ns << " ns, miss " << miss_ns << " ns, "
+              << bytes_per_entry << " bytes/entry" << (sink ? "" : " ") << std::endl;
+}
+
+void bench_lookup_latency(uint64_t key_count, int lookup_count) {
+    std::cout << "Lookup latency (" << key_count << " users, " << lookup_count << " lookups)" << std::endl;
+    measure_lookups<legacy_hash_table<std::string, uint64_t>>("chained", key_count, lookup_count);
+    measure_lookups<hash_table<std::string, uint64_t>>("open addressing", key_count, lookup_count);
+}
+
+// Times every insert while growing from an empty table. A reader waiting on
+// the lock waits as long as the insert holding it, so the tail here is the
+// stall a lookup sees when a registration crosses a growth threshold.
+template<typename Table>
+void measure_insert_latency(const std::string& name, uint64_t key_count) {
+    std::vector<std::string> keys;
+    keys.reserve(key_count);
+    for (uint64_t i = 0; i < key_count; i++) {
+        keys.push_back(user_key(i));
+    }
+    std::vector<double> latencies;
+    latencies.reserve(key_count);
+    
+    Table* table = new Table(1024);
+    for (uint64_t i = 0; i < key_count; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        table->insert(keys[i], i);
+        auto end = std::chrono::high_resolution_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    delete table;
+    
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+    std::cout << "  " << name << ": p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+              << " us, p99.9 " << percentile(0.999) << " us, max " << latencies.back() << " us" << std::endl;
+}
+
+void bench_insert_tail_latency(uint64_t key_count) {
+    std::cout << "Insert latency while growing to " << key_count << " users" << std::endl;
+    measure_insert_latency<legacy_hash_table<std::string, uint64_t>>("rehash at once", key_count);
+    measure_insert_latency<hash_table<std::string, uint64_t>>("incremental", key_count);
+}
+
+// The table work behind GET /user/me (resolve the bearer token, read the
+// caller's profile) and POST /match/record (resolve the token, update both
+// players), done by copying values out and back as the handlers used to
+// and by visiting them in place.
+void bench_request_allocations(uint64_t user_count, int iterations) {
+    std::cout << "Allocations per request (" << user_count << " users, " << iterations << " requests)" << std::endl;
+    
+    hash_table<std::string, user_data> users;
+    hash_table<std::string, session_data> sessions;
+    std::vector<std::string> names;
+    std::vector<std::string> headers;
+    for (uint64_t i = 0; i < user_count; i++) {
+        user_data user{};
+        user.user_id = i;
+        user.username = user_key(i);
+        user.salt = std::string(32, 'a' + i % 26);
+        user.password_hash = std::string(64, 'f');
+        user.elo_rating = 1600;
+        users.insert(user.username, user);
+        names.push_back(user.username);
+        
+        session_data session{};
+        session.token = std::to_string(i) + "_1792219536610";
+        session.user_id = i;
+        session.is_valid = true;
+        sessions.insert(session.token, session);
+        headers.push_back("Bearer " + session.token);
+    }
+    
+    uint64_t sink = 0;
+    auto time_requests = [&](const std::string& name, auto request) {
+        uint64_t allocations_before = allocation_count.load();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            request(i % user_count, (i * 7919 + 1) % user_count);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double allocations = static_cast<double>(allocation_count.load() - allocations_before) / iterations;
+        std::cout << "  " << name << ": " << std::chrono::duration<double, std::nano>(end - start).count() / iterations
+                  << " ns/request, " << allocations << " allocations/request" << std::endl;
+    };
+    
+    time_requests("/user/me, copying", [&](uint64_t caller, uint64_t) {
+        std::string token(std::string_view(headers[caller]).substr(7));
+        session_data session;
+        user_data user;
+        if (sessions.find(token, session) && users.find(names[session.user_id], user)) {
+            sink += user.elo_rating;
+        }
+    });
+    time_requests("/user/me, in place", [&](uint64_t caller, uint64_t) {
+        std::string_view token = std::string_view(headers[caller]).substr(7);
+        uint64_t user_id = 0;
+        if (sessions.with_value(token, [&user_id](const session_data& session) { user_id = session.user_id; })) {
+            users.with_value(names[user_id], [&sink](const user_data& user) { sink += user.elo_rating; });
+        }
+    });
+    time_requests("/match/record, copying", [&](uint64_t caller, uint64_t opponent) {
+        std::string token(std::string_view(headers[caller]).substr(7));
+        session_data session;
+        if (!sessions.find(token, session)) {
+            return;
+        }
+        for (uint64_t player : {session.user_id, opponent}) {
+            user_data user;
+            if (users.find(names[player], user)) {
+                user.total_matches += 1;
+                users.update(names[player], user);
+            }
+        }
+    });
+    time_requests("/match/record, in place", [&](uint64_t caller, uint64_t opponent) {
+        std::string_view token = std::string_view(headers[caller]).substr(7);
+        uint64_t user_id = 0;
+        if (!sessions.with_value(token, [&user_id](const session_data& session) { user_id = session.user_id; })) {
+            return;
+        }
+        for (uint64_t player : {user_id, opponent}) {
+            users.modify(names[player], [](user_data& user) { user.total_matches += 1; });
+        }
+    });
+    if (sink == 0) {
+        std::cout << "unexpected missing user" << std::endl;
+    }
+}
+
+int main() {
+    // Just under and just over the point where the open table doubles.
+    bench_lookup_latency(900000, 2000000);
+    bench_lookup_latency(1000000, 2000000);
+    bench_insert_tail_latency(1000000);
+    bench_concurrent_reads(100000, 300);
+    bench_request_allocations(100000, 1000000);
+    return 0;
+}
@@ -4,8 +4,12 @@
 #include <chrono>
 #include <random>
 #include <cstdint>
+#include <atomic>
+#include <cassert>
 
 #include "../server/src/api/game_state.hpp"
+#include "../server/src/api/match_waitlist.hpp"
+#include "../server/src/api/response_cache.hpp"
 
 void stress_test_user_operations(game_state& game, int user_count) {
     std::cout << "Starting stress test with " << user_count << " users..." << std::endl;
@@ -52,10 +56,284 @@ void stress_test_user_operations(game_state& game, int user_count) {
     std::cout << "Stress test completed!" << std::endl;
 }
 
+// Parked waits are answered exactly once: paired players by deliver() from
+// concurrent threads, the rest by the expiry thread.
+void stress_test_match_waitlist(int player_count) {
+    std::cout << "Starting match waitlist test with " << player_count << " players..." << std::endl;
+    
+    const int paired_count = player_count * 4 / 5;
+    std::vector<std::atomic<int>> answers(player_count);
+    std::vector<std::atomic<uint64_t>> opponents(player_count);
+    std::atomic<int> timeouts{0};
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        match_waitlist waitlist(200);
+        for (int i = 0; i < player_count; i++) {
+            waitlist.park(i, [&, i](bool matched, uint64_t opponent_id) {
+                answers[i]++;
+                opponents[i] = opponent_id;
+                if (!matched) timeouts++;
+            });
+        }
+        assert(waitlist.parked_count() == static_cast<size_t>(player_count));
+        
+        std::vector<std::thread> matchmakers;
+        for (int t = 0; t < 4; t++) {
+            matchmakers.emplace_back([&, t]() {
+                for (int i = t * 2; i < paired_count; i += 8) {
+                    waitlist.deliver(i, i + 1);
+                    waitlist.deliver(i + 1, i);
+                }
+            });
+        }
+        for (auto& thread : matchmakers) {
+            thread.join();
+        }
+        
+        // A result for a player between waits answers their next park at once.
+        waitlist.deliver(player_count, 7);
+        bool early = false;
+        waitlist.park(player_count, [&](bool matched, uint64_t opponent_id) { early = matched && opponent_id == 7; });
+        assert(early);
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        assert(waitlist.parked_count() == 0);
+    }
+    
+    for (int i = 0; i < player_count; i++) {
+        assert(answers[i] == 1);
+        if (i < paired_count) {
+            assert(opponents[i] == static_cast<uint64_t>(i ^ 1));
+        }
+    }
+    assert(timeouts == player_count - paired_count);
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+    std::cout << "Paired " << paired_count << " players, timed out " << timeouts.load() << " in "
+              << elapsed.count() << "ms" << std::endl;
+}
+
+// A view's version moves exactly when what it shows may have changed.
+void test_resource_versions(game_state& game) {
+    std::cout << "Testing resource versions..." << std::endl;
+    
+    std::string suffix = std::to_string(time_utils::get_current_timestamp_ms());
+    std::string alice_token, bob_token;
+    assert(game.register_user("etag_a_" + suffix, "pw") && game.register_user("etag_b_" + suffix, "pw"));
+    assert(game.login_user("etag_a_" + suffix, "pw", alice_token));
+    assert(game.login_user("etag_b_" + suffix, "pw", bob_token));
+    uint64_t alice = game.get_user_id_by_username("etag_a_" + suffix);
+    uint64_t bob = game.get_user_id_by_username("etag_b_" + suffix);
+    
+    auto version = [&game](const std::string& token, int sections) {
+        uint64_t value = 0;
+        assert(game.get_dashboard_version(token, sections, value));
+        return value;
+    };
+    const int friends = dashboard_snapshot::friends_section;
+    const int pending = dashboard_snapshot::pending_section;
+    const int profile = dashboard_snapshot::user_section;
+    uint64_t unused = 0;
+    assert(!game.get_dashboard_version("bogus", profile, unused));
+    
+    uint64_t alice_pending = version(alice_token, pending);
+    assert(version(alice_token, pending) == alice_pending);
+    assert(game.send_friend_request(bob, alice));
+    assert(version(alice_token, pending) != alice_pending);
+    
+    // A second request to the same user joins the first rather than being
+    // dropped, and accepting one leaves the other pending.
+    assert(game.register_user("etag_c_" + suffix, "pw"));
+    uint64_t carol = game.get_user_id_by_username("etag_c_" + suffix);
+    assert(game.send_friend_request(carol, alice));
+    assert(!game.send_friend_request(carol, alice));
+    std::vector<uint64_t> senders;
+    game.get_pending_friend_requests(alice, senders);
+    assert(senders.size() == 2);
+    
+    uint64_t alice_friends = version(alice_token, friends);
+    uint64_t alice_profile = version(alice_token, profile);
+    assert(game.accept_friend_request(alice, bob));
+    assert(version(alice_token, friends) != alice_friends);
+    game.get_pending_friend_requests(alice, senders);
+    assert(senders.size() == 1 && senders[0] == carol);
+    assert(game.reject_friend_request(alice, carol));
+    game.get_pending_friend_requests(alice, senders);
+    assert(senders.empty());
+    
+    // Bob's rating shows in Alice's friends list but not her profile.
+    alice_friends = version(alice_token, friends);
+    uint64_t users = game.get_users_version();
+    uint64_t bob_profile = game.get_profile_version(bob);
+    assert(game.update_user_elo(bob, 10));
+    assert(version(alice_token, friends) != alice_friends);
+    assert(version(alice_token, profile) == alice_profile);
+    assert(game.get_users_version() != users && game.get_profile_version(bob) != bob_profile);
+    
+    alice_friends = version(alice_token, friends);
+    game.note_presence_change(bob);
+    assert(version(alice_token, friends) != alice_friends);
+    
+    std::cout << "Resource version tests passed!" << std::endl;
+}
+
+// Readers racing a writer that bumps the version: each version is built at
+// most once, and nobody is handed a body older than the version they asked
+// for.
+void stress_test_response_cache(int reader_count, int rounds) {
+    std::cout << "Starting response cache test with " << reader_count << " readers..." << std::endl;
+    
+    assert(response_cache::make_key("/users/search", "q=bo&limit=5") ==
+           response_cache::make_key("/users/search", "limit=5&&q=bo"));
+    assert(response_cache::make_key("/leaderboard", "") == "/leaderboard");
+    
+    response_cache small(2);
+    small.get("a", 1, []() { return std::string("A"); });
+    small.get("b", 1, []() { return std::string("B"); });
+    assert(*small.get("a", 1, []() { return std::string("stale"); }) == "A");
+    small.get("c", 1, []() { return std::string("C"); });
+    assert(small.size() == 2);
+    assert(*small.get("b", 1, []() { return std::string("B2"); }) == "B2");  // least recent, evicted
+    
+    response_cache zipped(4, 6, 64);
+    const std::string board(4096, 'x');
+    response_cache::body_ptr gzip_body;
+    zipped.get("big", 1, [&]() { return board; }, gzip_body);
+    std::string inflated;
+    assert(gzip_body && gzip_body->size() < board.size());
+    assert(gzip_utils::decompress(*gzip_body, inflated) && inflated == board);
+    response_cache::body_ptr first = gzip_body;
+    zipped.get("big", 1, [&]() { return std::string("rebuilt"); }, gzip_body);
+    assert(gzip_body == first);  // hits share the stored encoding
+    zipped.get("tiny", 1, []() { return std::string("{}"); }, gzip_body);
+    assert(!gzip_body);
+    
+    response_cache cache;
+    std::atomic<uint64_t> version{1};
+    std::atomic<int> builds{0};
+    std::atomic<bool> stale{false};
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    std::vector<std::thread> readers;
+    for (int r = 0; r < reader_count; r++) {
+        readers.emplace_back([&]() {
+            for (int i = 0; i < rounds; i++) {
+                uint64_t wanted = version.load();
+                response_cache::body_ptr body = cache.get("/leaderboard", wanted, [&]() {
+                    builds++;
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    return std::to_string(version.load());
+                });
+                if (std::stoull(*body) < wanted) {
+                    stale = true;
+                }
+            }
+        });
+    }
+    std::thread writer([&]() {
+        for (int i = 0; i < 50; i++) {
+            version++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    writer.join();
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    
+    assert(!stale);
+    assert(builds <= static_cast<int>(version.load()));
+    assert(cache.hits() + cache.misses() + cache.coalesced() == static_cast<uint64_t>(reader_count * rounds));
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+    std::cout << "Served " << reader_count * rounds << " lookups with " << builds.load() << " builds in "
+              << elapsed.count() << "ms " << cache.stats_json() << std::endl;
+}
+
+// Read-mostly traffic over every domain while a steady trickle of logins
+// hashes passwords and saves users alongside. Throughput should grow with
+// threads up to the core count.
+void benchmark_domain_locks(game_state& game, int user_count, int duration_ms) {
+    std::cout << "Benchmarking game_state with " << std::thread::hardware_concurrency() << " cores..." << std::endl;
+    
+    std::vector<std::string> tokens;
+    std::vector<uint64_t> user_ids;
+    for (int i = 0; i < user_count; i++) {
+        std::string token;
+        if (game.login_user("user_" + std::to_string(i), "pass_" + std::to_string(i), token)) {
+            tokens.push_back(token);
+            user_ids.push_back(game.get_user_id_by_username("user_" + std::to_string(i)));
+        }
+    }
+    assert(!tokens.empty());
+    
+    double single_thread_rate = 0;
+    for (int thread_count = 1; thread_count <= 8; thread_count *= 2) {
+        std::atomic<bool> running{true};
+        std::atomic<uint64_t> operations{0};
+        std::atomic<uint64_t> logins{0};
+        
+        std::thread login_thread([&]() {
+            std::string token;
+            for (int i = 0; running; i = (i + 1) % user_count) {
+                game.login_user("user_" + std::to_string(i), "pass_" + std::to_string(i), token);
+                logins++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        });
+        
+        std::vector<std::thread> workers;
+        for (int t = 0; t < thread_count; t++) {
+            workers.emplace_back([&, t]() {
+                std::mt19937 gen(t);
+                std::uniform_int_distribution<size_t> pick(0, tokens.size() - 1);
+                uint64_t done = 0;
+                while (running) {
+                    size_t index = pick(gen);
+                    uint64_t user_id = 0;
+                    user_data user;
+                    std::vector<uint64_t> ids;
+                    std::vector<match_data> history;
+                    uint64_t version = 0;
+                    switch (done % 6) {
+                        case 0: game.verify_session(tokens[index], user_id); break;
+                        case 1: game.get_user(user_ids[index], user); break;
+                        case 2: game.get_friends(user_ids[index], ids); break;
+                        case 3: game.get_pending_friend_requests(user_ids[index], ids); break;
+                        case 4: game.get_match_history(user_ids[index], history); break;
+                        case 5: game.get_dashboard_version(tokens[index], 31, version); break;
+                    }
+                    done++;
+                }
+                operations += done;
+            });
+        }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+        running = false;
+        for (auto& thread : workers) {
+            thread.join();
+        }
+        login_thread.join();
+        
+        assert(operations > 0);
+        double rate = operations.load() * 1000.0 / duration_ms;
+        if (thread_count == 1) {
+            single_thread_rate = rate;
+        }
+        std::cout << thread_count << " threads: " << static_cast<uint64_t>(rate) << " ops/s ("
+                  << rate / single_thread_rate << "x), " << logins.load() << " logins alongside" << std::endl;
+    }
+}
+
 int main() {
     game_state game;
     
     stress_test_user_operations(game, 1000);
+    test_resource_versions(game);
+    stress_test_response_cache(8, 2000);
+    stress_test_match_waitlist(1000);
+    benchmark_domain_locks(game, 1000, 250);
     
     return 0;
 }
@@ -0,0 +1,321 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <fstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../server/src/network/request_parser.hpp"
+#include "../server/src/network/router.hpp"
+#include "../server/src/network/response_builder.hpp"
+#include "../server/src/network/http_response.hpp"
+#include "../server/src/network/http_server.hpp"
+
+static std::atomic<uint64_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// Kept out of line: once inlined, GCC sees free() on memory from a new
+// expression and warns -Wmismatched-new-delete at every delete site.
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+static const std::string sample_request =
+    "POST /match/record HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+    "Accept: */*\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Content-Type: application/json\r\n"
+    "Authorization: Bearer 12_1792219536610\r\n"
+    "Origin: http://localhost:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Length: 32\r\n"
+    "\r\n"
+    "{\"opponent_id\":7,\"winner_id\":12}";
+
+struct bench_result {
+    double ns_per_request;
+    double allocations_per_request;
+};
+
+template<typename Func>
+bench_result run_bench(int iterations, Func body) {
+    uint64_t allocations_before = allocation_count.load();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        body();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    uint64_t allocations = allocation_count.load() - allocations_before;
+    double elapsed_ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return {elapsed_ns / iterations, static_cast<double>(allocations) / iterations};
+}
+
+void print_result(const std::string& name, const bench_result& result) {
+    std::cout << "  " << name << ": " << result.ns_per_request << " ns/request, "
+              << result.allocations_per_request << " allocations/request" << std::endl;
+}
+
+void bench_request_parsing(int iterations) {
+    std::cout << "Request parsing (" << iterations << " requests, "
+              << sample_request.size() << " bytes each)" << std::endl;
+
+    size_t sink = 0;
+
+    print_result("legacy stringstream parse", run_bench(iterations, [&]() {
+        http_request req = request_parser::parse(sample_request);
+        sink += req.body.size();
+    }));
+
+    request_parser parser;
+    print_result("incremental parse + owned request", run_bench(iterations, [&]() {
+        parser.feed(sample_request.data(), sample_request.size());
+        http_request req = parser.to_request();
+        sink += req.body.size();
+        parser.reset();
+    }));
+
+    print_result("incremental parse + request view", run_bench(iterations, [&]() {
+        parser.feed(sample_request.data(), sample_request.size());
+        http_request_view req = parser.to_view();
+        sink += req.body.size() + req.header("Authorization").size();
+        parser.reset();
+    }));
+
+    if (sink == 0) {
+        std::cout << "unexpected empty parse" << std::endl;
+    }
+}
+
+static const char* registered_routes[][2] = {
+    {"GET", "/health"}, {"GET", "/metrics"}, {"POST", "/auth/register"}, {"POST", "/auth/login"},
+    {"POST", "/auth/logout"}, {"GET", "/user/me"}, {"GET", "/leaderboard"}, {"GET", "/users/search"},
+    {"GET", "/users/:id"}, {"POST", "/match/queue"}, {"POST", "/match/find"}, {"GET", "/match/history"},
+    {"POST", "/match/record"}, {"POST", "/friends/request"}, {"POST", "/friends/accept"},
+    {"POST", "/friends/reject"}, {"GET", "/friends/pending"}, {"GET", "/friends/list"},
+    {"GET", "/friends/recommendations"}
+};
+
+void bench_routing(int iterations) {
+    typedef std::function<std::string(const http_request_view&)> handler_type;
+    size_t route_count = sizeof(registered_routes) / sizeof(registered_routes[0]);
+
+    std::cout << "Routing (" << iterations << " lookups over " << route_count << " routes)" << std::endl;
+
+    // What http_server did before: a locked map keyed by "METHOD path".
+    std::unordered_map<std::string, handler_type> legacy_routes;
+    std::mutex legacy_mutex;
+    router<handler_type> routes;
+    for (size_t i = 0; i < route_count; i++) {
+        handler_type handler = [](const http_request_view&) { return std::string(); };
+        legacy_routes[std::string(registered_routes[i][0]) + " " + registered_routes[i][1]] = handler;
+        routes.add(registered_routes[i][0], registered_routes[i][1], handler);
+    }
+    routes.freeze();
+
+    std::vector<std::pair<std::string, std::string>> lookups = {
+        {"GET", "/user/me"}, {"GET", "/leaderboard"}, {"POST", "/match/record"},
+        {"GET", "/friends/recommendations"}, {"GET", "/css/main.css"}, {"POST", "/auth/login"}
+    };
+
+    size_t hits = 0;
+    print_result("locked unordered_map with string key", run_bench(iterations, [&]() {
+        for (const auto& lookup : lookups) {
+            std::lock_guard<std::mutex> lock(legacy_mutex);
+            std::string key = lookup.first + " " + lookup.second;
+            if (legacy_routes.find(key) != legacy_routes.end()) hits++;
+        }
+    }));
+
+    http_request_view req;
+    print_result("frozen segment trie", run_bench(iterations, [&]() {
+        for (const auto& lookup : lookups) {
+            if (routes.match(lookup.first, lookup.second, req)) hits++;
+        }
+    }));
+
+    if (hits == 0) {
+        std::cout << "unexpected routing misses" << std::endl;
+    }
+    std::cout << "  (figures are per batch of " << lookups.size() << " lookups)" << std::endl;
+}
+
+void bench_response_building(int iterations) {
+    std::string sample_body = "{\"leaderboard\":[";
+    for (int i = 1; i <= 8; i++) {
+        sample_body += "{\"rank\":" + std::to_string(i) + ",\"user_id\":" + std::to_string(i) +
+                       ",\"username\":\"player" + std::to_string(i) + "\",\"elo\":1600,\"matches\":3},";
+    }
+    sample_body.back() = ']';
+    sample_body += "}";
+
+    std::cout << "Response building (" << iterations << " responses, "
+              << sample_body.size() << " byte body)" << std::endl;
+
+    // Both variants start from a fresh body string, as a handler returns one.
+    size_t sink = 0;
+    print_result("response_builder::build concatenation", run_bench(iterations, [&]() {
+        std::string body = sample_body;
+        std::string response = response_builder::build(200, body, "application/json");
+        sink += response.size();
+    }));
+
+    print_result("http_response + gather", run_bench(iterations, [&]() {
+        http_response response = std::string(sample_body);
+        response.prepare(true);
+        struct iovec parts[http_response::max_parts];
+        int count = response.gather(parts, 0);
+        sink += count + response.total_size();
+    }));
+
+    if (sink == 0) {
+        std::cout << "unexpected empty response" << std::endl;
+    }
+}
+
+static int connect_local(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Reads one response (headers plus Content-Length bytes of body).
+static bool read_response(int fd, std::string& buffer) {
+    buffer.clear();
+    char chunk[16384];
+    size_t needed = std::string::npos;
+    while (needed == std::string::npos || buffer.size() < needed) {
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(chunk, received);
+        size_t header_end = buffer.find("\r\n\r\n");
+        if (needed == std::string::npos && header_end != std::string::npos) {
+            size_t length_at = buffer.find("Content-Length: ");
+            size_t length = length_at < header_end ? std::strtoul(buffer.c_str() + length_at + 16, nullptr, 10) : 0;
+            needed = header_end + 4 + length;
+        }
+    }
+    return true;
+}
+
+// Runs the real server on one reactor with each I/O backend and drives it
+// with keep-alive clients alternating a worker-dispatched route and a static
+// asset, so both the completion path and the reactor-only path are covered.
+void bench_server_backends(int clients, int duration_ms) {
+    char site[] = "/tmp/bench_site_XXXXXX";
+    if (!mkdtemp(site)) {
+        std::cout << "could not create static dir" << std::endl;
+        return;
+    }
+    std::string asset_path = std::string(site) + "/asset.css";
+    std::ofstream(asset_path) << std::string(4096, 'a');
+
+    std::cout << "Server backends (" << clients << " keep-alive clients, " << duration_ms << " ms each)" << std::endl;
+    const char* backends[] = {"epoll", "io_uring"};
+    for (int backend = 0; backend < 2; backend++) {
+        http_server_config config;
+        config.reactor_threads = 1;
+        config.use_io_uring = backend == 1;
+        config.max_requests_per_connection = UINT32_MAX;
+        int port = 18080 + backend;
+        http_server server(port, site, config);
+        server.register_route("GET", "/health", [](const http_request_view&) {
+            return std::string("{\"status\":\"ok\"}");
+        });
+        std::thread server_thread([&server]() { server.start(); });
+        for (int i = 0; i < 100 && !server.is_running(); i++) {
+            usleep(10000);
+        }
+
+        std::atomic<bool> measuring{true};
+        std::mutex latencies_mutex;
+        std::vector<double> latencies_us;
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int c = 0; c < clients; c++) {
+            threads.emplace_back([&, c]() {
+                int fd = connect_local(port);
+                if (fd < 0) return;
+                static const std::string requests[] = {
+                    "GET /health HTTP/1.1\r\nHost: bench\r\n\r\n",
+                    "GET /asset.css HTTP/1.1\r\nHost: bench\r\n\r\n"
+                };
+                std::vector<double> local;
+                std::string buffer;
+                for (int i = c; measuring; i++) {
+                    const std::string& request = requests[i % 2];
+                    auto sent_at = std::chrono::steady_clock::now();
+                    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) < 0 || !read_response(fd, buffer)) {
+                        break;
+                    }
+                    local.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent_at).count());
+                }
+                close(fd);
+                std::lock_guard<std::mutex> lock(latencies_mutex);
+                latencies_us.insert(latencies_us.end(), local.begin(), local.end());
+            });
+        }
+        usleep(duration_ms * 1000);
+        measuring = false;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        server.stop();
+        server_thread.join();
+
+        std::sort(latencies_us.begin(), latencies_us.end());
+        size_t count = latencies_us.size();
+        std::cout << "  " << backends[backend] << ": " << static_cast<uint64_t>(count / elapsed_s) << " requests/s, p50 "
+                  << (count ? latencies_us[count / 2] : 0) << " us, p99 "
+                  << (count ? latencies_us[count * 99 / 100] : 0) << " us" << std::endl;
+    }
+    unlink(asset_path.c_str());
+    rmdir(site);
+}
+
+int main() {
+    bench_request_parsing(200000);
+    bench_routing(200000);
+    bench_response_building(200000);
+    bench_server_backends(16, 2000);
+    return 0;
+}
@@ -0,0 +1,722 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <future>
+#include <chrono>
+
+#include "../server/src/network/request_parser.hpp"
+#include "../server/src/network/router.hpp"
+#include "../server/src/network/static_cache.hpp"
+#include "../server/src/network/http_response.hpp"
+#include "../server/src/network/websocket.hpp"
+#include "../server/src/network/channel_registry.hpp"
+#include "../server/src/network/rate_limiter.hpp"
+#include "../server/src/network/http_server.hpp"
+
+void test_request_parser_partial_reads() {
+    std::cout << "Testing request_parser partial reads..." << std::endl;
+
+    std::string body = "{\"username\":\"a\",\"x\":\"bcd\"}";
+    std::string raw = "POST /auth/login HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                      std::to_string(body.size()) + "\r\n\r\n" + body;
+
+    request_parser parser;
+    std::string buffer;
+    size_t header_size = raw.size() - body.size();
+    for (size_t i = 0; i < raw.size() - 1; i++) {
+        buffer += raw[i];
+        assert(parser.feed(buffer.data(), buffer.size()) == request_parser::need_more);
+        // The server's header and body timeouts hinge on this.
+        assert(parser.reading_body() == (buffer.size() >= header_size));
+    }
+    buffer += raw.back();
+    assert(parser.feed(buffer.data(), buffer.size()) == request_parser::complete);
+    assert(parser.consumed() == raw.size());
+    assert(!parser.reading_body());
+
+    http_request req = parser.to_request();
+    assert(req.method == "POST");
+    assert(req.path == "/auth/login");
+    assert(req.http_version == "HTTP/1.1");
+    assert(req.headers["Host"] == "localhost");
+    assert(req.body == body);
+
+    // Pausing at the body reports the headers once, before any body byte.
+    request_parser pausing(16384, 1024 * 1024, true);
+    std::string head = raw.substr(0, header_size);
+    assert(pausing.feed(head.data(), head.size()) == request_parser::headers_complete);
+    assert(pausing.reading_body());
+    http_request_view early = pausing.to_view();
+    assert(early.path == "/auth/login" && early.header("Host") == "localhost" && early.body.empty());
+    assert(pausing.feed(head.data(), head.size()) == request_parser::need_more);
+    assert(pausing.feed(raw.data(), raw.size()) == request_parser::complete);
+    assert(pausing.to_view().body == body);
+
+    request_parser pausing_bodyless(16384, 1024 * 1024, true);
+    std::string get = "GET /health HTTP/1.1\r\n\r\n";
+    assert(pausing_bodyless.feed(get.data(), get.size()) == request_parser::complete);
+
+    std::cout << "request_parser partial read tests passed!" << std::endl;
+}
+
+void test_request_parser_pipelined() {
+    std::cout << "Testing request_parser pipelining..." << std::endl;
+
+    std::string raw = "GET /health HTTP/1.1\r\n\r\nGET /leaderboard HTTP/1.1\r\nConnection: close\r\n\r\n";
+    request_parser parser;
+
+    assert(parser.feed(raw.data(), raw.size()) == request_parser::complete);
+    assert(parser.to_request().path == "/health");
+    size_t offset = parser.consumed();
+    parser.reset();
+
+    assert(parser.feed(raw.data() + offset, raw.size() - offset) == request_parser::complete);
+    http_request_view second = parser.to_view();
+    assert(second.path == "/leaderboard");
+    assert(!request_parser::wants_keep_alive(second));
+    assert(offset + parser.consumed() == raw.size());
+
+    std::cout << "request_parser pipelining tests passed!" << std::endl;
+}
+
+void test_request_parser_chunked() {
+    std::cout << "Testing request_parser chunked bodies..." << std::endl;
+
+    std::string raw = "POST /batch HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                      "5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\n";
+    request_parser parser;
+    std::string buffer;
+    request_parser::parse_status status = request_parser::need_more;
+    for (char c : raw) {
+        buffer += c;
+        status = parser.feed(buffer.data(), buffer.size());
+        if (status != request_parser::need_more) break;
+    }
+    assert(status == request_parser::complete);
+    assert(parser.consumed() == raw.size());
+    assert(parser.to_request().body == "hello, world");
+
+    std::cout << "request_parser chunked tests passed!" << std::endl;
+}
+
+void test_request_view() {
+    std::cout << "Testing http_request_view..." << std::endl;
+
+    std::string raw = "GET /users/search?q=ali HTTP/1.1\r\nauthorization: Bearer 1_abc\r\n"
+                      "Connection: keep-alive\r\n\r\n";
+    request_parser parser;
+    assert(parser.feed(raw.data(), raw.size()) == request_parser::complete);
+
+    http_request_view req = parser.to_view();
+    assert(req.method == "GET");
+    assert(req.target == "/users/search?q=ali");
+    assert(req.path == "/users/search");
+    assert(req.query == "q=ali");
+    assert(req.header_count == 2);
+    assert(req.header("Authorization") == "Bearer 1_abc");
+    assert(req.header("X-Missing").empty());
+    assert(req.body.empty());
+    assert(request_parser::wants_keep_alive(req));
+
+    // Views point into the caller's buffer rather than owning copies.
+    assert(req.path.data() >= raw.data() && req.path.data() < raw.data() + raw.size());
+
+    std::cout << "http_request_view tests passed!" << std::endl;
+}
+
+void test_request_copy() {
+    std::cout << "Testing http_request_copy..." << std::endl;
+
+    std::unique_ptr<http_request_copy> copy;
+    {
+        std::string raw = "POST /users/7/note?x=1 HTTP/1.1\r\nAuthorization: Bearer 7_t\r\n"
+                          "Content-Length: 4\r\n\r\nbody";
+        request_parser parser;
+        assert(parser.feed(raw.data(), raw.size()) == request_parser::complete);
+        http_request_view req = parser.to_view();
+        req.params[0] = {"id", req.path.substr(7, 1)};
+        req.param_count = 1;
+        copy.reset(new http_request_copy(req));
+        raw.assign(raw.size(), 'x');
+    }
+
+    // The source buffer is gone; the copy still reads the same request.
+    const http_request_view& req = copy->view();
+    assert(req.method == "POST");
+    assert(req.path == "/users/7/note");
+    assert(req.query == "x=1");
+    assert(req.header("Authorization") == "Bearer 7_t");
+    assert(req.body == "body");
+    assert(req.param("id") == "7");
+    assert(req.path.data() == req.target.data());
+
+    http_request_view empty;
+    http_request_copy blank(empty);
+    assert(blank.view().query.empty() && blank.view().header_count == 0);
+
+    std::cout << "http_request_copy tests passed!" << std::endl;
+}
+
+void test_offload() {
+    std::cout << "Testing offload_to..." << std::endl;
+
+    std::string raw = "GET /slow?n=2 HTTP/1.1\r\n\r\n";
+    request_parser parser;
+    assert(parser.feed(raw.data(), raw.size()) == request_parser::complete);
+
+    worker_pool pool(1, 1, 10000);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::thread::id handler_thread;
+    async_route_handler slow = offload_to(pool, [&](const http_request_view& req) {
+        released.wait();
+        handler_thread = std::this_thread::get_id();
+        std::string n;
+        req.query_param("n", n);
+        return http_response(200, "{\"n\":" + n + "}");
+    });
+
+    // The caller returns before the handler runs; the answer comes later
+    // through the sink, from the pool's thread.
+    std::promise<http_response> first;
+    slow(parser.to_view(), [&](http_response response) { first.set_value(std::move(response)); });
+    while (pool.queue_depth() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::promise<http_response> second;
+    slow(parser.to_view(), [&](http_response response) { second.set_value(std::move(response)); });
+
+    // The only thread is busy and the queue is full: refused at once.
+    std::promise<http_response> refused;
+    slow(parser.to_view(), [&](http_response response) { refused.set_value(std::move(response)); });
+    assert(refused.get_future().get().status() == 503);
+    raw.assign(raw.size(), 'x');
+
+    release.set_value();
+    http_response answer = first.get_future().get();
+    assert(answer.status() == 200 && answer.body() == "{\"n\":2}");
+    assert(second.get_future().get().status() == 200);
+    assert(handler_thread != std::this_thread::get_id());
+
+    async_route_handler failing = offload_to(pool, [](const http_request_view&) -> http_response {
+        throw std::runtime_error("boom");
+    });
+    std::promise<http_response> failed;
+    failing(parser.to_view(), [&](http_response response) { failed.set_value(std::move(response)); });
+    assert(failed.get_future().get().status() == 500);
+
+    std::cout << "offload_to tests passed!" << std::endl;
+}
+
+void test_request_parser_limits() {
+    std::cout << "Testing request_parser limits..." << std::endl;
+
+    request_parser small_headers(64, 1024);
+    std::string long_header = "GET / HTTP/1.1\r\nX-Padding: " + std::string(100, 'a') + "\r\n\r\n";
+    assert(small_headers.feed(long_header.data(), long_header.size()) == request_parser::failed);
+    assert(small_headers.error_status() == 431);
+
+    request_parser small_body(1024, 10);
+    std::string big_body = "POST / HTTP/1.1\r\nContent-Length: 11\r\n\r\n";
+    assert(small_body.feed(big_body.data(), big_body.size()) == request_parser::failed);
+    assert(small_body.error_status() == 413);
+
+    request_parser malformed;
+    std::string garbage = "NONSENSE\r\n\r\n";
+    assert(malformed.feed(garbage.data(), garbage.size()) == request_parser::failed);
+    assert(malformed.error_status() == 400);
+
+    request_parser bad_length;
+    std::string bad = "POST / HTTP/1.1\r\nContent-Length: abc\r\n\r\n";
+    assert(bad_length.feed(bad.data(), bad.size()) == request_parser::failed);
+    assert(bad_length.error_status() == 400);
+
+    request_parser conflicting_lengths;
+    std::string conflicting = "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 50\r\n\r\nhello";
+    assert(conflicting_lengths.feed(conflicting.data(), conflicting.size()) == request_parser::failed);
+    assert(conflicting_lengths.error_status() == 400);
+
+    request_parser repeated_length;
+    std::string repeated = "POST / HTTP/1.1\r\nContent-Length: 5\r\ncontent-length: 5\r\n\r\nhello";
+    assert(repeated_length.feed(repeated.data(), repeated.size()) == request_parser::complete);
+    assert(repeated_length.to_view().body == "hello");
+
+    request_parser length_and_chunked;
+    std::string both = "POST / HTTP/1.1\r\nContent-Length: 0\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n";
+    assert(length_and_chunked.feed(both.data(), both.size()) == request_parser::failed);
+    assert(length_and_chunked.error_status() == 400);
+
+    // Only a lone chunked coding frames a body; near misses are refused
+    // rather than guessed at.
+    for (const char* encoding : {"xchunked", "chunked, gzip", "gzip, chunked", "chunked, chunked", "identity", ""}) {
+        request_parser coded;
+        std::string raw = std::string("POST / HTTP/1.1\r\nTransfer-Encoding: ") + encoding + "\r\n\r\n0\r\n\r\n";
+        assert(coded.feed(raw.data(), raw.size()) == request_parser::failed);
+        assert(coded.error_status() == 400);
+    }
+    request_parser split_encoding;
+    std::string split = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: gzip\r\n\r\n0\r\n\r\n";
+    assert(split_encoding.feed(split.data(), split.size()) == request_parser::failed);
+    request_parser spaced_chunked;
+    std::string spaced = "POST / HTTP/1.1\r\nTransfer-Encoding: , CHUNKED \r\n\r\n5\r\nhello\r\n0\r\n\r\n";
+    assert(spaced_chunked.feed(spaced.data(), spaced.size()) == request_parser::complete);
+    assert(spaced_chunked.to_view().body == "hello");
+
+    std::cout << "request_parser limit tests passed!" << std::endl;
+}
+
+void test_router() {
+    std::cout << "Testing router..." << std::endl;
+
+    router<int> routes;
+    assert(routes.add("GET", "/leaderboard", 1));
+    assert(routes.add("GET", "/users/search", 2));
+    assert(routes.add("GET", "/users/:id", 3));
+    assert(routes.add("GET", "/users/:id/matches/:match_id", 4));
+    assert(routes.add("POST", "/users/:id", 5));
+    assert(routes.add("GET", "/", 6));
+    assert(routes.size() == 6);
+    int* found = routes.find("GET", "/users/:id");
+    assert(found && *found == 3);
+    *found = 30;
+    assert(routes.find("GET", "/users/:id/matches") == nullptr);
+    assert(routes.find("PUT", "/users/:id") == nullptr);
+    routes.freeze();
+    assert(!routes.add("GET", "/late", 7));
+    assert(routes.find("GET", "/leaderboard") == nullptr);
+
+    http_request_view req;
+    const int* handler = routes.match("GET", "/leaderboard", req);
+    assert(handler && *handler == 1);
+    assert(req.param_count == 0);
+
+    handler = routes.match("GET", "/users/search", req);
+    assert(handler && *handler == 2);
+
+    handler = routes.match("GET", "/users/42", req);
+    assert(handler && *handler == 30);
+    assert(req.param("id") == "42");
+
+    handler = routes.match("GET", "/users/42/matches/7/", req);
+    assert(handler && *handler == 4);
+    assert(req.param("id") == "42");
+    assert(req.param("match_id") == "7");
+
+    handler = routes.match("POST", "/users/9", req);
+    assert(handler && *handler == 5);
+
+    handler = routes.match("GET", "/", req);
+    assert(handler && *handler == 6);
+
+    assert(routes.match("GET", "/users/42/matches", req) == nullptr);
+    assert(routes.match("DELETE", "/users/42", req) == nullptr);
+    assert(routes.match("BREW", "/leaderboard", req) == nullptr);
+
+    std::cout << "router tests passed!" << std::endl;
+}
+
+void test_query_params() {
+    std::cout << "Testing query parameters..." << std::endl;
+
+    http_request_view req;
+    req.query = "q=magnus%20c&limit=10&flag&name=a+b";
+
+    std::string value;
+    assert(req.query_param("q", value) && value == "magnus c");
+    assert(req.query_param("limit", value) && value == "10");
+    assert(req.query_param("flag", value) && value.empty());
+    assert(req.query_param("name", value) && value == "a b");
+    assert(!req.query_param("missing", value));
+
+    std::cout << "query parameter tests passed!" << std::endl;
+}
+
+void test_static_cache() {
+    std::cout << "Testing static_cache..." << std::endl;
+
+    namespace fs = std::filesystem;
+    fs::path root = fs::temp_directory_path() / ("static_cache_test_" + std::to_string(getpid()));
+    fs::create_directories(root / "css");
+    std::ofstream(root / "index.html") << "<html></html>";
+    std::ofstream(root / "css" / "main.css") << "body{}";
+    std::ofstream(root / ".hidden") << "secret";
+
+    static_cache cache(root.string());
+    assert(cache.load());
+    std::shared_ptr<const static_asset_table> table = cache.snapshot();
+
+    const static_asset* index = table->find("/index.html");
+    assert(index && *index->content == "<html></html>");
+    assert(index->content_type == "text/html");
+    assert(table->find("/") && table->find("/")->etag == index->etag);
+
+    const static_asset* css = table->find("/css/main.css");
+    assert(css && css->content_type == "text/css");
+    assert(css->etag != index->etag);
+    assert(css->headers.find("Cache-Control: public") != std::string::npos);
+    assert(!table->find("/.hidden"));
+    assert(!table->find("/../etc/passwd"));
+
+    assert(static_cache::etag_matches(css->etag, css->etag));
+    assert(static_cache::etag_matches("\"x\", W/" + css->etag, css->etag));
+    assert(static_cache::etag_matches("*", css->etag));
+    assert(!static_cache::etag_matches("", css->etag));
+    assert(!static_cache::etag_matches(index->etag, css->etag));
+
+    // A reload swaps in a new table; the old snapshot stays intact.
+    std::ofstream(root / "css" / "main.css") << "body{color:red}";
+    assert(cache.load());
+    assert(cache.snapshot()->find("/css/main.css")->etag != css->etag);
+    assert(*css->content == "body{}");
+
+    // Compressible assets carry a smaller gzip variant with its own ETag.
+    std::ofstream(root / "app.js") << std::string(2000, ';');
+    assert(cache.load());
+    const static_asset* script = cache.snapshot()->find("/app.js");
+    assert(script && script->gzip_content && script->gzip_content->size() < script->size);
+    assert(script->gzip_etag != script->etag);
+    assert(script->gzip_headers.find("Content-Encoding: gzip") != std::string::npos);
+    std::string restored;
+    assert(gzip_utils::decompress(*script->gzip_content, restored) && restored == std::string(2000, ';'));
+    assert(!cache.snapshot()->find("/index.html")->gzip_content);
+    assert(cache.snapshot()->find("/index.html")->headers.find("Vary: Accept-Encoding") != std::string::npos);
+
+    // Files at or above the threshold are kept as an open descriptor.
+    std::ofstream(root / "big.bin") << std::string(4096, 'x');
+    static_cache small_threshold(root.string(), 1024);
+    assert(small_threshold.load());
+    const static_asset* big = small_threshold.snapshot()->find("/big.bin");
+    assert(big && big->file && !big->content && big->size == 4096);
+    assert(small_threshold.snapshot()->find("/index.html")->content);
+
+    // Large files are hashed and gzipped in chunks, with the same results
+    // as when they are held in memory.
+    std::string bundle;
+    for (int i = 0; i < 20000; i++) {
+        bundle += "var v" + std::to_string(i) + "=" + std::to_string(i * 7) + ";";
+    }
+    std::ofstream(root / "bundle.js") << bundle;
+    static_cache large_threshold(root.string(), 1 << 20);
+    assert(large_threshold.load() && small_threshold.load());
+    const static_asset* held = large_threshold.snapshot()->find("/bundle.js");
+    const static_asset* streamed = small_threshold.snapshot()->find("/bundle.js");
+    assert(held && held->content && streamed && streamed->file && !streamed->content);
+    assert(streamed->size == bundle.size() && streamed->etag == held->etag);
+    assert(streamed->gzip_content && streamed->gzip_etag == held->gzip_etag);
+    assert(gzip_utils::decompress(*streamed->gzip_content, restored) && restored == bundle);
+
+    fs::remove_all(root);
+    std::cout << "static_cache tests passed!" << std::endl;
+}
+
+void test_static_ranges() {
+    std::cout << "Testing static_cache ranges..." << std::endl;
+
+    uint64_t first = 0;
+    uint64_t last = 0;
+    assert(static_cache::parse_range("bytes=0-99", 1000, first, last) == static_cache::range_ok);
+    assert(first == 0 && last == 99);
+    assert(static_cache::parse_range("bytes=900-", 1000, first, last) == static_cache::range_ok);
+    assert(first == 900 && last == 999);
+    assert(static_cache::parse_range("bytes=-100", 1000, first, last) == static_cache::range_ok);
+    assert(first == 900 && last == 999);
+    assert(static_cache::parse_range("bytes=-5000", 1000, first, last) == static_cache::range_ok);
+    assert(first == 0 && last == 999);
+    assert(static_cache::parse_range("bytes=500-5000", 1000, first, last) == static_cache::range_ok);
+    assert(first == 500 && last == 999);
+
+    assert(static_cache::parse_range("bytes=1000-", 1000, first, last) == static_cache::range_unsatisfiable);
+    assert(static_cache::parse_range("bytes=-0", 1000, first, last) == static_cache::range_unsatisfiable);
+
+    assert(static_cache::parse_range("", 1000, first, last) == static_cache::no_range);
+    assert(static_cache::parse_range("bytes=0-1,5-6", 1000, first, last) == static_cache::no_range);
+    assert(static_cache::parse_range("items=0-1", 1000, first, last) == static_cache::no_range);
+    assert(static_cache::parse_range("bytes=9-3", 1000, first, last) == static_cache::no_range);
+    assert(static_cache::parse_range("bytes=a-3", 1000, first, last) == static_cache::no_range);
+
+    std::cout << "static_cache range tests passed!" << std::endl;
+}
+
+void test_gzip_utils() {
+    std::cout << "Testing gzip_utils..." << std::endl;
+
+    std::string json = "{\"leaderboard\":[";
+    for (int i = 0; i < 100; i++) {
+        json += "{\"rank\":" + std::to_string(i) + ",\"username\":\"player\",\"elo\":1600},";
+    }
+    json += "]}";
+
+    std::string compressed;
+    assert(gzip_utils::compress(json, 6, compressed));
+    assert(compressed.size() < json.size() / 4);
+    std::string restored;
+    assert(gzip_utils::decompress(compressed, restored) && restored == json);
+    assert(!gzip_utils::compress(json, 0, compressed));
+
+    assert(gzip_utils::accepts_gzip("gzip, deflate, br"));
+    assert(gzip_utils::accepts_gzip("br;q=1.0, GZIP;q=0.5"));
+    assert(gzip_utils::accepts_gzip("*"));
+    assert(!gzip_utils::accepts_gzip(""));
+    assert(!gzip_utils::accepts_gzip("deflate, br"));
+    assert(!gzip_utils::accepts_gzip("gzip;q=0, *"));
+    assert(!gzip_utils::accepts_gzip("*;q=0"));
+
+    assert(gzip_utils::is_compressible("application/json"));
+    assert(gzip_utils::is_compressible("text/css"));
+    assert(!gzip_utils::is_compressible("image/png"));
+
+    std::cout << "gzip_utils tests passed!" << std::endl;
+}
+
+void test_http_response() {
+    std::cout << "Testing http_response..." << std::endl;
+
+    http_response plain = std::string("{\"ok\":true}");
+    assert(plain.status() == 200);
+    assert(plain.content_type() == "application/json");
+    plain.add_header("ETag", "\"abc\"");
+    plain.prepare(true);
+    std::string wire = plain.to_string();
+    assert(wire.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    assert(wire.find("Content-Type: application/json\r\n") != std::string::npos);
+    assert(wire.find("Access-Control-Allow-Origin: *\r\n") != std::string::npos);
+    assert(wire.find("ETag: \"abc\"\r\n") != std::string::npos);
+    assert(wire.find("Content-Length: 11\r\n") != std::string::npos);
+    assert(wire.size() >= 13 && wire.compare(wire.size() - 13, 13, "\r\n{\"ok\":true}") == 0);
+    assert(wire.find("Connection: keep-alive\r\n\r\n") != std::string::npos);
+    assert(plain.total_size() == wire.size());
+
+    // Resuming from any offset yields exactly the unsent suffix.
+    for (size_t offset = 0; offset < wire.size(); offset += 7) {
+        struct iovec parts[http_response::max_parts];
+        int count = plain.gather(parts, offset);
+        std::string rest;
+        for (int i = 0; i < count; i++) {
+            rest.append(static_cast<const char*>(parts[i].iov_base), parts[i].iov_len);
+        }
+        assert(rest == wire.substr(offset));
+    }
+
+    http_response not_modified(304, std::string(), "text/css");
+    not_modified.prepare(false);
+    wire = not_modified.to_string();
+    assert(wire.compare(0, 25, "HTTP/1.1 304 Not Modified") == 0);
+    assert(wire.find("Content-Length") == std::string::npos);
+    assert(wire.find("Connection: close\r\n\r\n") != std::string::npos);
+
+    http_response custom(299, "x", "font/woff2");
+    custom.prepare(false);
+    wire = custom.to_string();
+    assert(wire.find("HTTP/1.1 299 Unknown\r\n") == 0);
+    assert(wire.find("Content-Type: font/woff2\r\n") != std::string::npos);
+
+    auto cached = std::make_shared<const std::string>("0123456789");
+    http_response slice = http_response::shared(206, cached, 2, 3, "text/plain");
+    assert(!slice.owns_body() && slice.body() == "234" && slice.content_length() == 3);
+    slice.prepare(true);
+    assert(slice.to_string().find("Content-Length: 3\r\n") != std::string::npos);
+
+    std::cout << "http_response tests passed!" << std::endl;
+}
+
+void test_websocket_handshake() {
+    std::cout << "Testing websocket handshake..." << std::endl;
+
+    auto hex = [](const std::string& raw) {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (unsigned char c : raw) {
+            out += digits[c >> 4];
+            out += digits[c & 15];
+        }
+        return out;
+    };
+    assert(hex(sha1::digest("")) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    assert(hex(sha1::digest("abc")) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    assert(hex(sha1::digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")) ==
+           "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    assert(hex(sha1::digest(std::string(1000, 'a'))) == "291e9a6c66994949b57ba5e650361e98fc36b1ba");
+
+    assert(base64::encode("") == "");
+    assert(base64::encode("f") == "Zg==");
+    assert(base64::encode("fo") == "Zm8=");
+    assert(base64::encode("foobar") == "Zm9vYmFy");
+    assert(base64::decoded_size("Zm9vYg==") == 4);
+    assert(base64::decoded_size("Zm9v=mFy") == -1);
+    assert(base64::decoded_size("Zm9") == -1);
+
+    // The example from RFC 6455 section 1.3.
+    assert(websocket::accept_key("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    std::string raw = "GET /ws?token=abc HTTP/1.1\r\nHost: localhost\r\nUpgrade: WebSocket\r\n"
+                      "Connection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 13\r\n"
+                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+    request_parser parser;
+    assert(parser.feed(raw.data(), raw.size()) == request_parser::complete);
+    http_request_view req = parser.to_view();
+    std::string_view key;
+    assert(websocket::handshake_key(req, key) && key == "dGhlIHNhbXBsZSBub25jZQ==");
+    std::string reply = websocket::handshake_response(key);
+    assert(reply.compare(0, 34, "HTTP/1.1 101 Switching Protocols\r\n") == 0);
+    assert(reply.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n") != std::string::npos);
+
+    std::string no_upgrade = "GET /ws HTTP/1.1\r\nConnection: keep-alive\r\nSec-WebSocket-Version: 13\r\n"
+                             "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+    request_parser plain;
+    assert(plain.feed(no_upgrade.data(), no_upgrade.size()) == request_parser::complete);
+    assert(!websocket::handshake_key(plain.to_view(), key));
+
+    std::cout << "websocket handshake tests passed!" << std::endl;
+}
+
+void test_websocket_frames() {
+    std::cout << "Testing websocket frames..." << std::endl;
+
+    const unsigned char mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+    websocket::frame frame;
+
+    // Masked "Hello" from RFC 6455 section 5.7, fed a byte at a time.
+    std::string hello = websocket::encode_masked_frame(websocket::text_frame, "Hello", mask);
+    assert(hello == std::string("\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58", 11));
+    for (size_t i = 0; i < hello.size(); i++) {
+        assert(websocket::parse_frame(hello.data(), i, 1024, frame) == websocket::need_more);
+    }
+    assert(websocket::parse_frame(hello.data(), hello.size(), 1024, frame) == websocket::complete);
+    assert(frame.fin && frame.opcode == websocket::text_frame && frame.payload == "Hello");
+    assert(frame.consumed == hello.size());
+
+    // Server frames are unmasked and pick the 7, 16 or 64-bit length form.
+    assert(websocket::encode_frame(websocket::text_frame, "Hello") == std::string("\x81\x05Hello", 7));
+    std::string sized = websocket::encode_frame(websocket::binary_frame, std::string(256, 'x'));
+    assert(sized.size() == 260 && sized.compare(0, 4, std::string("\x82\x7e\x01\x00", 4)) == 0);
+    std::string huge = websocket::encode_frame(websocket::binary_frame, std::string(70000, 'x'));
+    assert(huge.size() == 70000 + 10 && static_cast<unsigned char>(huge[1]) == 127);
+    assert(websocket::encode_close(1001) == std::string("\x88\x02\x03\xe9", 4));
+    assert(websocket::close_status(std::string("\x03\xe9", 2)) == 1001);
+    assert(websocket::close_status("") == websocket::close_normal);
+
+    std::string medium(300, 'm');
+    std::string encoded = websocket::encode_masked_frame(websocket::binary_frame, medium, mask, false);
+    assert(websocket::parse_frame(encoded.data(), encoded.size(), 1024, frame) == websocket::complete);
+    assert(!frame.fin && frame.payload == medium && frame.consumed == encoded.size());
+    assert(websocket::parse_frame(encoded.data(), encoded.size(), 299, frame) == websocket::failed);
+    assert(frame.error_code == websocket::close_too_big);
+
+    // Unmasked client frames, RSV bits, unknown opcodes and fragmented or
+    // oversized control frames are protocol errors.
+    std::string unmasked = websocket::encode_frame(websocket::text_frame, "x");
+    assert(websocket::parse_frame(unmasked.data(), unmasked.size(), 1024, frame) == websocket::failed);
+    assert(frame.error_code == websocket::close_protocol_error);
+    std::string rsv = websocket::encode_masked_frame(websocket::text_frame, "x", mask);
+    rsv[0] |= 0x40;
+    assert(websocket::parse_frame(rsv.data(), rsv.size(), 1024, frame) == websocket::failed);
+    std::string unknown = websocket::encode_masked_frame(0x3, "x", mask);
+    assert(websocket::parse_frame(unknown.data(), unknown.size(), 1024, frame) == websocket::failed);
+    std::string split_ping = websocket::encode_masked_frame(websocket::ping_frame, "x", mask, false);
+    assert(websocket::parse_frame(split_ping.data(), split_ping.size(), 1024, frame) == websocket::failed);
+    std::string long_ping = websocket::encode_masked_frame(websocket::ping_frame, std::string(126, 'p'), mask);
+    assert(websocket::parse_frame(long_ping.data(), long_ping.size(), 1024, frame) == websocket::failed);
+
+    std::cout << "websocket frame tests passed!" << std::endl;
+}
+
+void test_channel_registry() {
+    std::cout << "Testing channel_registry..." << std::endl;
+
+    channel_registry registry;
+    channel_subscriber tab = {0, 10, 1};
+    channel_subscriber phone = {1, 10, 7};
+    assert(registry.subscribe(42, tab));
+    assert(!registry.subscribe(42, phone));
+    assert(registry.subscribe(17, {0, 11, 2}));
+    assert(registry.is_subscribed(42) && registry.channel_count() == 2);
+
+    std::vector<channel_subscriber> subscribers;
+    assert(registry.subscribers(42, subscribers) == 2);
+    assert(registry.subscribers(99, subscribers) == 0 && subscribers.empty());
+
+    // Only the exact socket is removed; a reused descriptor with a new
+    // connection id is a different subscriber.
+    assert(!registry.unsubscribe(42, {0, 10, 3}));
+    assert(!registry.unsubscribe(42, tab));
+    assert(registry.subscribers(42, subscribers) == 1 && subscribers[0] == phone);
+    assert(registry.unsubscribe(42, phone));
+    assert(!registry.is_subscribed(42) && registry.channel_count() == 1);
+    assert(!registry.unsubscribe(42, phone));
+
+    std::cout << "channel_registry tests passed!" << std::endl;
+}
+
+void test_rate_limiter() {
+    std::cout << "Testing rate_limiter..." << std::endl;
+
+    rate_limiter limiter;
+    rate_limit limit(2, 5);
+    uint64_t retry_after = 0;
+    uint64_t alice = rate_limiter::make_key(1, 0x0100007f);
+    uint64_t bob = rate_limiter::make_key(1, 0x0200007f);
+    assert(alice != bob && alice != rate_limiter::make_key(2, 0x0100007f));
+
+    // A full bucket allows a burst, then refuses until it refills.
+    for (int i = 0; i < 5; i++) {
+        assert(limiter.allow(alice, limit, 1000, retry_after));
+    }
+    assert(!limiter.allow(alice, limit, 1000, retry_after));
+    assert(retry_after > 0 && retry_after <= 501);
+    assert(limiter.allow(bob, limit, 1000, retry_after));
+
+    // Two tokens a second: 500 ms buys one more request.
+    assert(!limiter.allow(alice, limit, 1400, retry_after));
+    assert(limiter.allow(alice, limit, 1500, retry_after));
+    assert(!limiter.allow(alice, limit, 1500, retry_after));
+
+    // Refill caps at the burst size.
+    for (int i = 0; i < 5; i++) {
+        assert(limiter.allow(alice, limit, 100000, retry_after));
+    }
+    assert(!limiter.allow(alice, limit, 100000, retry_after));
+
+    // Buckets are evicted only once they would be full again.
+    assert(limiter.bucket_count() == 2);
+    assert(limiter.evict_full(100000) == 1);  // bob refilled long ago
+    assert(limiter.evict_full(102000) == 0);
+    assert(limiter.evict_full(102500) == 1);
+    assert(limiter.bucket_count() == 0);
+
+    assert(!rate_limit().enabled());
+    limiter.start(10);
+    limiter.stop();
+
+    std::cout << "rate_limiter tests passed!" << std::endl;
+}
+
+int main() {
+    try {
+        test_request_parser_partial_reads();
+        test_request_parser_pipelined();
+        test_request_parser_chunked();
+        test_request_view();
+        test_request_parser_limits();
+        test_router();
+        test_query_params();
+        test_static_cache();
+        test_static_ranges();
+        test_gzip_utils();
+        test_http_response();
+        test_websocket_handshake();
+        test_websocket_frames();
+        test_channel_registry();
+        test_rate_limiter();
+        test_request_copy();
+        test_offload();
+
+        std::cout << "\nAll network tests passed successfully!" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with exception: " << e.what() << std::endl;
+        return 1;
+    }
+}